@@ -0,0 +1,294 @@
+// bin/latgen-biglm-faster-mapped.cc
+
+// Copyright 2009-2012  Microsoft Corporation, Karel Vesely
+//                2013  Johns Hopkins University (author: Daniel Povey)
+//                2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "lm/const-arpa-lm.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "lat/lattice-functions.h"
+#include "base/timer.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Decodes one utterance in operator (), and writes the output in the
+// destructor, for use with TaskSequencer (cf. DecodeUtteranceLatticeFasterClass
+// in decoder-wrappers.h).  Takes ownership of the decoder and the decodable.
+class DecodeUtteranceLatticeBiglmFasterClass {
+ public:
+  DecodeUtteranceLatticeBiglmFasterClass(
+      LatticeBiglmFasterDecoder *decoder,
+      DecodableInterface *decodable,
+      const TransitionModel &trans_model,
+      const std::string &utt,
+      BaseFloat acoustic_scale,
+      bool determinize,
+      bool allow_partial,
+      Int32VectorWriter *alignments_writer,
+      Int32VectorWriter *words_writer,
+      CompactLatticeWriter *compact_lattice_writer,
+      LatticeWriter *lattice_writer,
+      double *like_sum, int64 *frame_sum, int32 *num_done, int32 *num_err):
+      decoder_(decoder), decodable_(decodable), trans_model_(trans_model),
+      utt_(utt), acoustic_scale_(acoustic_scale), determinize_(determinize),
+      allow_partial_(allow_partial), alignments_writer_(alignments_writer),
+      words_writer_(words_writer),
+      compact_lattice_writer_(compact_lattice_writer),
+      lattice_writer_(lattice_writer), like_sum_(like_sum),
+      frame_sum_(frame_sum), num_done_(num_done), num_err_(num_err),
+      success_(false), likelihood_(0.0) { }
+
+  void operator () () {
+    if (!decoder_->Decode(decodable_)) {
+      KALDI_WARN << "Failed to decode utterance with id " << utt_;
+      return;
+    }
+    if (!decoder_->ReachedFinal()) {
+      if (allow_partial_) {
+        KALDI_WARN << "Outputting partial output for utterance " << utt_
+                   << " since no final-state reached\n";
+      } else {
+        KALDI_WARN << "Not producing output for utterance " << utt_
+                   << " since no final-state reached and "
+                   << "--allow-partial=false.\n";
+        return;
+      }
+    }
+    fst::VectorFst<LatticeArc> decoded;
+    decoder_->GetBestPath(&decoded);
+    if (decoded.NumStates() == 0)
+      KALDI_ERR << "Failed to get traceback for utterance " << utt_;
+    LatticeWeight weight;
+    GetLinearSymbolSequence(decoded, &alignment_, &words_, &weight);
+    likelihood_ = -(weight.Value1() + weight.Value2());
+
+    decoder_->GetRawLattice(&lat_);
+    if (lat_.NumStates() == 0)
+      KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt_;
+    fst::Connect(&lat_);
+    if (determinize_) {
+      if (!DeterminizeLatticePhonePrunedWrapper(
+              trans_model_, &lat_, decoder_->GetOptions().lattice_beam,
+              &clat_, decoder_->GetOptions().det_opts))
+        KALDI_WARN << "Determinization finished earlier than the beam for "
+                   << "utterance " << utt_;
+      lat_.DeleteStates();
+      // We'll write the lattice without acoustic scaling.
+      if (acoustic_scale_ != 0.0)
+        fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                          &clat_);
+    } else {
+      if (acoustic_scale_ != 0.0)
+        fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_),
+                          &lat_);
+    }
+    success_ = true;
+  }
+
+  ~DecodeUtteranceLatticeBiglmFasterClass() {
+    if (success_) {
+      if (words_writer_->IsOpen())
+        words_writer_->Write(utt_, words_);
+      if (alignments_writer_->IsOpen())
+        alignments_writer_->Write(utt_, alignment_);
+      if (determinize_)
+        compact_lattice_writer_->Write(utt_, clat_);
+      else
+        lattice_writer_->Write(utt_, lat_);
+      int32 num_frames = alignment_.size();
+      KALDI_LOG << "Log-like per frame for utterance " << utt_ << " is "
+                << (likelihood_ / num_frames) << " over "
+                << num_frames << " frames.";
+      *like_sum_ += likelihood_;
+      *frame_sum_ += num_frames;
+      (*num_done_)++;
+    } else {
+      (*num_err_)++;
+    }
+    delete decoder_;
+    delete decodable_;
+  }
+
+ private:
+  LatticeBiglmFasterDecoder *decoder_;
+  DecodableInterface *decodable_;
+  const TransitionModel &trans_model_;
+  std::string utt_;
+  BaseFloat acoustic_scale_;
+  bool determinize_;
+  bool allow_partial_;
+  Int32VectorWriter *alignments_writer_;
+  Int32VectorWriter *words_writer_;
+  CompactLatticeWriter *compact_lattice_writer_;
+  LatticeWriter *lattice_writer_;
+  double *like_sum_;
+  int64 *frame_sum_;
+  int32 *num_done_;
+  int32 *num_err_;
+
+  bool success_;
+  double likelihood_;
+  std::vector<int32> alignment_;
+  std::vector<int32> words_;
+  Lattice lat_;
+  CompactLattice clat_;
+};
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::VectorFst;
+    using fst::Fst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, using multiple\n"
+        "decoding threads.  User supplies the LM used to generate the decoding\n"
+        "graph, as an FST, and the desired LM, in ConstArpaLm format; this\n"
+        "decoder applies the difference during decoding.  The decoding threads\n"
+        "share one cache of LM-difference arcs (see --lm-cache-size).\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-biglm-faster-mapped [options] trans-model-in fst-in "
+        "oldlm-fst-in newlm-const-arpa-in loglikes-rspecifier"
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    int32 lm_cache_size = 1000000;
+    LatticeBiglmFasterDecoderConfig config;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+
+    config.Register(&po);
+    sequencer_config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("lm-cache-size", &lm_cache_size, "Number of LM-difference arcs "
+                "to cache (shared by all threads).");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 6 || po.NumArgs() > 8) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_filename = po.GetArg(2),
+        old_lm_fst_rxfilename = po.GetArg(3),
+        new_lm_rxfilename = po.GetArg(4),
+        feature_rspecifier = po.GetArg(5),
+        lattice_wspecifier = po.GetArg(6),
+        words_wspecifier = po.GetOptArg(7),
+        alignment_wspecifier = po.GetOptArg(8);
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    VectorFst<StdArc> *old_lm_fst = fst::CastOrConvertToVectorFst(
+        fst::ReadFstKaldiGeneric(old_lm_fst_rxfilename));
+    ApplyProbabilityScale(-1.0, old_lm_fst); // Negate old LM probs...
+
+    ConstArpaLm new_lm;
+    ReadKaldiObject(new_lm_rxfilename, &new_lm);
+
+    fst::BackoffDeterministicOnDemandFst<StdArc> old_lm_dfst(*old_lm_fst);
+    ConstArpaLmDeterministicFst new_lm_dfst(new_lm);
+    fst::ComposeDeterministicOnDemandFst<StdArc> compose_dfst(&old_lm_dfst,
+                                                              &new_lm_dfst);
+    fst::ConcurrentCacheDeterministicOnDemandFst<StdArc> cache_dfst(
+        &compose_dfst, lm_cache_size);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int32 num_success = 0, num_fail = 0;
+
+    Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_filename);
+    {
+      TaskSequencer<DecodeUtteranceLatticeBiglmFasterClass> sequencer(
+          sequencer_config);
+      SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> *loglikes =
+            new Matrix<BaseFloat>(loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes->NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          delete loglikes;
+          continue;
+        }
+        LatticeBiglmFasterDecoder *decoder =
+            new LatticeBiglmFasterDecoder(*decode_fst, config, &cache_dfst);
+        DecodableMatrixScaledMapped *decodable =
+            new DecodableMatrixScaledMapped(trans_model, acoustic_scale,
+                                            loglikes);
+        sequencer.Run(new DecodeUtteranceLatticeBiglmFasterClass(
+            decoder, decodable, trans_model, utt, acoustic_scale, determinize,
+            allow_partial, &alignment_writer, &words_writer,
+            &compact_lattice_writer, &lattice_writer, &tot_like, &frame_count,
+            &num_success, &num_fail));
+        // takes ownership of the task, and will delete it when done.
+      }
+      sequencer.Wait();
+    }
+
+    delete decode_fst;
+    delete old_lm_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor per thread assuming 100 frames/sec is "
+              << (sequencer_config.num_threads*elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,221 @@
+// bin/latgen-faster-mapped-batched.cc
+
+// Copyright 2009-2012  Microsoft Corporation, Karel Vesely
+//                2013  Johns Hopkins University (author: Daniel Povey)
+//                2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <map>
+#include <mutex>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/batched-lattice-faster-decoder.h"
+#include "decoder/decoder-wrappers.h"
+#include "base/timer.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::Fst;
+    using fst::ConstFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, decoding batches of\n"
+        "utterances frame-synchronously in each of several threads (see also\n"
+        "latgen-faster-mapped-parallel, whose timing output this matches)\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-faster-mapped-batched [options] trans-model-in fst-in loglikes-rspecifier"
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    LatticeFasterDecoderConfig config;
+    BatchedLatticeFasterDecoderConfig batched_config;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    batched_config.Register(&po);
+
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 4 || po.NumArgs() > 6) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_filename = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3),
+        lattice_wspecifier = po.GetArg(4),
+        words_wspecifier = po.GetOptArg(5),
+        alignment_wspecifier = po.GetOptArg(6);
+
+    if (ClassifyRspecifier(fst_in_filename, NULL, NULL) != kNoRspecifier)
+      KALDI_ERR << "latgen-faster-mapped-batched requires a single decoding "
+                << "graph, not a table of FSTs: " << fst_in_filename;
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    // The channels are all decoded against the same ConstFst, so convert the
+    // graph if it is of another type.
+    Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_filename);
+    ConstFst<StdArc> *const_fst;
+    if (decode_fst->Type() == "const") {
+      const_fst = static_cast<ConstFst<StdArc>*>(decode_fst);
+    } else {
+      const_fst = new ConstFst<StdArc>(*decode_fst);
+      delete decode_fst;
+    }
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    BatchedLatticeFasterDecoder batched_decoder(*const_fst, config,
+                                                batched_config);
+    SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
+
+    // The utterance on each channel, with its index in the input.
+    int32 num_channels = batched_decoder.NumChannels();
+    std::vector<std::string> channel_utts(num_channels);
+    std::vector<int64> channel_indexes(num_channels);
+    std::vector<DecodableInterface*> channel_decodables(num_channels, NULL);
+    int64 num_read = 0;
+
+    // Outputs that are ready but can't be written yet, as the output of an
+    // earlier utterance isn't, by index in the input.
+    std::map<int64, LatticeFasterOutput> outputs;
+    int64 num_written = 0;
+    std::mutex output_mutex;  // guards outputs, num_written and the totals.
+
+    // next() is never called concurrently, so it can read the input.
+    auto next = [&](int32 i) -> DecodableInterface* {
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> *mat = new Matrix<BaseFloat>(loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (mat->NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          std::lock_guard<std::mutex> lock(output_mutex);
+          num_fail++;
+          delete mat;
+          continue;
+        }
+        loglike_reader.Next();
+        channel_utts[i] = utt;
+        channel_indexes[i] = num_read++;
+        // The decodable object takes ownership of the matrix.
+        channel_decodables[i] =
+            new DecodableMatrixScaledMapped(trans_model, acoustic_scale, mat);
+        return channel_decodables[i];
+      }
+      return NULL;
+    };
+
+    // Each channel's lattice is determinized by the thread that decoded it,
+    // as in latgen-faster-mapped-parallel, and the outputs are written in the
+    // order of the input.
+    auto finished = [&](int32 i) {
+      LatticeFasterOutput output;
+      output.Compute(batched_decoder.GetDecoder(i), trans_model,
+                     channel_utts[i], acoustic_scale, determinize,
+                     allow_partial);
+      delete channel_decodables[i];
+      channel_decodables[i] = NULL;
+      std::lock_guard<std::mutex> lock(output_mutex);
+      outputs[channel_indexes[i]] = output;
+      while (!outputs.empty() && outputs.begin()->first == num_written) {
+        double like;
+        int32 num_frames;
+        if (outputs.begin()->second.Write(word_syms, &alignment_writer,
+                                          &words_writer,
+                                          &compact_lattice_writer,
+                                          &lattice_writer, &like,
+                                          &num_frames)) {
+          tot_like += like;
+          frame_count += num_frames;
+          num_success++;
+        } else {
+          num_fail++;
+        }
+        outputs.erase(outputs.begin());
+        num_written++;
+      }
+    };
+
+    batched_decoder.Decode(next, finished);
+    KALDI_ASSERT(outputs.empty() && num_written == num_read);
+
+    delete const_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with " << batched_config.num_threads
+              << " threads and batch size " << batched_config.batch_size
+              << (batched_config.frame_synchronous ? "" :
+                  " (not frame-synchronous)") << ".";
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor per thread assuming 100 frames/sec is "
+              << (batched_config.num_threads*elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -89,6 +89,7 @@ void ActiveGrammarFst::Destroy() {
   entry_arcs_.clear();
   ifsts_activity_.clear();
   instances_.clear();
+  lookahead_costs_.clear();
   // the following will only do something if we read this object from disk using
   // its Read() function.
   for (size_t i = 0; i < fsts_to_delete_.size(); i++)
@@ -96,6 +97,26 @@ void ActiveGrammarFst::Destroy() {
   fsts_to_delete_.clear();
 }
 
+void ActiveGrammarFst::SetLookaheadCosts(int32 ifst_index,
+                                         const std::vector<float> *costs) {
+  KALDI_ASSERT(ifst_index >= -1 &&
+               ifst_index < static_cast<int32>(ifsts_.size()));
+  const ConstFst<StdArc> *fst = (ifst_index == -1 ? top_fst_ :
+                                 ifsts_[ifst_index].second);
+  if (costs != NULL &&
+      static_cast<int32>(costs->size()) != fst->NumStates())
+    KALDI_ERR << "Lookahead costs have the wrong size " << costs->size()
+              << " for FST with " << fst->NumStates() << " states";
+  lookahead_costs_.resize(ifsts_.size() + 1, NULL);
+  lookahead_costs_[ifst_index + 1] = costs;
+}
+
+bool ActiveGrammarFst::HasLookaheadCosts() const {
+  for (size_t i = 0; i < lookahead_costs_.size(); i++)
+    if (lookahead_costs_[i] != NULL)
+      return true;
+  return false;
+}
 
 void ActiveGrammarFst::DecodeSymbol(Label label,
                               int32 *nonterminal_symbol,
@@ -1035,6 +1056,32 @@ void PrepareForActiveGrammarFst(int32 nonterm_phones_offset,
   p.Prepare();
 }
 
+void ComputeGrammarFstLookaheadCosts(const ConstFst<StdArc> &fst,
+                                     float no_final_cost,
+                                     std::vector<float> *costs) {
+  typedef StdArc::StateId StateId;
+  typedef StdArc::Weight Weight;
+  KALDI_ASSERT(no_final_cost >= 0.0 && KALDI_ISFINITE(no_final_cost));
+
+  VectorFst<StdArc> vfst(fst);
+  for (StateId s = 0; s < vfst.NumStates(); s++)
+    if (vfst.Final(s).Value() == KALDI_GRAMMAR_FST_SPECIAL_WEIGHT)
+      vfst.SetFinal(s, Weight::Zero());
+  std::vector<Weight> distance;
+  ShortestDistance(vfst, &distance, true);  // reverse: distance to the end.
+  if (distance.size() == 1 && !distance[0].Member())
+    KALDI_ERR << "Error computing lookahead costs";
+
+  costs->resize(vfst.NumStates());
+  for (StateId s = 0; s < vfst.NumStates(); s++) {
+    if (s < static_cast<StateId>(distance.size()) &&
+        distance[s] != Weight::Zero())
+      (*costs)[s] = distance[s].Value();
+    else
+      (*costs)[s] = no_final_cost;
+  }
+}
+
 void CopyToVectorFst(ActiveGrammarFst *grammar_fst,
                      VectorFst<StdArc> *vector_fst) {
   typedef ActiveGrammarFstArc::StateId GrammarStateId;  // int64
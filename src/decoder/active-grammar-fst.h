@@ -249,6 +249,36 @@ class ActiveGrammarFst {
 
   inline std::string Type() const { return "active_grammar"; }
 
+  /**
+     Gives this object heuristic "lookahead" costs for the states of one of its
+     FSTs, i.e. for each state an estimate of the best cost from it to the end
+     of that FST, as computed by ComputeGrammarFstLookaheadCosts().  The decoder
+     may add these to the costs it prunes with (see --lookahead-cost-scale in
+     lattice-faster-decoder.h), so that paths whose continuations are all
+     expensive or impossible are pruned sooner.
+
+       @param [in] ifst_index  The index into the 'ifsts' given to the
+                  constructor, or -1 for the top-level FST.
+       @param [in] costs  The costs, indexed by state; its size must equal the
+                  number of states of that FST.  Not owned by this object,
+                  and must outlive it; may be NULL, to remove the costs.
+                  These are not written by Write().
+   */
+  void SetLookaheadCosts(int32 ifst_index,
+                         const std::vector<float> *costs);
+
+  // Returns true if SetLookaheadCosts() was called for any FST.
+  bool HasLookaheadCosts() const;
+
+  // Returns the lookahead cost of state s, or zero if no lookahead costs were
+  // set for its FST.
+  inline float LookaheadCost(StateId s) const {
+    size_t index = instances_[s >> 32].ifst_index + 1;
+    if (index >= lookahead_costs_.size() || lookahead_costs_[index] == NULL)
+      return 0.0;
+    return (*lookahead_costs_[index])[static_cast<int32>(s)];
+  }
+
   ~ActiveGrammarFst();
  private:
 
@@ -550,6 +580,11 @@ class ActiveGrammarFst {
   // will only be nonempty if we have read this object from the disk using
   // Read().
   std::vector<const ConstFst<StdArc> *> fsts_to_delete_;
+
+  // The lookahead costs given to SetLookaheadCosts(), indexed by ifst_index
+  // plus one (so the top-level FST is at index 0); NULL for FSTs without
+  // them.  Empty if SetLookaheadCosts() has not been called.  Not owned.
+  std::vector<const std::vector<float> *> lookahead_costs_;
 };
 
 
@@ -672,6 +707,31 @@ class ArcIterator<ActiveGrammarFst> {
 void CopyToVectorFst(ActiveGrammarFst *grammar_fst,
                      VectorFst<StdArc> *vector_fst);
 
+/**
+   This function computes, for each state of 'fst' (which must have been
+   prepared with PrepareForActiveGrammarFst()), the cost of the best path from
+   it to a final state of 'fst', for use with
+   ActiveGrammarFst::SetLookaheadCosts().  The special final-probs that mark
+   states with nonterminal arcs are not counted as final, so the paths go
+   through those arcs; the costs of any sub-FSTs invoked along the way are not
+   included, nor, for an ifst, the cost of the rest of the FST that invoked it,
+   so these are estimates.  States from which no final state can be reached
+   get the cost 'no_final_cost'.  Takes time O(number of arcs * log).
+
+     @param [in] fst  The FST; will usually be the top-level FST or one of the
+                  'ifsts' of an ActiveGrammarFst.
+     @param [in] no_final_cost  The cost of states from which no final state
+                  can be reached.  To have the decoder prune them whenever
+                  there is anything else to keep, it should be several times
+                  the beam divided by the --lookahead-cost-scale.  It must be
+                  finite, so that the decoder's cutoffs stay finite even if
+                  all the tokens are on such states.
+     @param [out] costs  The costs, indexed by state.
+ */
+void ComputeGrammarFstLookaheadCosts(const ConstFst<StdArc> &fst,
+                                     float no_final_cost,
+                                     std::vector<float> *costs);
+
 /**
    This function prepares 'ifst' for use in ActiveGrammarFst: it ensures that it has
    the expected properties, changing it slightly as needed.  'ifst' is expected
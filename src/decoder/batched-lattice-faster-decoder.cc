@@ -0,0 +1,109 @@
+// decoder/batched-lattice-faster-decoder.cc
+
+// Copyright 2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/batched-lattice-faster-decoder.h"
+
+namespace kaldi {
+
+BatchedLatticeFasterDecoder::BatchedLatticeFasterDecoder(
+    const FST &fst,
+    const LatticeFasterDecoderConfig &decoder_config,
+    const BatchedLatticeFasterDecoderConfig &config):
+    config_(config), threads_(config.num_threads), stopped_(false) {
+  config_.Check();
+  int32 num_channels = config_.num_threads * config_.batch_size;
+  decoders_.resize(num_channels);
+  for (int32 i = 0; i < num_channels; i++)
+    decoders_[i] = new Decoder(fst, decoder_config);
+}
+
+BatchedLatticeFasterDecoder::~BatchedLatticeFasterDecoder() {
+  DeletePointers(&decoders_);
+}
+
+void BatchedLatticeFasterDecoder::Decode(
+    const std::function<DecodableInterface*(int32)> &next,
+    const std::function<void(int32)> &finished) {
+  stopped_ = false;
+  threads_.Run([&](int32 thread) {
+      try {
+        DecodeThread(next, finished, thread);
+      } catch (...) {
+        // Let the other threads finish what they have, and no more; the
+        // exception is rethrown by Run().
+        std::lock_guard<std::mutex> lock(next_mutex_);
+        stopped_ = true;
+        throw;
+      }
+    });
+}
+
+DecodableInterface *BatchedLatticeFasterDecoder::NextDecodable(
+    const std::function<DecodableInterface*(int32)> &next, int32 i) {
+  std::lock_guard<std::mutex> lock(next_mutex_);
+  if (stopped_)
+    return NULL;
+  return next(i);
+}
+
+void BatchedLatticeFasterDecoder::DecodeThread(
+    const std::function<DecodableInterface*(int32)> &next,
+    const std::function<void(int32)> &finished, int32 thread) {
+  // "active" holds the channels of this thread that have an utterance, and
+  // decodables[j] the decodable object of channel active[j].
+  std::vector<int32> active;
+  std::vector<DecodableInterface*> decodables;
+  for (size_t i = thread; i < decoders_.size(); i += config_.num_threads) {
+    DecodableInterface *decodable = NextDecodable(next, i);
+    if (decodable == NULL)
+      break;
+    decoders_[i]->InitDecoding();
+    active.push_back(i);
+    decodables.push_back(decodable);
+  }
+  // If !config_.frame_synchronous, each utterance is decoded to the end
+  // before the next one is started.
+  int32 max_num_frames = config_.frame_synchronous ? 1 : -1;
+  while (!active.empty()) {
+    for (size_t j = 0; j < active.size(); ) {
+      int32 i = active[j];
+      Decoder *decoder = decoders_[i];
+      DecodableInterface *decodable = decodables[j];
+      decoder->AdvanceDecoding(decodable, max_num_frames);
+      if (decoder->NumFramesDecoded() < decodable->NumFramesReady()) {
+        j++;
+        continue;
+      }
+      decoder->FinalizeDecoding();
+      finished(i);
+      if ((decodable = NextDecodable(next, i)) != NULL) {
+        decoder->InitDecoding();
+        decodables[j] = decodable;
+        j++;
+      } else {
+        active[j] = active.back();
+        active.pop_back();
+        decodables[j] = decodables.back();
+        decodables.pop_back();
+      }
+    }
+  }
+}
+
+} // end namespace kaldi.
@@ -0,0 +1,135 @@
+// decoder/batched-lattice-faster-decoder.h
+
+// Copyright 2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_BATCHED_LATTICE_FASTER_DECODER_H_
+#define KALDI_DECODER_BATCHED_LATTICE_FASTER_DECODER_H_
+
+#include <functional>
+#include <vector>
+
+#include "itf/options-itf.h"
+#include "itf/decodable-itf.h"
+#include "fst/fstlib.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+struct BatchedLatticeFasterDecoderConfig {
+  int32 num_threads;
+  int32 batch_size;
+  bool frame_synchronous;
+
+  BatchedLatticeFasterDecoderConfig(): num_threads(1),
+                                       batch_size(4),
+                                       frame_synchronous(true) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("num-threads", &num_threads, "Number of decoding threads.");
+    opts->Register("batch-size", &batch_size, "Number of utterances each "
+                   "thread decodes at the same time.");
+    opts->Register("frame-synchronous", &frame_synchronous, "If true, each "
+                   "thread advances its utterances one frame at a time in "
+                   "turn; if false, it decodes them one after the other (for "
+                   "comparison).");
+  }
+  void Check() const {
+    KALDI_ASSERT(num_threads > 0 && batch_size > 0);
+  }
+};
+
+
+/** BatchedLatticeFasterDecoder decodes several utterances at once on the CPU,
+    all against the same decoding graph.  It owns num_threads * batch_size
+    "channels" (instances of LatticeFasterDecoderTpl), and each thread advances
+    the batch_size utterances on its channels frame-synchronously, decoding one
+    frame of each in turn.  Compared with decoding the utterances one by one in
+    each thread (as latgen-faster-mapped-parallel does), the states and arcs of
+    the graph that the utterances have in common, such as those near the start
+    state and in common words, tend to be visited by all of them within a short
+    time and so stay in cache.  When a channel finishes its utterance, its
+    thread gives it the next one, so a long utterance holds up only its own
+    channel rather than the whole batch.  The channels and threads are reused
+    for all the utterances, so the hashes, memory pools and other buffers of
+    the channels are allocated only once.
+
+    The decodable objects must have all their frames ready when Decode() is
+    called (e.g. DecodableMatrixScaledMapped); this is an offline decoder.
+ */
+class BatchedLatticeFasterDecoder {
+ public:
+  typedef fst::ConstFst<fst::StdArc> FST;
+  typedef LatticeFasterDecoderTpl<FST> Decoder;
+
+  /// The FST is not copied, and must outlive this object.
+  BatchedLatticeFasterDecoder(
+      const FST &fst,
+      const LatticeFasterDecoderConfig &decoder_config,
+      const BatchedLatticeFasterDecoderConfig &config);
+
+  ~BatchedLatticeFasterDecoder();
+
+  /// The number of utterances decoded at the same time, i.e. num_threads *
+  /// batch_size.
+  int32 NumChannels() const { return decoders_.size(); }
+
+  /// Decodes utterances until there are no more.  Whenever channel i is free,
+  /// next(i) is called to get the decodable object of the utterance to decode
+  /// on it, or NULL if there are no more utterances; calls to next() are never
+  /// concurrent.  When the utterance has been decoded to the end and
+  /// FinalizeDecoding() has been called, finished(i) is called from the
+  /// decoding thread of channel i, so that work such as lattice
+  /// determinization is done in parallel too; the results can be obtained
+  /// from GetDecoder(i) until finished(i) returns, and calls for different
+  /// channels may be concurrent.  If next(), finished() or the decoding
+  /// throws, no more utterances are started and the exception is rethrown
+  /// once the other threads have finished the utterances they have.
+  void Decode(const std::function<DecodableInterface*(int32)> &next,
+              const std::function<void(int32)> &finished);
+
+  const Decoder &GetDecoder(int32 i) const { return *(decoders_[i]); }
+
+  const BatchedLatticeFasterDecoderConfig &GetOptions() const {
+    return config_;
+  }
+
+ private:
+  // Decodes utterances on the channels whose indexes are congruent to
+  // "thread" modulo config_.num_threads, refilling them from next() as they
+  // finish, until next() returns NULL for all of them.
+  void DecodeThread(const std::function<DecodableInterface*(int32)> &next,
+                    const std::function<void(int32)> &finished,
+                    int32 thread);
+
+  // Calls next(i) under next_mutex_, unless decoding has been stopped.
+  DecodableInterface *NextDecodable(
+      const std::function<DecodableInterface*(int32)> &next, int32 i);
+
+  BatchedLatticeFasterDecoderConfig config_;
+  std::vector<Decoder*> decoders_;
+  WorkerThreads threads_;
+  std::mutex next_mutex_;
+  bool stopped_;  // set if a thread has thrown; guarded by next_mutex_.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchedLatticeFasterDecoder);
+};
+
+
+} // end namespace kaldi.
+
+#endif
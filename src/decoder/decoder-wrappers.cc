@@ -282,28 +282,19 @@ bool DecodeUtteranceLatticeIncremental(
 }
 
 
-// Takes care of output.  Returns true on success.
 template <typename FST>
-bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
-    DecodableInterface &decodable, // not const but is really an input.
+bool LatticeFasterOutput::Compute(
+    const LatticeFasterDecoderTpl<FST> &decoder,
     const TransitionModel &trans_model,
-    const fst::SymbolTable *word_syms,
-    std::string utt,
+    const std::string &utt,
     double acoustic_scale,
     bool determinize,
-    bool allow_partial,
-    Int32VectorWriter *alignment_writer,
-    Int32VectorWriter *words_writer,
-    CompactLatticeWriter *compact_lattice_writer,
-    LatticeWriter *lattice_writer,
-    double *like_ptr) { // puts utterance's like in like_ptr on success.
+    bool allow_partial) {
   using fst::VectorFst;
+  utt_ = utt;
+  determinize_ = determinize;
+  success_ = false;
 
-  if (!decoder.Decode(&decodable)) {
-    KALDI_WARN << "Failed to decode utterance with id " << utt;
-    return false;
-  }
   if (!decoder.ReachedFinal()) {
     if (allow_partial) {
       KALDI_WARN << "Outputting partial output for utterance " << utt
@@ -316,71 +307,116 @@ bool DecodeUtteranceLatticeFaster(
     }
   }
 
-  double likelihood;
-  LatticeWeight weight;
-  int32 num_frames;
   { // First do some stuff with word-level traceback...
     VectorFst<LatticeArc> decoded;
     if (!decoder.GetBestPath(&decoded))
       // Shouldn't really reach this point as already checked success.
       KALDI_ERR << "Failed to get traceback for utterance " << utt;
-
-    std::vector<int32> alignment;
-    std::vector<int32> words;
-    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-    num_frames = alignment.size();
-    if (words_writer->IsOpen())
-      words_writer->Write(utt, words);
-    if (alignment_writer->IsOpen())
-      alignment_writer->Write(utt, alignment);
-    if (word_syms != NULL) {
-      std::cerr << utt << ' ';
-      for (size_t i = 0; i < words.size(); i++) {
-        std::string s = word_syms->Find(words[i]);
-        if (s == "")
-          KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
-        std::cerr << s << ' ';
-      }
-      std::cerr << '\n';
-    }
-    likelihood = -(weight.Value1() + weight.Value2());
+    GetLinearSymbolSequence(decoded, &alignment_, &words_, &weight_);
   }
 
   // Get lattice, and do determinization if requested.
-  Lattice lat;
-  decoder.GetRawLattice(&lat);
-  if (lat.NumStates() == 0)
+  decoder.GetRawLattice(&lat_);
+  if (lat_.NumStates() == 0)
     KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
-  fst::Connect(&lat);
+  fst::Connect(&lat_);
   if (determinize) {
-    CompactLattice clat;
     if (!DeterminizeLatticePhonePrunedWrapper(
             trans_model,
-            &lat,
+            &lat_,
             decoder.GetOptions().lattice_beam,
-            &clat,
+            &clat_,
             decoder.GetOptions().det_opts))
       KALDI_WARN << "Determinization finished earlier than the beam for "
                  << "utterance " << utt;
+    lat_.DeleteStates();
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
-    compact_lattice_writer->Write(utt, clat);
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
+                        &clat_);
   } else {
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
-    lattice_writer->Write(utt, lat);
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale),
+                        &lat_);
   }
-  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
+  success_ = true;
+  return true;
+}
+
+bool LatticeFasterOutput::Write(
+    const fst::SymbolTable *word_syms,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr,
+    int32 *num_frames_ptr) {
+  if (!success_)
+    return false;
+  success_ = false;
+  if (words_writer->IsOpen())
+    words_writer->Write(utt_, words_);
+  if (alignment_writer->IsOpen())
+    alignment_writer->Write(utt_, alignment_);
+  if (word_syms != NULL) {
+    std::cerr << utt_ << ' ';
+    for (size_t i = 0; i < words_.size(); i++) {
+      std::string s = word_syms->Find(words_[i]);
+      if (s == "")
+        KALDI_ERR << "Word-id " << words_[i] << " not in symbol table.";
+      std::cerr << s << ' ';
+    }
+    std::cerr << '\n';
+  }
+  if (determinize_) {
+    compact_lattice_writer->Write(utt_, clat_);
+    clat_.DeleteStates();
+  } else {
+    lattice_writer->Write(utt_, lat_);
+    lat_.DeleteStates();
+  }
+  double likelihood = -(weight_.Value1() + weight_.Value2());
+  int32 num_frames = alignment_.size();
+  KALDI_LOG << "Log-like per frame for utterance " << utt_ << " is "
             << (likelihood / num_frames) << " over "
             << num_frames << " frames.";
-  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
-                << weight.Value1() << " + " << weight.Value2();
+  KALDI_VLOG(2) << "Cost for utterance " << utt_ << " is "
+                << weight_.Value1() << " + " << weight_.Value2();
   *like_ptr = likelihood;
+  if (num_frames_ptr != NULL)
+    *num_frames_ptr = num_frames;
   return true;
 }
 
+// Takes care of output.  Returns true on success.
+template <typename FST>
+bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) { // puts utterance's like in like_ptr on success.
+  if (!decoder.Decode(&decodable)) {
+    KALDI_WARN << "Failed to decode utterance with id " << utt;
+    return false;
+  }
+  LatticeFasterOutput output;
+  if (!output.Compute(decoder, trans_model, utt, acoustic_scale, determinize,
+                      allow_partial))
+    return false;
+  return output.Write(word_syms, alignment_writer, words_writer,
+                      compact_lattice_writer, lattice_writer, like_ptr);
+}
+
 // Instantiate the template above for the two required FST types.
 template bool DecodeUtteranceLatticeIncremental(
     LatticeIncrementalDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
@@ -413,6 +449,38 @@ template bool DecodeUtteranceLatticeIncremental(
     double *like_ptr);
 
 
+template bool LatticeFasterOutput::Compute(
+    const LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial);
+
+template bool LatticeFasterOutput::Compute(
+    const LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc> > &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial);
+
+template bool LatticeFasterOutput::Compute(
+    const LatticeFasterDecoderTpl<fst::GrammarFst> &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial);
+
+template bool LatticeFasterOutput::Compute(
+    const LatticeFasterDecoderTpl<fst::ActiveGrammarFst> &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial);
+
 template bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
     DecodableInterface &decodable,
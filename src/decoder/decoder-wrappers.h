@@ -134,6 +134,54 @@ bool DecodeUtteranceLatticeFaster(
     double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
 
 
+/// This class does the output part of DecodeUtteranceLatticeFaster, for a
+/// decoder that has already decoded the utterance.  It is split into
+/// Compute(), which gets the best path and the (optionally determinized)
+/// lattice, and Write(), so that a multi-threaded program (e.g. one using
+/// BatchedLatticeFasterDecoder) can call Compute() from the decoding threads
+/// and Write() from the main thread, in the order of the input.
+class LatticeFasterOutput {
+ public:
+  LatticeFasterOutput(): determinize_(false), success_(false) { }
+
+  /// Returns false, and produces no output, if no final state was reached
+  /// and allow_partial == false.  It is instantiated for FST =
+  /// fst::Fst<fst::StdArc>, fst::ConstFst<fst::StdArc>, fst::GrammarFst and
+  /// fst::ActiveGrammarFst.
+  template <typename FST>
+  bool Compute(const LatticeFasterDecoderTpl<FST> &decoder,
+               const TransitionModel &trans_model,
+               const std::string &utt,
+               double acoustic_scale,
+               bool determinize,
+               bool allow_partial);
+
+  /// Writes the output of the last call to Compute(), if it succeeded, and
+  /// frees the lattice.  If determinize was false it writes to
+  /// lattice_writer, else to compact_lattice_writer; the writers for
+  /// alignments and words will only be written to if they are open.  Puts
+  /// the utterance's likelihood in like_ptr and, if num_frames != NULL, its
+  /// number of frames in num_frames.  Returns false if Compute() failed.
+  bool Write(const fst::SymbolTable *word_syms,
+             Int32VectorWriter *alignments_writer,
+             Int32VectorWriter *words_writer,
+             CompactLatticeWriter *compact_lattice_writer,
+             LatticeWriter *lattice_writer,
+             double *like_ptr,
+             int32 *num_frames = NULL);
+
+ private:
+  std::string utt_;
+  bool determinize_;
+  bool success_;
+  LatticeWeight weight_;  // of the best path
+  std::vector<int32> alignment_;
+  std::vector<int32> words_;
+  Lattice lat_;  // Stored output, if determinize_ == false.
+  CompactLattice clat_;  // Stored output, if determinize_ == true.
+};
+
+
 /// This class basically does the same job as the function
 /// DecodeUtteranceLatticeFaster, but in a way that allows us
 /// to build a multi-threaded command line program more easily.
@@ -23,7 +23,7 @@
 
 
 #include "util/stl-utils.h"
-#include "util/hash-list.h"
+#include "util/flat-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -43,6 +43,12 @@ typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
     DeterministicOnDemandFst follows through the epsilons in G for you
     (assuming G is a standard backoff language model) and makes it look
     like a determinized FST.
+
+    The decoder looks up an arc of lm_diff_fst for every word arc it
+    traverses, so lm_diff_fst should normally be wrapped in a
+    CacheDeterministicOnDemandFst; to share the cached arcs between decoders
+    running in different threads, use a ConcurrentCacheDeterministicOnDemandFst
+    (see latgen-biglm-faster-mapped.cc).
 */
 
 class LatticeBiglmFasterDecoder {
@@ -297,7 +303,7 @@ class LatticeBiglmFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<PairId, Token*>::Elem Elem;
+  typedef FlatHashList<PairId, Token*>::Elem Elem;
   
   void PossiblyResizeHash(size_t num_toks) {
     size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
@@ -829,10 +835,12 @@ class LatticeBiglmFasterDecoder {
   }
 
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.
-  HashList<PairId, Token*> toks_;
+  // FlatHashList defined in ../util/flat-hash-list.h (a faster replacement for
+  // HashList, with the same interface).  Its multiplicative hash spreads the
+  // PairIds, whose LM state is in the high 32 bits, evenly over the table.  It
+  // actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by PairId.
+  FlatHashList<PairId, Token*> toks_;
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
   // must_prune_tokens).
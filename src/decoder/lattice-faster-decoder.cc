@@ -21,6 +21,7 @@
 // limitations under the License.
 
 #include "decoder/lattice-faster-decoder.h"
+#include "decoder/lookahead-decode-fst.h"
 #include "lat/lattice-functions.h"
 
 namespace kaldi {
@@ -30,7 +31,9 @@ template <typename FST, typename Token>
 LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const FST &fst,
     const LatticeFasterDecoderConfig &config):
-    fst_(&fst), delete_fst_(false), config_(config), num_toks_(0) {
+    segment_start_(0), fst_(&fst), delete_fst_(false), config_(config),
+    num_toks_(0), num_active_toks_total_(0), lookahead_scale_(0.0),
+    emitting_threads_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -39,7 +42,9 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
 template <typename FST, typename Token>
 LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config, FST *fst):
-    fst_(fst), delete_fst_(true), config_(config), num_toks_(0) {
+    segment_start_(0), fst_(fst), delete_fst_(true), config_(config),
+    num_toks_(0), num_active_toks_total_(0), lookahead_scale_(0.0),
+    emitting_threads_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -50,6 +55,7 @@ LatticeFasterDecoderTpl<FST, Token>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete fst_;
+  delete emitting_threads_;
 }
 
 template <typename FST, typename Token>
@@ -58,18 +64,45 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  segment_start_ = 0;
   warned_ = false;
   num_toks_ = 0;
+  num_active_toks_total_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  if (config_.num_emitting_threads > 1 &&
+      !decoder::ConcurrentArcIteration<FST>::Supported(*fst_)) {
+    static bool warned_threads = false;
+    if (!warned_threads) {
+      KALDI_WARN << "The decoding FST is computed lazily, so its arcs cannot "
+                 << "be read by several threads at once; ignoring "
+                 << "--num-emitting-threads=" << config_.num_emitting_threads;
+      warned_threads = true;
+    }
+  }
+  lookahead_scale_ = 0.0;
+  if (config_.lookahead_cost_scale > 0.0) {
+    if (decoder::LookaheadCost<FST>::Supported(*fst_)) {
+      lookahead_scale_ = config_.lookahead_cost_scale;
+    } else {
+      static bool warned_lookahead = false;
+      if (!warned_lookahead) {
+        KALDI_WARN << "The decoding FST has no lookahead costs; ignoring "
+                   << "--lookahead-cost-scale="
+                   << config_.lookahead_cost_scale;
+        warned_lookahead = true;
+      }
+    }
+  }
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = new (token_pool_.Allocate()) Token(0.0, 0.0, NULL, NULL,
+                                                         NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
-  ProcessNonemitting(config_.beam);
+  ProcessNonemitting(PruningCost(start_state, 0.0) + config_.beam);
 }
 
 // Returns true if any kind of traceback is available (not necessarily from
@@ -134,7 +167,7 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
   unordered_map<Token*, StateId> tok_map(bucket_count);
   // First create all states.
   std::vector<Token*> token_list;
-  for (int32 f = 0; f <= num_frames; f++) {
+  for (int32 f = segment_start_; f <= num_frames; f++) {
     if (active_toks_[f].toks == NULL) {
       KALDI_WARN << "GetRawLattice: no tokens active on frame " << f
                  << ": not producing lattice.\n";
@@ -153,7 +186,7 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
                 << tok_map.bucket_count() << " load:" << tok_map.load_factor()
                 << " max:" << tok_map.max_load_factor();
   // Now create all arcs.
-  for (int32 f = 0; f <= num_frames; f++) {
+  for (int32 f = segment_start_; f <= num_frames; f++) {
     for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
       StateId cur_state = tok_map[tok];
       for (ForwardLinkT *l = tok->links;
@@ -263,7 +296,8 @@ LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = new (token_pool_.Allocate())
+        Token(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -340,7 +374,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -428,7 +462,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -489,7 +523,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Free(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -508,7 +542,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
   // one to get the corresponding index for the decodable object.
-  for (int32 f = cur_frame_plus_one - 1; f >= 0; f--) {
+  for (int32 f = cur_frame_plus_one - 1; f >= segment_start_; f--) {
     // Reason why we need to prune forward links in this situation:
     // (1) we have never pruned them (new TokenList)
     // (2) we have not yet pruned the forward links to the next f,
@@ -516,7 +550,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
     if (active_toks_[f].must_prune_forward_links) {
       bool extra_costs_changed = false, links_pruned = false;
       PruneForwardLinks(f, &extra_costs_changed, &links_pruned, delta);
-      if (extra_costs_changed && f > 0) // any token has changed extra_cost
+      if (extra_costs_changed && f > segment_start_) // any token has changed extra_cost
         active_toks_[f-1].must_prune_forward_links = true;
       if (links_pruned) // any link was pruned
         active_toks_[f].must_prune_tokens = true;
@@ -581,8 +615,8 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
                                                 int32 max_num_frames) {
   if (std::is_same<FST, fst::Fst<fst::StdArc> >::value) {
     // if the type 'FST' is the FST base-class, then see if the FST type of fst_
-    // is actually VectorFst or ConstFst.  If so, call the AdvanceDecoding()
-    // function after casting *this to the more specific type.
+    // is actually VectorFst, ConstFst or LookaheadDecodeFst.  If so, call the
+    // AdvanceDecoding() function after casting *this to the more specific type.
     if (fst_->Type() == "const") {
       LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token> *this_cast =
           reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token>* >(this);
@@ -593,6 +627,11 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
           reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
+    } else if (fst_->Type() == "lookahead-decode") {
+      LatticeFasterDecoderTpl<fst::LookaheadDecodeFst, Token> *this_cast =
+          reinterpret_cast<LatticeFasterDecoderTpl<fst::LookaheadDecodeFst, Token>* >(this);
+      this_cast->AdvanceDecoding(decodable, max_num_frames);
+      return;
     }
   }
 
@@ -628,13 +667,13 @@ void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
   // sets decoding_finalized_.
   PruneForwardLinksFinal();
-  for (int32 f = final_frame_plus_one - 1; f >= 0; f--) {
+  for (int32 f = final_frame_plus_one - 1; f >= segment_start_; f--) {
     bool b1, b2; // values not used.
     BaseFloat dontcare = 0.0; // delta of zero means we must always update
     PruneForwardLinks(f, &b1, &b2, dontcare);
     PruneTokensForFrame(f + 1);
   }
-  PruneTokensForFrame(0);
+  PruneTokensForFrame(segment_start_);
   KALDI_VLOG(4) << "pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
 }
@@ -649,7 +688,7 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
   if (config_.max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
-      BaseFloat w = static_cast<BaseFloat>(e->val->tot_cost);
+      BaseFloat w = PruningCost(e->key, e->val->tot_cost);
       if (w < best_weight) {
         best_weight = w;
         if (best_elem) *best_elem = e;
@@ -659,38 +698,70 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
     if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
     return best_weight + config_.beam;
   } else {
+    // With the histogram, the costs are binned in this one pass, and only
+    // copied to tmp_array_ (by get_costs) if an exact cutoff is needed.
+    bool use_histogram = (config_.histogram_bins > 0);
+    BaseFloat histogram_start = std::numeric_limits<BaseFloat>::infinity();
+    if (use_histogram)
+      histogram_.assign(config_.histogram_bins, 0);
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
-      BaseFloat w = e->val->tot_cost;
-      tmp_array_.push_back(w);
+      BaseFloat w = PruningCost(e->key, e->val->tot_cost);
+      if (use_histogram)
+        AddToHistogram(w, &histogram_start);
+      else
+        tmp_array_.push_back(w);
       if (w < best_weight) {
         best_weight = w;
         if (best_elem) *best_elem = e;
       }
     }
     if (tok_count != NULL) *tok_count = count;
+    auto get_costs = [&]() {
+      if (tmp_array_.empty())
+        for (Elem *e = list_head; e != NULL; e = e->tail)
+          tmp_array_.push_back(PruningCost(e->key, e->val->tot_cost));
+    };
 
     BaseFloat beam_cutoff = best_weight + config_.beam,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
     KALDI_VLOG(6) << "Number of tokens active on frame " << NumFramesDecoded()
-                  << " is " << tmp_array_.size();
-
-    if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
-      std::nth_element(tmp_array_.begin(),
-                       tmp_array_.begin() + config_.max_active,
-                       tmp_array_.end());
-      max_active_cutoff = tmp_array_[config_.max_active];
+                  << " is " << count;
+
+    if (count > static_cast<size_t>(config_.max_active)) {
+      // Rounding down means we keep no more than max_active tokens (apart
+      // from ties at the bin edge).
+      if (!use_histogram ||
+          !GetHistogramCutoff(histogram_start, config_.max_active, false,
+                              &max_active_cutoff)) {
+        get_costs();
+        std::nth_element(tmp_array_.begin(),
+                         tmp_array_.begin() + config_.max_active,
+                         tmp_array_.end());
+        max_active_cutoff = tmp_array_[config_.max_active];
+      }
     }
     if (max_active_cutoff < beam_cutoff) { // max_active is tighter than beam.
       if (adaptive_beam)
         *adaptive_beam = max_active_cutoff - best_weight + config_.beam_delta;
       return max_active_cutoff;
     }
-    if (tmp_array_.size() > static_cast<size_t>(config_.min_active)) {
+    if (count > static_cast<size_t>(config_.min_active)) {
       if (config_.min_active == 0) min_active_cutoff = best_weight;
-      else {
+      else if (use_histogram) {
+        // Rounding up means we always keep at least min_active tokens.  If
+        // fewer than that are within the beam, we need the exact cost.
+        if (!GetHistogramCutoff(histogram_start, config_.min_active, true,
+                                &min_active_cutoff)) {
+          get_costs();
+          std::nth_element(tmp_array_.begin(),
+                           tmp_array_.begin() + config_.min_active,
+                           tmp_array_.end());
+          min_active_cutoff = tmp_array_[config_.min_active];
+        }
+      } else {
         std::nth_element(tmp_array_.begin(),
                          tmp_array_.begin() + config_.min_active,
                          tmp_array_.size() > static_cast<size_t>(config_.max_active) ?
@@ -710,6 +781,51 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
   }
 }
 
+template <typename FST, typename Token>
+inline void LatticeFasterDecoderTpl<FST, Token>::AddToHistogram(
+    BaseFloat cost, BaseFloat *histogram_start) {
+  int32 num_bins = histogram_.size();
+  BaseFloat bins_per_cost = num_bins / config_.beam;
+  if (cost < *histogram_start) {
+    // Move the start down by whole bins, so the counts so far stay in their
+    // bins; those pushed past the end are more than a beam above "cost".
+    BaseFloat shift = std::ceil((*histogram_start - cost) * bins_per_cost);
+    if (shift < num_bins) {
+      int32 num_shifted = static_cast<int32>(shift);
+      std::copy_backward(histogram_.begin(), histogram_.end() - num_shifted,
+                         histogram_.end());
+      std::fill(histogram_.begin(), histogram_.begin() + num_shifted, 0);
+      *histogram_start -= num_shifted / bins_per_cost;
+    } else {  // Including the first cost, when *histogram_start is infinity.
+      std::fill(histogram_.begin(), histogram_.end(), 0);
+      *histogram_start = cost;
+    }
+  }
+  BaseFloat extra = cost - *histogram_start;
+  if (extra < config_.beam)
+    histogram_[std::min(static_cast<int32>(extra * bins_per_cost),
+                        num_bins - 1)]++;
+}
+
+template <typename FST, typename Token>
+bool LatticeFasterDecoderTpl<FST, Token>::GetHistogramCutoff(
+    BaseFloat histogram_start, int32 rank, bool round_up,
+    BaseFloat *cutoff) const {
+  int32 num_bins = histogram_.size(), count = 0;
+  BaseFloat bin_width = config_.beam / num_bins;
+  for (int32 bin = 0; bin < num_bins; bin++) {
+    count += histogram_[bin];
+    if (count > rank) {
+      // Rounding down to the start of bin 0 would keep (next to) nothing.
+      if (bin == 0 && !round_up)
+        return false;
+      *cutoff = histogram_start + bin_width * (round_up ? bin + 1 : bin);
+      return true;
+    }
+  }
+  return false;
+}
+
 template <typename FST, typename Token>
 BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     DecodableInterface *decodable) {
@@ -726,6 +842,7 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   BaseFloat adaptive_beam;
   size_t tok_cnt;
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  num_active_toks_total_ += tok_cnt;
   KALDI_VLOG(6) << "Adaptive beam on frame " << NumFramesDecoded() << " is "
                 << adaptive_beam;
 
@@ -737,6 +854,14 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   BaseFloat cost_offset = 0.0; // Used to keep probabilities in a good
                                // dynamic range.
 
+  // Threads only pay off if there is a fair amount of work on the frame.
+  bool use_threads = (config_.num_emitting_threads > 1 && tok_cnt >= 1000 &&
+                      decoder::ConcurrentArcIteration<FST>::Supported(*fst_));
+  // If use_table, we look up the log-likelihoods in frame_loglikes_ instead
+  // of calling the decodable object for each arc.
+  bool use_table = (use_threads || config_.precompute_loglikes);
+  if (use_table)
+    decodable->GetFrameLogLikelihoods(frame, &frame_loglikes_);
 
   // First process the best token to get a hopefully
   // reasonably tight bound on the next cutoff.  The only
@@ -750,8 +875,10 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel != 0) {  // propagate..
-        BaseFloat new_weight = arc.weight.Value() + cost_offset -
-            decodable->LogLikelihood(frame, arc.ilabel) + tok->tot_cost;
+        BaseFloat loglike = (use_table ? frame_loglikes_[arc.ilabel] :
+                             decodable->LogLikelihood(frame, arc.ilabel));
+        BaseFloat new_weight = PruningCost(arc.nextstate,
+            arc.weight.Value() + cost_offset - loglike + tok->tot_cost);
         if (new_weight + adaptive_beam < next_cutoff)
           next_cutoff = new_weight + adaptive_beam;
       }
@@ -764,6 +891,10 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   cost_offsets_.resize(frame + 1, 0.0);
   cost_offsets_[frame] = cost_offset;
 
+  if (use_threads)
+    return ProcessEmittingThreaded(frame, final_toks, cur_cutoff,
+                                   cost_offset, adaptive_beam, next_cutoff);
+
   // the tokens are now owned here, in final_toks, and the hash is empty.
   // 'owned' is a complex thing here; the point is we need to call DeleteElem
   // on each elem 'e' to let toks_ know we're done with them.
@@ -771,7 +902,40 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     // loop this way because we delete "e" as we go.
     StateId state = e->key;
     Token *tok = e->val;
-    if (tok->tot_cost <= cur_cutoff) {
+    bool within_cutoff = (PruningCost(state, tok->tot_cost) <= cur_cutoff);
+    if (within_cutoff && use_table) {
+      // Like the loop below, but first prunes all of the token's arcs,
+      // prefetching the hash entries of the surviving ones, and only then
+      // looks them up, so that the lookups overlap with the memory accesses.
+      // The tokens and links created, and their order, are the same.
+      token_arcs_.clear();
+      for (fst::ArcIterator<FST> aiter(*fst_, state);
+           !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel != 0) {  // propagate..
+          BaseFloat ac_cost = cost_offset - frame_loglikes_[arc.ilabel],
+              graph_cost = arc.weight.Value(),
+              tot_cost = tok->tot_cost + ac_cost + graph_cost,
+              pruning_cost = PruningCost(arc.nextstate, tot_cost);
+          if (pruning_cost >= next_cutoff) continue;
+          else if (pruning_cost + adaptive_beam < next_cutoff)
+            next_cutoff = pruning_cost + adaptive_beam; // prune by best current token
+          toks_.Prefetch(arc.nextstate);
+          EmittingArc earc = { tok, arc.nextstate, arc.ilabel, arc.olabel,
+                               graph_cost, ac_cost, tot_cost };
+          token_arcs_.push_back(earc);
+        }
+      }
+      for (size_t i = 0; i < token_arcs_.size(); i++) {
+        const EmittingArc &earc = token_arcs_[i];
+        Elem *e_next = FindOrAddToken(static_cast<StateId>(earc.nextstate),
+                                      frame + 1, earc.tot_cost, tok, NULL);
+        tok->links = new (link_pool_.Allocate()) ForwardLinkT(
+            e_next->val, earc.ilabel, earc.olabel, earc.graph_cost,
+            earc.ac_cost, tok->links);
+      }
+    } else if (within_cutoff) {
       for (fst::ArcIterator<FST> aiter(*fst_, state);
            !aiter.Done();
            aiter.Next()) {
@@ -781,10 +945,11 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
               decodable->LogLikelihood(frame, arc.ilabel),
               graph_cost = arc.weight.Value(),
               cur_cost = tok->tot_cost,
-              tot_cost = cur_cost + ac_cost + graph_cost;
-          if (tot_cost >= next_cutoff) continue;
-          else if (tot_cost + adaptive_beam < next_cutoff)
-            next_cutoff = tot_cost + adaptive_beam; // prune by best current token
+              tot_cost = cur_cost + ac_cost + graph_cost,
+              pruning_cost = PruningCost(arc.nextstate, tot_cost);
+          if (pruning_cost >= next_cutoff) continue;
+          else if (pruning_cost + adaptive_beam < next_cutoff)
+            next_cutoff = pruning_cost + adaptive_beam; // prune by best current token
           // Note: the frame indexes into active_toks_ are one-based,
           // hence the + 1.
           Elem *e_next = FindOrAddToken(arc.nextstate,
@@ -792,8 +957,9 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(e_next->val, arc.ilabel, arc.olabel,
-                                        graph_cost, ac_cost, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLinkT(
+              e_next->val, arc.ilabel, arc.olabel, graph_cost, ac_cost,
+              tok->links);
         }
       } // for all arcs
     }
@@ -803,13 +969,114 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   return next_cutoff;
 }
 
-// static inline
+/*
+  A note on ProcessEmittingThreaded().
+
+  The tokens of the previous frame are split into contiguous ranges, one per
+  thread, and each thread propagates its range through the emitting arcs,
+  pruning with its own copy of next_cutoff, and records the surviving arcs.
+  Then the arcs are added to the lattice, in the order of the serial loop in
+  ProcessEmitting(), re-applying its pruning; this part stays serial, since it
+  modifies toks_ and the tokens.
+
+  The output is identical to that of the serial loop.  A thread's cutoff at any
+  arc is never tighter than the serial loop's cutoff at that arc would be: the
+  serial cutoff is the minimum of tot_cost + adaptive_beam over all earlier
+  surviving arcs, while the thread sees only some of them, and any arc it keeps
+  that the serial loop would drop has tot_cost + adaptive_beam at least the
+  serial cutoff.  So the threads keep every arc the serial loop keeps, and
+  re-pruning in order drops exactly the others.
+
+  Decodable objects are not thread-safe, so the log-likelihoods of the frame
+  are fetched for all indices beforehand, into frame_loglikes_, by
+  ProcessEmitting().
+*/
+template <typename FST, typename Token>
+BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmittingThreaded(
+    int32 frame, Elem *final_toks,
+    BaseFloat cur_cutoff, BaseFloat cost_offset, BaseFloat adaptive_beam,
+    BaseFloat next_cutoff) {
+  typedef decoder::ConcurrentArcIteration<FST> ConcurrentArcIterationT;
+  emitting_elems_.clear();
+  for (const Elem *e = final_toks; e != NULL; e = e->tail) {
+    if (PruningCost(e->key, e->val->tot_cost) <= cur_cutoff) {
+      emitting_elems_.push_back(e);
+      if (ConcurrentArcIterationT::kNeedsPrepare)
+        ConcurrentArcIterationT::Prepare(*fst_, e->key);
+    }
+  }
+
+  int32 num_threads = config_.num_emitting_threads;
+  emitting_arcs_.resize(num_threads);
+  size_t num_elems = emitting_elems_.size();
+  auto propagate = [&](int32 thread) {
+    std::vector<EmittingArc> &arcs = emitting_arcs_[thread];
+    arcs.clear();
+    BaseFloat thread_cutoff = next_cutoff;
+    size_t begin = num_elems * thread / num_threads,
+        end = num_elems * (thread + 1) / num_threads;
+    for (size_t i = begin; i < end; i++) {
+      StateId state = emitting_elems_[i]->key;
+      Token *tok = emitting_elems_[i]->val;
+      for (fst::ArcIterator<FST> aiter(*fst_, state);
+           !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel != 0) {  // propagate..
+          BaseFloat ac_cost = cost_offset - frame_loglikes_[arc.ilabel],
+              graph_cost = arc.weight.Value(),
+              cur_cost = tok->tot_cost,
+              tot_cost = cur_cost + ac_cost + graph_cost,
+              pruning_cost = PruningCost(arc.nextstate, tot_cost);
+          if (pruning_cost >= thread_cutoff) continue;
+          else if (pruning_cost + adaptive_beam < thread_cutoff)
+            thread_cutoff = pruning_cost + adaptive_beam;
+          EmittingArc emitting_arc = { tok, arc.nextstate, arc.ilabel,
+                                       arc.olabel, graph_cost, ac_cost,
+                                       tot_cost };
+          arcs.push_back(emitting_arc);
+        }
+      }
+    }
+  };
+  // The threads are created on first use and then kept, since this runs for
+  // every frame.
+  if (emitting_threads_ == NULL)
+    emitting_threads_ = new WorkerThreads(num_threads);
+  emitting_threads_->Run(propagate);
+
+  for (int32 thread = 0; thread < num_threads; thread++) {
+    const std::vector<EmittingArc> &arcs = emitting_arcs_[thread];
+    for (size_t i = 0; i < arcs.size(); i++) {
+      const EmittingArc &arc = arcs[i];
+      BaseFloat pruning_cost = PruningCost(static_cast<StateId>(arc.nextstate),
+                                           arc.tot_cost);
+      if (pruning_cost >= next_cutoff) continue;
+      else if (pruning_cost + adaptive_beam < next_cutoff)
+        next_cutoff = pruning_cost + adaptive_beam;
+      Token *tok = arc.tok;
+      Elem *e_next = FindOrAddToken(static_cast<StateId>(arc.nextstate),
+                                    frame + 1, arc.tot_cost, tok, NULL);
+      tok->links = new (link_pool_.Allocate()) ForwardLinkT(
+          e_next->val, arc.ilabel, arc.olabel, arc.graph_cost, arc.ac_cost,
+          tok->links);
+    }
+  }
+
+  for (Elem *e = final_toks, *e_tail; e != NULL; e = e_tail) {
+    e_tail = e->tail;
+    toks_.Delete(e);
+  }
+  return next_cutoff;
+}
+
+// inline
 template <typename FST, typename Token>
 void LatticeFasterDecoderTpl<FST, Token>::DeleteForwardLinks(Token *tok) {
   ForwardLinkT *l = tok->links, *m;
   while (l != NULL) {
     m = l->next;
-    delete l;
+    link_pool_.Free(l);
     l = m;
   }
   tok->links = NULL;
@@ -852,8 +1119,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
     StateId state = e->key;
     Token *tok = e->val;  // would segfault if e is a NULL pointer but this can't happen.
     BaseFloat cur_cost = tok->tot_cost;
-    if (cur_cost >= cutoff) // Don't bother processing successors.
-      continue;
+    if (PruningCost(state, cur_cost) >= cutoff)
+      continue;  // Don't bother processing successors.
     // If "tok" has any existing forward links, delete them,
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
@@ -867,14 +1134,14 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
       if (arc.ilabel == 0) {  // propagate nonemitting only...
         BaseFloat graph_cost = arc.weight.Value(),
             tot_cost = cur_cost + graph_cost;
-        if (tot_cost < cutoff) {
+        if (PruningCost(arc.nextstate, tot_cost) < cutoff) {
           bool changed;
 
           Elem *e_new = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLinkT(e_new->val, 0, arc.olabel,
-                                        graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLinkT(
+              e_new->val, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -897,19 +1164,12 @@ void LatticeFasterDecoderTpl<FST, Token>::DeleteElems(Elem *list) {
 
 template <typename FST, typename Token>
 void LatticeFasterDecoderTpl<FST, Token>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      DeleteForwardLinks(tok);
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
-  }
+  // All tokens and forward links live in the pools, and need no destruction,
+  // so they can be released at once rather than walking every frame's list.
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
+  num_toks_ = 0;
+  token_pool_.Clear();
+  link_pool_.Clear();
 }
 
 // static
@@ -998,12 +1258,14 @@ template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::Std
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdToken >;
 template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::StdToken>;
 template class LatticeFasterDecoderTpl<fst::ActiveGrammarFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::LookaheadDecodeFst, decoder::StdToken>;
 
 template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> , decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::ActiveGrammarFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::LookaheadDecodeFst, decoder::BackpointerToken>;
 
 
 } // end namespace kaldi.
@@ -24,8 +24,10 @@
 #define KALDI_DECODER_LATTICE_FASTER_DECODER_H_
 
 
+#include <type_traits>
 #include "util/stl-utils.h"
-#include "util/hash-list.h"
+#include "util/flat-hash-list.h"
+#include "util/kaldi-thread.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -49,6 +51,10 @@ struct LatticeFasterDecoderConfig {
   // a very important parameter.  It affects the algorithm that prunes the
   // tokens as we go.
   BaseFloat prune_scale;
+  int32 num_emitting_threads;
+  int32 histogram_bins;
+  bool precompute_loglikes;
+  BaseFloat lookahead_cost_scale;
 
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
@@ -63,7 +69,11 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
-                                prune_scale(0.1) { }
+                                prune_scale(0.1),
+                                num_emitting_threads(1),
+                                histogram_bins(0),
+                                precompute_loglikes(false),
+                                lookahead_cost_scale(0.0) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
     opts->Register("beam", &beam, "Decoding beam.  Larger->slower, more accurate.");
@@ -82,12 +92,39 @@ struct LatticeFasterDecoderConfig {
                    "max-active constraint is applied.  Larger is more accurate.");
     opts->Register("hash-ratio", &hash_ratio, "Setting used in decoder to "
                    "control hash behavior");
+    opts->Register("num-emitting-threads", &num_emitting_threads, "Number of "
+                   "threads to propagate tokens through emitting arcs with, "
+                   "on frames with many active tokens.  Results are identical "
+                   "to those with one thread.  Log-likelihoods of all indices "
+                   "are fetched from the decodable object on each such frame, "
+                   "so this is meant for neural-net decodables.");
+    opts->Register("histogram-bins", &histogram_bins, "If >0, apply "
+                   "--max-active and --min-active approximately, from a "
+                   "histogram of the token costs within the beam with this "
+                   "many bins (e.g. 256), instead of by partial sorting.  The "
+                   "cutoffs are then off by at most beam/histogram-bins.");
+    opts->Register("precompute-loglikes", &precompute_loglikes, "If true, "
+                   "get the log-likelihoods of all indices (transition-ids) "
+                   "from the decodable object once per frame, and look them "
+                   "up per arc; also prefetches the hash entries of the "
+                   "arcs' destination states.  Faster for neural-net "
+                   "decodables with many active tokens; results are "
+                   "identical.");
+    opts->Register("lookahead-cost-scale", &lookahead_cost_scale, "If >0 and "
+                   "the decoding graph provides lookahead costs (estimates of "
+                   "the best cost from each state to the end of the graph; "
+                   "only ActiveGrammarFst does, see SetLookaheadCosts()), "
+                   "add them times this scale to the token costs when "
+                   "pruning, but not to the scores.  Prunes paths with "
+                   "expensive or impossible continuations sooner.");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
                  && min_active <= max_active
                  && prune_interval > 0 && beam_delta > 0.0 && hash_ratio >= 1.0
-                 && prune_scale > 0.0 && prune_scale < 1.0);
+                 && prune_scale > 0.0 && prune_scale < 1.0
+                 && num_emitting_threads >= 1 && histogram_bins >= 0
+                 && lookahead_cost_scale >= 0.0);
   }
 };
 
@@ -207,6 +244,138 @@ struct BackpointerToken {
       backpointer(backpointer) { }
 };
 
+/// A free-list allocator for the decoder's Tokens and ForwardLinks.  Objects
+/// are carved out of large blocks instead of being allocated one at a time
+/// with new, and freed objects are recycled by later allocations, so the tens
+/// of thousands of tokens and links created and pruned on each frame cost no
+/// malloc/free.  Clear() releases all objects at once, e.g. when all the
+/// frames are discarded at the start of an utterance, while keeping the blocks
+/// for reuse.  Objects are constructed by the caller with placement new on the
+/// memory returned by Allocate(); since Clear() does not run destructors, T
+/// must be trivially destructible.
+template <typename T>
+class DecoderObjectPool {
+ public:
+  static_assert(std::is_trivially_destructible<T>::value,
+                "DecoderObjectPool requires a trivially destructible type");
+
+  explicit DecoderObjectPool(size_t block_size = 4096):
+      block_size_(block_size), cur_block_(0), cur_block_used_(block_size),
+      free_list_(NULL) { }
+
+  ~DecoderObjectPool() {
+    for (size_t i = 0; i < blocks_.size(); i++)
+      delete [] blocks_[i];
+  }
+
+  /// Returns uninitialized memory for one T.
+  inline void *Allocate() {
+    if (free_list_ != NULL) {
+      Slot *slot = free_list_;
+      free_list_ = slot->next;
+      return slot;
+    }
+    if (cur_block_used_ == block_size_) NextBlock();
+    return blocks_[cur_block_] + cur_block_used_++;
+  }
+
+  /// Returns the memory of "t" (allocated by this pool) for reuse.
+  inline void Free(T *t) {
+    Slot *slot = reinterpret_cast<Slot*>(t);
+    slot->next = free_list_;
+    free_list_ = slot;
+  }
+
+  /// Frees all objects allocated so far.
+  void Clear() {
+    cur_block_ = 0;
+    cur_block_used_ = (blocks_.empty() ? block_size_ : 0);
+    free_list_ = NULL;
+  }
+
+ private:
+  union Slot {
+    Slot *next;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  void NextBlock() {
+    if (!blocks_.empty() && cur_block_ + 1 < blocks_.size()) {
+      cur_block_++;  // reuse a block retained by Clear().
+    } else {
+      blocks_.push_back(new Slot[block_size_]);
+      cur_block_ = blocks_.size() - 1;
+    }
+    cur_block_used_ = 0;
+  }
+
+  size_t block_size_;
+  size_t cur_block_;  // index into blocks_ of the block being carved up
+  size_t cur_block_used_;  // number of slots used in blocks_[cur_block_]
+  Slot *free_list_;
+  std::vector<Slot*> blocks_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecoderObjectPool);
+};
+
+/// Says whether several threads may iterate over the arcs of an FST at once,
+/// as LatticeFasterDecoderTpl does with num_emitting_threads > 1.  That is
+/// true of fully expanded FSTs such as ConstFst and VectorFst, but not of
+/// lazily computed ones, which cache arcs as they are visited.  GrammarFst and
+/// ActiveGrammarFst only modify themselves when they expand a state that has
+/// not been visited before, so for them it is safe once Prepare() has been
+/// called for each state, from a single thread.
+template <typename FST>
+struct ConcurrentArcIteration {
+  static bool Supported(const FST &fst) {
+    return fst.Properties(fst::kExpanded, false) != 0;
+  }
+  static const bool kNeedsPrepare = false;
+  static void Prepare(const FST &fst, typename FST::Arc::StateId s) { }
+};
+
+template <>
+struct ConcurrentArcIteration<fst::GrammarFst> {
+  static bool Supported(const fst::GrammarFst &fst) { return true; }
+  static const bool kNeedsPrepare = true;
+  static void Prepare(const fst::GrammarFst &fst,
+                      fst::GrammarFst::Arc::StateId s) {
+    fst::ArcIterator<fst::GrammarFst> aiter(fst, s);  // expands s if needed.
+  }
+};
+
+template <>
+struct ConcurrentArcIteration<fst::ActiveGrammarFst> {
+  static bool Supported(const fst::ActiveGrammarFst &fst) { return true; }
+  static const bool kNeedsPrepare = true;
+  static void Prepare(const fst::ActiveGrammarFst &fst,
+                      fst::ActiveGrammarFst::Arc::StateId s) {
+    fst::ArcIterator<fst::ActiveGrammarFst> aiter(fst, s);
+  }
+};
+
+/// Tells LatticeFasterDecoderTpl whether states of an FST of this type have
+/// lookahead costs (see --lookahead-cost-scale), and gets them.  Only
+/// ActiveGrammarFst has them, if they were given to it.
+template <typename FST>
+struct LookaheadCost {
+  static bool Supported(const FST &fst) { return false; }
+  static BaseFloat Get(const FST &fst, typename FST::Arc::StateId s) {
+    return 0.0;
+  }
+};
+
+template <>
+struct LookaheadCost<fst::ActiveGrammarFst> {
+  static bool Supported(const fst::ActiveGrammarFst &fst) {
+    return fst.HasLookaheadCosts();
+  }
+  static BaseFloat Get(const fst::ActiveGrammarFst &fst,
+                       fst::ActiveGrammarFst::Arc::StateId s) {
+    return fst.LookaheadCost(s);
+  }
+};
+
 }  // namespace decoder
 
 
@@ -339,13 +508,18 @@ class LatticeFasterDecoderTpl {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  // Returns the number of tokens that were active (before beam pruning) on
+  // each frame decoded so far, summed over frames.  Dividing by
+  // NumFramesDecoded() gives the average search effort per frame.
+  inline int64 NumActiveTokensTotal() const { return num_active_toks_total_; }
+
  protected:
   // we make things protected instead of private, as code in
   // LatticeFasterOnlineDecoderTpl, which inherits from this, also uses the
   // internals.
 
   // Deletes the elements of the singly linked list tok->links.
-  inline static void DeleteForwardLinks(Token *tok);
+  inline void DeleteForwardLinks(Token *tok);
 
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
@@ -357,7 +531,7 @@ class LatticeFasterDecoderTpl {
                  must_prune_tokens(true) { }
   };
 
-  using Elem = typename HashList<StateId, Token*>::Elem;
+  using Elem = typename FlatHashList<StateId, Token*>::Elem;
   // Equivalent to:
   //  struct Elem {
   //    StateId key;
@@ -439,30 +613,94 @@ class LatticeFasterDecoderTpl {
   BaseFloat GetCutoff(Elem *list_head, size_t *tok_count,
                       BaseFloat *adaptive_beam, Elem **best_elem);
 
+  /// Used in GetCutoff() if config_.histogram_bins > 0.  Counts "cost" in
+  /// histogram_, whose bins span the beam from *histogram_start; a cost below
+  /// *histogram_start moves it down by whole bins, to within a bin of "cost",
+  /// so that the costs can be binned in the same pass that finds the best one.
+  void AddToHistogram(BaseFloat cost, BaseFloat *histogram_start);
+
+  /// Used in GetCutoff() if config_.histogram_bins > 0.  Gets an approximation
+  /// to the cost with zero-based index "rank" in sorted order, from
+  /// histogram_, which starts at "histogram_start": the lower edge of the
+  /// histogram bin it falls in, or the upper edge if "round_up".  Returns
+  /// false if fewer than rank + 1 costs are within the beam, so the histogram
+  /// does not cover it, or if rounding down would give the lower edge of bin
+  /// 0; the caller then needs the exact cost.
+  bool GetHistogramCutoff(BaseFloat histogram_start, int32 rank, bool round_up,
+                          BaseFloat *cutoff) const;
+
   /// Processes emitting arcs for one frame.  Propagates from prev_toks_ to
   /// cur_toks_.  Returns the cost cutoff for subsequent ProcessNonemitting() to
   /// use.
   BaseFloat ProcessEmitting(DecodableInterface *decodable);
 
+  /// Does the work of the main loop of ProcessEmitting() on several threads,
+  /// for config_.num_emitting_threads > 1.  Takes the state of ProcessEmitting()
+  /// after the best token has been processed (with the frame's log-likelihoods
+  /// in frame_loglikes_), and returns the same cutoff.
+  BaseFloat ProcessEmittingThreaded(int32 frame,
+                                    Elem *final_toks, BaseFloat cur_cutoff,
+                                    BaseFloat cost_offset,
+                                    BaseFloat adaptive_beam,
+                                    BaseFloat next_cutoff);
+
   /// Processes nonemitting (epsilon) arcs for one frame.  Called after
   /// ProcessEmitting() on each frame.  The cost cutoff is computed by the
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
+  /// Returns the cost to prune a token in "state" with cost "cost" with: the
+  /// cost itself, plus the lookahead cost of the state times
+  /// lookahead_scale_.  All the cutoffs are in terms of this.
+  inline BaseFloat PruningCost(StateId state, BaseFloat cost) const {
+    if (lookahead_scale_ == 0.0) return cost;
+    return cost + lookahead_scale_ *
+        decoder::LookaheadCost<FST>::Get(*fst_, state);
+  }
+
+  // FlatHashList defined in ../util/flat-hash-list.h (a faster replacement for
+  // HashList, with the same interface).  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.  It is indexed by frame-index
   // plus one, where the frame-index is zero-based, as used in decodable object.
   // That is, the emitting probs of frame t are accounted for in tokens at
   // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
   // the graph.
-  HashList<StateId, Token*> toks_;
+  FlatHashList<StateId, Token*> toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
   // must_prune_tokens).
+  int32 segment_start_;  // Index into active_toks_ of the first frame that
+  // still has tokens.  It is zero unless some frames have been emitted and
+  // freed by LatticeFasterOnlineDecoderTpl::EmitLatticeSegment(), in which
+  // case that frame has a single token, from which the lattices start.
   std::vector<const Elem* > queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
+  std::vector<int32> histogram_;  // used in GetCutoff, for histogram_bins > 0.
+
+  // An emitting arc that survived pruning in ProcessEmitting() or a worker
+  // thread of ProcessEmittingThreaded(), to be added to the lattice.  (The state is
+  // stored as int64 so that the layout of this class does not depend on FST.)
+  struct EmittingArc {
+    Token *tok;
+    int64 nextstate;
+    int32 ilabel;
+    int32 olabel;
+    BaseFloat graph_cost;
+    BaseFloat ac_cost;
+    BaseFloat tot_cost;
+  };
+  // The acoustic log-likelihoods of the current frame, indexed by ilabel, used
+  // in ProcessEmitting() for precompute_loglikes or num_emitting_threads > 1.
+  std::vector<BaseFloat> frame_loglikes_;
+  // The surviving emitting arcs of one token, used in ProcessEmitting() for
+  // precompute_loglikes.
+  std::vector<EmittingArc> token_arcs_;
+  // Temporaries used in ProcessEmittingThreaded(): the tokens to propagate,
+  // and the arcs found by each thread.
+  std::vector<const Elem*> emitting_elems_;
+  std::vector<std::vector<EmittingArc> > emitting_arcs_;
 
   // fst_ is a pointer to the FST we are decoding from.
   const FST *fst_;
@@ -476,7 +714,18 @@ class LatticeFasterDecoderTpl {
   // zero, to reduce roundoff errors.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  // Tokens and ForwardLinks are allocated from these pools rather than with
+  // new/delete; see decoder::DecoderObjectPool.
+  decoder::DecoderObjectPool<Token> token_pool_;
+  decoder::DecoderObjectPool<ForwardLinkT> link_pool_;
+  int64 num_active_toks_total_; // sum over frames of #toks active before pruning.
   bool warned_;
+  // config_.lookahead_cost_scale if the FST has lookahead costs, else zero;
+  // set in InitDecoding().
+  BaseFloat lookahead_scale_;
+  // The threads of ProcessEmittingThreaded(), other than the calling one;
+  // created when it is first called, and kept until the decoder is destroyed.
+  WorkerThreads *emitting_threads_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
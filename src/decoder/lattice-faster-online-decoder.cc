@@ -193,7 +193,7 @@ bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
   // an extra frame for the start-state).
   int32 num_frames = this->active_toks_.size() - 1;
   KALDI_ASSERT(num_frames > 0);
-  for (int32 f = 0; f <= num_frames; f++) {
+  for (int32 f = this->segment_start_; f <= num_frames; f++) {
     if (this->active_toks_[f].toks == NULL) {
       KALDI_WARN << "No tokens active on frame " << f
                  << ": not producing lattice.\n";
@@ -203,13 +203,14 @@ bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
   unordered_map<Token*, StateId> tok_map;
   std::queue<std::pair<Token*, int32> > tok_queue;
   // First initialize the queue and states.  Put the initial state on the queue;
-  // this is the last token in the list active_toks_[0].toks.
-  for (Token *tok = this->active_toks_[0].toks;
+  // this is the last token in the list active_toks_[segment_start_].toks.
+  int32 start_frame = this->segment_start_;
+  for (Token *tok = this->active_toks_[start_frame].toks;
        tok != NULL; tok = tok->next) {
     if (tok->next == NULL) {
       tok_map[tok] = ofst->AddState();
       ofst->SetStart(tok_map[tok]);
-      std::pair<Token*, int32> tok_pair(tok, 0);  // #frame = 0
+      std::pair<Token*, int32> tok_pair(tok, start_frame);
       tok_queue.push(tok_pair);
     }
   }
@@ -265,6 +266,101 @@ bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
 }
 
 
+template <typename FST>
+bool LatticeFasterOnlineDecoderTpl<FST>::EmitLatticeSegment(
+    int32 min_segment_frames, Lattice *segment) {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  KALDI_ASSERT(min_segment_frames > 0 && !this->decoding_finalized_ &&
+               !this->active_toks_.empty());
+  auto &active_toks = this->active_toks_;
+  int32 start = this->segment_start_,
+      cur_frame_plus_one = this->NumFramesDecoded();
+  if (cur_frame_plus_one - start <= min_segment_frames)
+    return false;
+  this->PruneActiveTokens(this->config_.lattice_beam *
+                          this->config_.prune_scale);
+  // "cut" is the frame (index into active_toks_) with a single token.
+  int32 cut = -1;
+  for (int32 f = cur_frame_plus_one - 1; f >= start + min_segment_frames;
+       f--) {
+    Token *toks = active_toks[f].toks;
+    if (toks != NULL && toks->next == NULL) {
+      cut = f;
+      break;
+    }
+  }
+  if (cut == -1)
+    return false;
+  Token *cut_tok = active_toks[cut].toks;
+
+  // Prune the frames before the cut as FinalizeDecoding() would: all the
+  // paths go through cut_tok, so it is on the best path, and the extra_costs
+  // before it depend only on the frames up to it.
+  cut_tok->extra_cost = 0.0;
+  for (int32 f = cut - 1; f >= start; f--) {
+    bool b1, b2;  // values not used.
+    this->PruneForwardLinks(f, &b1, &b2, 0.0);
+    this->PruneTokensForFrame(f + 1);
+  }
+  this->PruneTokensForFrame(start);
+
+  // Output the segment, as in GetRawLattice().
+  segment->DeleteStates();
+  unordered_map<Token*, StateId> tok_map;
+  std::vector<Token*> token_list;
+  for (int32 f = start; f <= cut; f++) {
+    this->TopSortTokens(active_toks[f].toks, &token_list);
+    for (size_t i = 0; i < token_list.size(); i++)
+      if (token_list[i] != NULL)
+        tok_map[token_list[i]] = segment->AddState();
+  }
+  segment->SetStart(0);  // the tokens are topologically sorted.
+  for (int32 f = start; f < cut; f++) {
+    for (Token *tok = active_toks[f].toks; tok != NULL; tok = tok->next) {
+      StateId cur_state = tok_map[tok];
+      for (ForwardLinkT *l = tok->links; l != NULL; l = l->next) {
+        typename unordered_map<Token*, StateId>::const_iterator
+            iter = tok_map.find(l->next_tok);
+        KALDI_ASSERT(iter != tok_map.end());
+        BaseFloat cost_offset = (l->ilabel != 0 ? this->cost_offsets_[f] : 0);
+        segment->AddArc(cur_state,
+                        Arc(l->ilabel, l->olabel,
+                            Weight(l->graph_cost,
+                                   l->acoustic_cost - cost_offset),
+                            iter->second));
+      }
+    }
+  }
+  segment->SetFinal(tok_map[cut_tok], Weight::One());
+
+  // Free the frames before the cut.
+  int32 num_toks_begin = this->num_toks_;
+  for (int32 f = start; f < cut; f++) {
+    Token *next_tok;
+    for (Token *tok = active_toks[f].toks; tok != NULL; tok = next_tok) {
+      next_tok = tok->next;
+      ForwardLinkT *next_link;
+      for (ForwardLinkT *l = tok->links; l != NULL; l = next_link) {
+        next_link = l->next;
+        this->link_pool_.Free(l);
+      }
+      this->token_pool_.Free(tok);
+      this->num_toks_--;
+    }
+    active_toks[f].toks = NULL;
+    active_toks[f].must_prune_forward_links = false;
+    active_toks[f].must_prune_tokens = false;
+  }
+  cut_tok->backpointer = NULL;
+  this->segment_start_ = cut;
+  KALDI_VLOG(3) << "Emitted lattice segment of frames " << start << " to "
+                << cut << ", freeing " << (num_toks_begin - this->num_toks_)
+                << " tokens.";
+  return true;
+}
+
 
 // Instantiate the template for the FST types that we'll need.
 template class LatticeFasterOnlineDecoderTpl<fst::Fst<fst::StdArc> >;
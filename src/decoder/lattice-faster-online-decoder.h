@@ -136,6 +136,28 @@ class LatticeFasterOnlineDecoderTpl:
                            bool use_final_probs,
                            BaseFloat beam) const;
 
+  /// This is for decoding long streams (e.g. hour-long recordings) in bounded
+  /// memory.  It looks for the latest frame, at least "min_segment_frames"
+  /// frames after the start of the current segment and before the frame
+  /// currently being decoded, that has only a single token left after
+  /// pruning; all the paths that are still alive go through that token, so
+  /// the part of the lattice before it can no longer change.  If there is such
+  /// a frame, it outputs that part to "segment" as a raw lattice (pruned as
+  /// FinalizeDecoding() would prune it), whose single final state (with
+  /// weight One()) is that token; frees the tokens and links of the frames
+  /// before it; and returns true.  From then on, that token is the start of
+  /// the lattices output by GetRawLattice() and the other functions, and
+  /// tracebacks stop at it.  Concatenating the segments and the final lattice
+  /// in order (e.g. with fst::Concat()) gives the lattice of the whole
+  /// stream.  Returns false and does nothing if there is no such frame.
+  /// Note: the segments are cut at arbitrary frames, possibly inside a word,
+  /// so word alignment should be done on the concatenated lattice.
+  bool EmitLatticeSegment(int32 min_segment_frames, Lattice *segment);
+
+  /// Returns the number of frames emitted by EmitLatticeSegment() since
+  /// InitDecoding().
+  inline int32 NumFramesEmitted() const { return this->segment_start_; }
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoderTpl);
 };
 
@@ -0,0 +1,242 @@
+// decoder/lattice-incremental-decoder-test.cc
+
+// Copyright 2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-incremental-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "hmm/hmm-test-utils.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+typedef CompactLattice::StateId StateId;
+
+// Adds an arc to `clat` whose string has `num_frames` transition-ids.
+void AddArcWithFrames(StateId src, StateId dest, int32 num_frames,
+                      CompactLattice *clat) {
+  std::vector<int32> string(num_frames, 1);
+  CompactLatticeWeight weight(LatticeWeight(0.5, 1.0), string);
+  clat->AddArc(src, CompactLatticeArc(1, 1, weight, dest));
+}
+
+// Creates the lattice
+//   0 -> {1, 2} -> 3 -> 4 -> 5 (final), and 3 -> 6 (a dead end),
+// in which the arcs 3 -> 4 have 2 frames and the others have 1 frame; so
+// states 3 and 4 are on every path to the final state, on frames 2 and 4.
+void CreateTestLattice(CompactLattice *clat) {
+  clat->DeleteStates();
+  for (int32 i = 0; i < 7; i++)
+    clat->AddState();
+  clat->SetStart(0);
+  AddArcWithFrames(0, 1, 1, clat);
+  AddArcWithFrames(0, 2, 1, clat);
+  AddArcWithFrames(1, 3, 1, clat);
+  AddArcWithFrames(2, 3, 1, clat);
+  AddArcWithFrames(3, 4, 2, clat);
+  AddArcWithFrames(3, 6, 1, clat);
+  AddArcWithFrames(4, 5, 1, clat);
+  clat->SetFinal(5, CompactLatticeWeight::One());
+}
+
+void TestFindLatticeCutState() {
+  CompactLattice clat;
+  CreateTestLattice(&clat);
+  std::unordered_set<StateId> terminal_states;
+  std::vector<StateId> order;
+  std::vector<bool> live;
+  int32 cut_frame = -1;
+
+  // The latest state on every path is 4, on frame 4.
+  int32 cut = FindLatticeCutState(clat, terminal_states, 10,
+                                  &order, &live, &cut_frame);
+  KALDI_ASSERT(cut >= 0 && order[cut] == 4 && cut_frame == 4);
+  KALDI_ASSERT(order.size() == 7 && order[0] == 0);
+  KALDI_ASSERT(live[5] && live[3] && !live[6]);
+
+  // With max_frame = 3, it is state 3, on frame 2.
+  cut = FindLatticeCutState(clat, terminal_states, 3,
+                            &order, &live, &cut_frame);
+  KALDI_ASSERT(cut >= 0 && order[cut] == 3 && cut_frame == 2);
+
+  // States 1 and 2 are each on only one of the paths, so with max_frame = 1
+  // there is nothing to cut.
+  cut = FindLatticeCutState(clat, terminal_states, 1,
+                            &order, &live, &cut_frame);
+  KALDI_ASSERT(cut == -1);
+
+  // We must not cut at or after a state that may still be redeterminized.
+  terminal_states.insert(4);
+  cut = FindLatticeCutState(clat, terminal_states, 10,
+                            &order, &live, &cut_frame);
+  KALDI_ASSERT(cut >= 0 && order[cut] == 3 && cut_frame == 2);
+  terminal_states.clear();
+  terminal_states.insert(2);
+  cut = FindLatticeCutState(clat, terminal_states, 10,
+                            &order, &live, &cut_frame);
+  KALDI_ASSERT(cut == -1);
+
+  // Once the dead end 6 is final, 4 is no longer on every path.
+  clat.SetFinal(6, CompactLatticeWeight::One());
+  terminal_states.clear();
+  cut = FindLatticeCutState(clat, terminal_states, 10,
+                            &order, &live, &cut_frame);
+  KALDI_ASSERT(cut >= 0 && order[cut] == 3 && cut_frame == 2);
+}
+
+void TestAppendLatticeAtFinalState() {
+  CompactLattice clat;
+  CreateTestLattice(&clat);
+
+  // Split the test lattice at state 3, as FreezePrefix() would.
+  CompactLattice prefix, suffix;
+  for (int32 i = 0; i < 4; i++)
+    prefix.AddState();
+  prefix.SetStart(0);
+  AddArcWithFrames(0, 1, 1, &prefix);
+  AddArcWithFrames(0, 2, 1, &prefix);
+  AddArcWithFrames(1, 3, 1, &prefix);
+  AddArcWithFrames(2, 3, 1, &prefix);
+  prefix.SetFinal(3, CompactLatticeWeight::One());
+  for (int32 i = 0; i < 4; i++)
+    suffix.AddState();
+  suffix.SetStart(0);
+  AddArcWithFrames(0, 1, 2, &suffix);
+  AddArcWithFrames(0, 3, 1, &suffix);
+  AddArcWithFrames(1, 2, 1, &suffix);
+  suffix.SetFinal(2, CompactLatticeWeight::One());
+
+  // The suffix's states are added in order, so we get back the same lattice.
+  AppendLatticeAtFinalState(suffix, &prefix);
+  KALDI_ASSERT(prefix.Start() == clat.Start() &&
+               prefix.NumStates() == clat.NumStates());
+  for (StateId s = 0; s < clat.NumStates(); s++) {
+    KALDI_ASSERT(prefix.Final(s) == clat.Final(s) &&
+                 prefix.NumArcs(s) == clat.NumArcs(s));
+    fst::ArcIterator<CompactLattice> aiter(prefix, s), aiter2(clat, s);
+    for (; !aiter.Done(); aiter.Next(), aiter2.Next()) {
+      KALDI_ASSERT(aiter.Value().nextstate == aiter2.Value().nextstate &&
+                   aiter.Value().weight == aiter2.Value().weight);
+    }
+  }
+}
+
+// Returns the words of the best path through `clat`.
+std::vector<int32> GetBestPathWords(const CompactLattice &clat) {
+  CompactLattice best_path_clat;
+  CompactLatticeShortestPath(clat, &best_path_clat);
+  Lattice best_path;
+  ConvertLattice(best_path_clat, &best_path);
+  std::vector<int32> alignment, words;
+  LatticeWeight weight;
+  GetLinearSymbolSequence(best_path, &alignment, &words, &weight);
+  return words;
+}
+
+// Decodes a long input with --determinize-horizon, taking the frozen lattices
+// as they are produced, and checks that the lattice kept in the decoder stays
+// bounded, and that the frozen lattices joined to the rest give the same best
+// path as decoding without a horizon.
+void TestDeterminizeHorizon() {
+  TransitionModel *trans_model = GenRandTransitionModel(NULL);
+  int32 num_pdfs = trans_model->NumPdfs();
+
+  // The graph has one state, which loops on one transition-id per pdf, with
+  // the pdf + 1 as the word.
+  fst::StdVectorFst fst;
+  fst.AddState();
+  fst.SetStart(0);
+  fst.SetFinal(0, fst::TropicalWeight::One());
+  std::vector<bool> seen_pdfs(num_pdfs, false);
+  for (int32 tid = 1; tid <= trans_model->NumTransitionIds(); tid++) {
+    int32 pdf = trans_model->TransitionIdToPdf(tid);
+    if (!seen_pdfs[pdf]) {
+      seen_pdfs[pdf] = true;
+      fst.AddArc(0, fst::StdArc(tid, pdf + 1, 0.0, 0));
+    }
+  }
+
+  // On each frame one random pdf is much likelier than the others, so the
+  // lattice keeps narrowing to a single state.
+  int32 num_frames = 2000;
+  Matrix<BaseFloat> loglikes(num_frames, num_pdfs);
+  loglikes.Set(-20.0);
+  for (int32 t = 0; t < num_frames; t++)
+    loglikes(t, RandInt(0, num_pdfs - 1)) = -RandUniform();
+  DecodableMatrixScaledMapped decodable(*trans_model, loglikes, 1.0);
+
+  LatticeIncrementalDecoderConfig config;
+  config.lattice_beam = 4.0;
+  CompactLattice ref_clat;
+  {
+    LatticeIncrementalDecoder decoder(fst, *trans_model, config);
+    KALDI_ASSERT(decoder.Decode(&decodable));
+    ref_clat = decoder.GetLattice(decoder.NumFramesDecoded(), true);
+    Connect(&ref_clat);
+  }
+
+  config.determinize_horizon = 50;
+  LatticeIncrementalDecoder decoder(fst, *trans_model, config);
+  decoder.InitDecoding();
+  std::vector<CompactLattice> segments;
+  int32 max_num_states = 0;
+  while (decoder.NumFramesDecoded() < num_frames) {
+    decoder.AdvanceDecoding(&decodable, 10);
+    decoder.TakeFrozenLattices(&segments);
+    // Determinization may lag up to determinize_max_delay frames behind the
+    // decoding, and then the last determinize_horizon frames are kept.
+    KALDI_ASSERT(decoder.NumFramesInLattice() - decoder.NumFramesFrozen() <=
+                 config.determinize_horizon + config.determinize_max_delay);
+    if (decoder.NumFramesInLattice() > 0) {
+      const CompactLattice &clat =
+          decoder.GetLattice(decoder.NumFramesInLattice());
+      max_num_states = std::max<int32>(max_num_states, clat.NumStates());
+    }
+  }
+  decoder.FinalizeDecoding();
+  CompactLattice clat = decoder.GetLattice(num_frames, true);
+  decoder.TakeFrozenLattices(&segments);
+  KALDI_ASSERT(!segments.empty() && decoder.NumFramesFrozen() > 0);
+  KALDI_LOG << "Took " << segments.size() << " frozen lattices; the decoder "
+            << "kept at most " << max_num_states << " states, vs. "
+            << ref_clat.NumStates() << " without a horizon.";
+  // The whole lattice without a horizon has a state per frame.
+  KALDI_ASSERT(max_num_states < ref_clat.NumStates() / 4);
+
+  CompactLattice joined_clat = segments[0];
+  for (size_t i = 1; i < segments.size(); i++)
+    AppendLatticeAtFinalState(segments[i], &joined_clat);
+  AppendLatticeAtFinalState(clat, &joined_clat);
+  Connect(&joined_clat);
+  std::vector<int32> state_times;
+  KALDI_ASSERT(CompactLatticeStateTimes(joined_clat, &state_times) ==
+               num_frames);
+  KALDI_ASSERT(GetBestPathWords(joined_clat) == GetBestPathWords(ref_clat));
+  delete trans_model;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestFindLatticeCutState();
+  TestAppendLatticeAtFinalState();
+  for (int32 i = 0; i < 3; i++)
+    TestDeterminizeHorizon();
+  KALDI_LOG << "Success.";
+  return 0;
+}
@@ -77,6 +77,9 @@ void LatticeIncrementalDecoderTpl<FST, Token>::InitDecoding() {
 
   determinizer_.Init();
   num_frames_in_lattice_ = 0;
+  num_frames_frozen_ = 0;
+  frozen_lattices_.clear();
+  joined_clat_.DeleteStates();
   token2label_map_.clear();
   next_token_label_ = LatticeIncrementalDeterminizer::kTokenLabelOffset;
   ProcessNonemitting(config_.beam);
@@ -111,7 +114,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::UpdateLatticeDeterminization() {
   /* OK, determinize the chunk that spans from num_frames_in_lattice_ to
      best_frame. */
   bool use_final_probs = false;
-  GetLattice(best_frame, use_final_probs);
+  GetUnfrozenLattice(best_frame, use_final_probs);
   return;
 }
 // Returns true if any kind of traceback is available (not necessarily from
@@ -137,7 +140,7 @@ bool LatticeIncrementalDecoderTpl<FST, Token>::Decode(DecodableInterface *decoda
   Timer timer;
   FinalizeDecoding();
   bool use_final_probs = true;
-  GetLattice(NumFramesDecoded(), use_final_probs);
+  GetUnfrozenLattice(NumFramesDecoded(), use_final_probs);
   KALDI_VLOG(2) << "Delay time during and after FinalizeDecoding()"
                 << "(secs): " << timer.Elapsed();
 
@@ -870,6 +873,21 @@ template <typename FST, typename Token>
 const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
     int32 num_frames_to_include,
     bool use_final_probs) {
+  const CompactLattice &clat = GetUnfrozenLattice(num_frames_to_include,
+                                                  use_final_probs);
+  if (frozen_lattices_.empty() || clat.NumStates() == 0)
+    return clat;
+  joined_clat_ = frozen_lattices_[0];
+  for (size_t i = 1; i < frozen_lattices_.size(); i++)
+    AppendLatticeAtFinalState(frozen_lattices_[i], &joined_clat_);
+  AppendLatticeAtFinalState(clat, &joined_clat_);
+  return joined_clat_;
+}
+
+template <typename FST, typename Token>
+const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetUnfrozenLattice(
+    int32 num_frames_to_include,
+    bool use_final_probs) {
   KALDI_ASSERT(num_frames_to_include >= num_frames_in_lattice_ &&
                num_frames_to_include <= NumFramesDecoded());
 
@@ -901,8 +919,12 @@ const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
        this will do very little work. */
     PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
 
+    Timer timer;
     if (determinizer_.GetLattice().NumStates() == 0 ||
         determinizer_.GetLattice().Final(0) != CompactLatticeWeight::Zero()) {
+      // The start state of a lattice left by FreezePrefix() is never final,
+      // so we can't be restarting after frames were frozen.
+      KALDI_ASSERT(num_frames_frozen_ == 0);
       num_frames_in_lattice_ = 0;
       determinizer_.Init();
     }
@@ -1063,6 +1085,22 @@ const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
 
     if (determinizer_.GetLattice().NumStates() == 0)
       return determinizer_.GetLattice();   // Something went wrong, lattice is empty.
+
+    if (config_.determinize_horizon > 0) {
+      CompactLattice prefix;
+      int32 max_frame = num_frames_in_lattice_ - num_frames_frozen_ -
+          config_.determinize_horizon;
+      int32 num_frozen = determinizer_.FreezePrefix(max_frame, &prefix);
+      if (num_frozen > 0) {
+        num_frames_frozen_ += num_frozen;
+        frozen_lattices_.push_back(prefix);  // shallow copy.
+      }
+    }
+    KALDI_VLOG(2) << "Determinized lattice up to frame "
+                  << num_frames_in_lattice_ << " in " << timer.Elapsed()
+                  << " secs; it has " << determinizer_.GetLattice().NumStates()
+                  << " states, after " << num_frames_frozen_
+                  << " frozen frames.";
   }
 
   unordered_map<Token*, BaseFloat> token2final_cost;
@@ -1090,6 +1128,14 @@ const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
 }
 
 
+template <typename FST, typename Token>
+void LatticeIncrementalDecoderTpl<FST, Token>::TakeFrozenLattices(
+    std::vector<CompactLattice> *lats) {
+  lats->insert(lats->end(), frozen_lattices_.begin(), frozen_lattices_.end());
+  frozen_lattices_.clear();
+  joined_clat_.DeleteStates();
+}
+
 template <typename FST, typename Token>
 int32 LatticeIncrementalDecoderTpl<FST, Token>::GetNumToksForFrame(int32 frame) {
   int32 r = 0;
@@ -1642,6 +1688,222 @@ bool LatticeIncrementalDeterminizer::AcceptRawLatticeChunk(
 
 
 
+int32 FindLatticeCutState(
+    const CompactLattice &clat,
+    const std::unordered_set<CompactLattice::StateId> &terminal_states,
+    int32 max_frame,
+    std::vector<CompactLattice::StateId> *order_out,
+    std::vector<bool> *live_out,
+    int32 *cut_frame) {
+  using StateId = CompactLattice::StateId;
+  StateId num_states = clat.NumStates();
+  std::vector<StateId> &order(*order_out);
+  std::vector<bool> &live(*live_out);
+  order.clear();
+  live.assign(num_states, false);
+  if (num_states == 0)
+    return -1;
+
+  // Sort the states reachable from the start state topologically (as the
+  // reverse of the order in which a depth-first search finishes them).
+  {
+    std::vector<bool> visited(num_states, false);
+    // pairs of (state, index of next arc to follow).
+    std::vector<std::pair<StateId, size_t> > stack;
+    stack.push_back({clat.Start(), 0});
+    visited[clat.Start()] = true;
+    while (!stack.empty()) {
+      StateId s = stack.back().first;
+      size_t arc_idx = stack.back().second;
+      if (arc_idx < clat.NumArcs(s)) {
+        stack.back().second++;
+        fst::ArcIterator<CompactLattice> aiter(clat, s);
+        aiter.Seek(arc_idx);
+        StateId nextstate = aiter.Value().nextstate;
+        if (!visited[nextstate]) {
+          visited[nextstate] = true;
+          stack.push_back({nextstate, 0});
+        }
+      } else {
+        order.push_back(s);
+        stack.pop_back();
+      }
+    }
+    std::reverse(order.begin(), order.end());
+  }
+  int32 num_reachable = order.size();
+  std::vector<int32> position(num_states, -1);
+  for (int32 i = 0; i < num_reachable; i++)
+    position[order[i]] = i;
+
+  // States that are not live are dead ends, which the caller discards.
+  std::vector<bool> terminal(num_states, false);
+  for (int32 i = num_reachable - 1; i >= 0; i--) {
+    StateId s = order[i];
+    terminal[s] = (terminal_states.count(s) != 0 ||
+                   clat.Final(s) != CompactLatticeWeight::Zero());
+    bool is_live = terminal[s];
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s);
+         !aiter.Done() && !is_live; aiter.Next())
+      is_live = live[aiter.Value().nextstate];
+    live[s] = is_live;
+  }
+
+  // A live state S at position p in the topological order is on every path
+  // from the start state to any terminal state iff no arc between live states
+  // jumps over p, and no terminal state precedes it.  (Every live state other
+  // than S either precedes S on some such path, or follows it.)  We look for
+  // the latest such state that is no later than max_frame.
+  std::vector<int32> frame(num_states, 0);
+  int32 cut = -1, max_dest = 0;
+  for (int32 i = 0; i < num_reachable; i++) {
+    StateId s = order[i];
+    if (!live[s]) continue;
+    if (terminal[s]) break;
+    if (i > 0 && max_dest <= i && frame[s] <= max_frame) {
+      cut = i;
+      *cut_frame = frame[s];
+    }
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      if (!live[arc.nextstate]) continue;
+      max_dest = std::max(max_dest, position[arc.nextstate]);
+      // Different paths to a state should have the same length; if not, we
+      // are conservative.
+      frame[arc.nextstate] = std::max<int32>(
+          frame[arc.nextstate], frame[s] + arc.weight.String().size());
+    }
+  }
+  return cut;
+}
+
+
+void AppendLatticeAtFinalState(const CompactLattice &suffix,
+                               CompactLattice *clat) {
+  using StateId = CompactLattice::StateId;
+  if (suffix.Start() == fst::kNoStateId)
+    return;
+  StateId join_state = fst::kNoStateId;
+  for (StateId s = 0; s < clat->NumStates(); s++) {
+    if (clat->Final(s) != CompactLatticeWeight::Zero()) {
+      KALDI_ASSERT(join_state == fst::kNoStateId &&
+                   clat->Final(s) == CompactLatticeWeight::One());
+      join_state = s;
+    }
+  }
+  KALDI_ASSERT(join_state != fst::kNoStateId);
+  clat->SetFinal(join_state, CompactLatticeWeight::Zero());
+
+  std::vector<StateId> new_id(suffix.NumStates());
+  for (StateId s = 0; s < suffix.NumStates(); s++)
+    new_id[s] = (s == suffix.Start() ? join_state : clat->AddState());
+  for (StateId s = 0; s < suffix.NumStates(); s++) {
+    clat->SetFinal(new_id[s], suffix.Final(s));
+    for (fst::ArcIterator<CompactLattice> aiter(suffix, s);
+         !aiter.Done(); aiter.Next()) {
+      CompactLatticeArc arc(aiter.Value());
+      arc.nextstate = new_id[arc.nextstate];
+      clat->AddArc(new_id[s], arc);
+    }
+  }
+}
+
+
+int32 LatticeIncrementalDeterminizer::FreezePrefix(int32 max_frame,
+                                                   CompactLattice *prefix) {
+  using StateId = CompactLattice::StateId;
+  StateId num_states = clat_.NumStates();
+  if (num_states == 0 || max_frame <= 0)
+    return 0;
+
+  // Terminal states are those that may still be redeterminized, or final.
+  std::vector<StateId> order;
+  std::vector<bool> live;
+  int32 cut_frame = 0;
+  int32 cut = FindLatticeCutState(clat_, non_final_redet_states_, max_frame,
+                                  &order, &live, &cut_frame);
+  if (cut == -1)
+    return 0;
+  int32 num_reachable = order.size();
+  std::vector<int32> position(num_states, -1);
+  for (int32 i = 0; i < num_reachable; i++)
+    position[order[i]] = i;
+  StateId cut_state = order[cut];
+
+  // Number the live states in topological order, separately for the prefix
+  // (up to and including the cut state) and for the rest, which starts with
+  // the cut state.
+  std::vector<StateId> new_id(num_states, fst::kNoStateId);
+  prefix->DeleteStates();
+  for (int32 i = 0; i <= cut; i++)
+    if (live[order[i]])
+      new_id[order[i]] = prefix->AddState();
+  prefix->SetStart(new_id[clat_.Start()]);
+  for (int32 i = 0; i < cut; i++) {
+    StateId s = order[i];
+    if (!live[s]) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s);
+         !aiter.Done(); aiter.Next()) {
+      CompactLatticeArc arc(aiter.Value());
+      if (!live[arc.nextstate]) continue;
+      arc.nextstate = new_id[arc.nextstate];
+      prefix->AddArc(new_id[s], arc);
+    }
+  }
+  prefix->SetFinal(new_id[cut_state], CompactLatticeWeight::One());
+
+  // All paths now start from the cut state, so subtract its forward cost.
+  BaseFloat cut_forward_cost = forward_costs_[cut_state];
+  CompactLattice new_clat;
+  std::vector<BaseFloat> new_forward_costs;
+  for (int32 i = cut; i < num_reachable; i++) {
+    StateId s = order[i];
+    if (!live[s]) continue;
+    new_id[s] = new_clat.AddState();
+    new_forward_costs.push_back(forward_costs_[s] - cut_forward_cost);
+  }
+  new_clat.SetStart(0);
+  arcs_in_.clear();
+  arcs_in_.resize(new_clat.NumStates());
+  for (int32 i = cut; i < num_reachable; i++) {
+    StateId s = order[i];
+    if (!live[s]) continue;
+    StateId new_s = new_id[s];
+    new_clat.SetFinal(new_s, clat_.Final(s));
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s);
+         !aiter.Done(); aiter.Next()) {
+      CompactLatticeArc arc(aiter.Value());
+      if (!live[arc.nextstate]) continue;
+      arc.nextstate = new_id[arc.nextstate];
+      arcs_in_[arc.nextstate].push_back(
+          {new_s, static_cast<int32>(new_clat.NumArcs(new_s))});
+      new_clat.AddArc(new_s, arc);
+    }
+  }
+  clat_ = new_clat;
+  forward_costs_.swap(new_forward_costs);
+
+  // Renumber the states in final_arcs_ (which stores the source states in
+  // .nextstate) and non_final_redet_states_.  Those that are no longer
+  // present were unreachable.
+  std::vector<CompactLatticeArc> new_final_arcs;
+  for (CompactLatticeArc arc: final_arcs_) {
+    if (new_id[arc.nextstate] == fst::kNoStateId ||
+        position[arc.nextstate] < cut) continue;
+    arc.nextstate = new_id[arc.nextstate];
+    new_final_arcs.push_back(arc);
+  }
+  final_arcs_.swap(new_final_arcs);
+  std::unordered_set<StateId> new_redet_states;
+  for (StateId s: non_final_redet_states_)
+    if (new_id[s] != fst::kNoStateId && position[s] >= cut)
+      new_redet_states.insert(new_id[s]);
+  non_final_redet_states_.swap(new_redet_states);
+
+  return cut_frame;
+}
+
 void LatticeIncrementalDeterminizer::SetFinalCosts(
     const unordered_map<Label, BaseFloat> *token_label2final_cost) {
   if (final_arcs_.empty()) {
@@ -21,7 +21,7 @@
 #define KALDI_DECODER_LATTICE_INCREMENTAL_DECODER_H_
 
 #include "util/stl-utils.h"
-#include "util/hash-list.h"
+#include "util/flat-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -128,6 +128,7 @@ struct LatticeIncrementalDecoderConfig {
   // If you call
   int32 determinize_max_delay;
   int32 determinize_min_chunk_size;
+  int32 determinize_horizon;
 
 
   LatticeIncrementalDecoderConfig()
@@ -140,7 +141,8 @@ struct LatticeIncrementalDecoderConfig {
         hash_ratio(2.0),
         prune_scale(0.01),
         determinize_max_delay(60),
-        determinize_min_chunk_size(20) {
+        determinize_min_chunk_size(20),
+        determinize_horizon(0) {
     det_opts.minimize = false;
   }
   void Register(OptionsItf *opts) {
@@ -168,6 +170,14 @@ struct LatticeIncrementalDecoderConfig {
                    "determinizing it");
     opts->Register("determinize-min-chunk-size", &determinize_min_chunk_size,
                    "Minimum chunk size used in determinization");
+    opts->Register("determinize-horizon", &determinize_horizon,
+                   "If >0, the part of the determinized lattice more than "
+                   "this many frames before its end is frozen, wherever the "
+                   "lattice narrows to a single state, and is not revisited "
+                   "by later chunks; this keeps the cost of each chunk "
+                   "bounded for long utterances.  GetLattice() still returns "
+                   "the whole lattice unless the frozen parts are taken with "
+                   "TakeFrozenLattices().");
 
   }
   void Check() const {
@@ -176,7 +186,7 @@ struct LatticeIncrementalDecoderConfig {
           beam_delta > 0.0 && hash_ratio >= 1.0 &&
           prune_scale > 0.0 && prune_scale < 1.0 &&
           determinize_max_delay > determinize_min_chunk_size &&
-          determinize_min_chunk_size > 0))
+          determinize_min_chunk_size > 0 && determinize_horizon >= 0))
         KALDI_ERR << "Invalid options given to decoder";
     /* Minimization of the chunks is not compatible withour algorithm (or at
        least, would require additional complexity to implement.) */
@@ -187,6 +197,42 @@ struct LatticeIncrementalDecoderConfig {
 
 
 
+/**
+   This function is used in LatticeIncrementalDeterminizer::FreezePrefix() to
+   find where the lattice can be cut; it is declared here so that it can be
+   tested.  A state of `clat` (which must be acyclic) is `terminal` if it is
+   final or in `terminal_states`, and `live` if some terminal state is
+   reachable from it.  It finds the latest live state S, other than the start
+   state, that every path from the start state to a terminal state passes
+   through, that precedes all terminal states, and that is at most `max_frame`
+   frames after the start state.
+
+      @param [out] order  The states reachable from the start state, in
+                     topological order.
+      @param [out] live  Indexed by state-id; says which states are live.
+      @param [out] cut_frame  If S was found, the frame it is on (counted
+                     from the start state).
+      @return  Returns the position of S in `order`, or -1 if there is no such
+                     state.
+ */
+int32 FindLatticeCutState(
+    const CompactLattice &clat,
+    const std::unordered_set<CompactLattice::StateId> &terminal_states,
+    int32 max_frame,
+    std::vector<CompactLattice::StateId> *order,
+    std::vector<bool> *live,
+    int32 *cut_frame);
+
+/**
+   Appends `suffix` to `clat`, whose only final state (with final-prob One())
+   is identified with the start state of `suffix`.  This joins a lattice output
+   by LatticeIncrementalDeterminizer::FreezePrefix() to the lattice that
+   follows it.
+ */
+void AppendLatticeAtFinalState(const CompactLattice &suffix,
+                               CompactLattice *clat);
+
+
 /**
    This class is used inside LatticeIncrementalDecoderTpl; it handles
    some of the details of incremental determinization.
@@ -283,6 +329,29 @@ class LatticeIncrementalDeterminizer {
 
   const CompactLattice &GetLattice() { return clat_; }
 
+  /**
+     Freezes the beginning of the lattice, up to the latest state S that every
+     path from the start state to the part of clat_ that may still be
+     redeterminized (and to any final state) passes through, and that is at
+     most `max_frame` frames after the start state.  The part before S is
+     removed from clat_, and S becomes its start state; so subsequent chunks
+     and calls to GetLattice() don't have to deal with the frozen part.  Must
+     only be called between AcceptRawLatticeChunk() and the next
+     InitializeRawLatticeChunk().
+
+       @param [in] max_frame  The latest frame (counted from the start state
+                     of clat_) that S may be on.
+       @param [out] prefix  If a state S was found, the frozen part of the
+                     lattice is output to here, with S as its only final
+                     state (with final-prob One()).  Appending the lattice
+                     that remains in clat_ to it gives the lattice we had
+                     before.
+       @return  Returns the frame that S is on (i.e. the number of frames
+                     frozen), or 0 if no such state was found, in which case
+                     nothing was changed.
+   */
+  int32 FreezePrefix(int32 max_frame, CompactLattice *prefix);
+
   // kStateLabelOffset is what we add to state-ids in clat_ to produce labels
   // to identify them in the raw lattice chunk
   // kTokenLabelOffset is where we start allocating labels corresponding to Tokens
@@ -546,6 +615,11 @@ class LatticeIncrementalDecoderTpl {
       @return clat   The CompactLattice representing what has been decoded
                      up until `num_frames_to_include` (e.g., LatticeStateTimes()
                      on this lattice would return `num_frames_to_include`).
+                     If config_.determinize_horizon > 0, the parts of it
+                     that were frozen are joined to the rest of it here,
+                     except for those taken with TakeFrozenLattices(), in
+                     which case the lattice starts where the last lattice
+                     taken ends.
 
      See also UpdateLatticeDeterminizaton().  Caution: this const ref
      is only valid until the next time you call AdvanceDecoding() or
@@ -568,6 +642,25 @@ class LatticeIncrementalDecoderTpl {
    */
   int NumFramesInLattice() const { return num_frames_in_lattice_; }
 
+  /**
+     Returns the number of frames at the start of the utterance that have been
+     frozen, i.e. will not be changed by subsequent determinization.  Always
+     zero unless config_.determinize_horizon > 0.
+   */
+  int32 NumFramesFrozen() const { return num_frames_frozen_; }
+
+  /**
+     Outputs (appends to `lats`) the lattices that have been frozen since the
+     last call to this function, oldest first, and forgets them, so that
+     GetLattice() no longer includes them.  Each one has a single final state,
+     which corresponds to the start state of the next one (or of the lattice
+     returned by GetLattice(), for the newest one); AppendLatticeAtFinalState()
+     joins them.  These are stable: they will not change, however the rest of
+     the utterance is decoded.  Callers that write out the lattice as they go
+     can use this to keep the memory used bounded for long utterances.
+   */
+  void TakeFrozenLattices(std::vector<CompactLattice> *lats);
+
   /**
      InitDecoding initializes the decoding, and should only be used if you
      intend to call AdvanceDecoding().  If you call Decode(), you don't need to
@@ -622,7 +715,7 @@ class LatticeIncrementalDecoderTpl {
         : toks(NULL), must_prune_forward_links(true), must_prune_tokens(true),
           num_toks(-1) {}
   };
-  using Elem = typename HashList<StateId, Token *>::Elem;
+  using Elem = typename FlatHashList<StateId, Token *>::Elem;
   void PossiblyResizeHash(size_t num_toks);
   inline Token *FindOrAddToken(StateId state, int32 frame_plus_one,
                                BaseFloat tot_cost, Token *backpointer, bool *changed);
@@ -639,7 +732,14 @@ class LatticeIncrementalDecoderTpl {
   BaseFloat ProcessEmitting(DecodableInterface *decodable);
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  HashList<StateId, Token *> toks_;
+  /** Does the work of GetLattice(), but returns only the part of the lattice
+      that has not been frozen (i.e. determinizer_'s lattice), without the
+      cost of joining the frozen parts to it.  This is what we use for the
+      chunks determinized while decoding. */
+  const CompactLattice &GetUnfrozenLattice(int32 num_frames_to_include,
+                                           bool use_final_probs);
+
+  FlatHashList<StateId, Token *> toks_;
   std::vector<TokenList> active_toks_;  // indexed by frame.
   std::vector<StateId> queue_;       // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_; // used in GetCutoff.
@@ -671,6 +771,18 @@ class LatticeIncrementalDecoderTpl {
       for any prior call to GetLattice(). */
   int32 num_frames_in_lattice_;
 
+  /** The number of frames at the start of the utterance that have been frozen
+      and removed from determinizer_'s lattice; see
+      config_.determinize_horizon. */
+  int32 num_frames_frozen_;
+
+  /** The lattices frozen since the last call to TakeFrozenLattices(). */
+  std::vector<CompactLattice> frozen_lattices_;
+
+  /** frozen_lattices_ joined to determinizer_'s lattice; this is what
+      GetLattice() returns when frozen_lattices_ is nonempty. */
+  CompactLattice joined_clat_;
+
   // A map from Token to its token_label.  Will contain an entry for
   // each Token in active_toks_[num_frames_in_lattice_].
   unordered_map<Token*, Label> token2label_map_;
@@ -0,0 +1,164 @@
+// decoder/lookahead-decode-fst.h
+
+// Copyright 2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LOOKAHEAD_DECODE_FST_H_
+#define KALDI_DECODER_LOOKAHEAD_DECODE_FST_H_
+
+/**
+   This header defines LookaheadDecodeFst, a concrete FST type for decoding
+   from a delayed (e.g. lookahead-composed) graph with an arc mapping applied
+   on top of it.  The mapping itself is supplied by the user (for instance,
+   the dragonfly LAF decoder removes disambiguation symbols and disables
+   inactive rules), wrapped in a LookaheadDecodeMapper.
+
+   It has its own Type() ("lookahead-decode"), so that
+   LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> >::AdvanceDecoding() can
+   recognize it and switch to the instantiation templated on this exact type,
+   the same way it already does for ConstFst and VectorFst.  In that
+   instantiation Final(), NumInputEpsilons() and the arc iterator in the
+   decoder's inner loops are resolved at compile time instead of through the
+   virtual Fst interface.
+ */
+
+#include <memory>
+#include <type_traits>
+#include "base/kaldi-error.h"
+#include "fst/fstlib.h"
+
+namespace fst {
+
+
+/// LookaheadDecodeMapper is the arc mapper of LookaheadDecodeFst.  It
+/// forwards to a user-supplied implementation (see
+/// MakeLookaheadDecodeMapper()), so that the decoder can be instantiated for
+/// LookaheadDecodeFst without knowing about the mapping.  The implementation
+/// is only called when the ArcMapFst expands a state into its cache, so the
+/// virtual call does not reach the decoder's inner loops.
+class LookaheadDecodeMapper {
+ public:
+  using FromArc = StdArc;
+  using ToArc = StdArc;
+
+  class Impl {
+   public:
+    virtual StdArc Map(const StdArc &arc) const = 0;
+    virtual uint64 Properties(uint64 props) const = 0;
+    virtual MapSymbolsAction InputSymbolsAction() const = 0;
+    virtual MapSymbolsAction OutputSymbolsAction() const = 0;
+    virtual ~Impl() { }
+  };
+
+  explicit LookaheadDecodeMapper(std::shared_ptr<const Impl> impl)
+      : impl_(impl) { }
+
+  ToArc operator()(const FromArc &arc) const { return impl_->Map(arc); }
+
+  // The mapping must not need a superfinal state.
+  constexpr MapFinalAction FinalAction() const { return MAP_NO_SUPERFINAL; }
+
+  MapSymbolsAction InputSymbolsAction() const {
+    return impl_->InputSymbolsAction();
+  }
+
+  MapSymbolsAction OutputSymbolsAction() const {
+    return impl_->OutputSymbolsAction();
+  }
+
+  uint64 Properties(uint64 props) const { return impl_->Properties(props); }
+
+ private:
+  std::shared_ptr<const Impl> impl_;
+};
+
+
+/// Wraps "mapper", a StdArc-to-StdArc arc mapper (in the sense of ArcMapFst)
+/// whose FinalAction() is MAP_NO_SUPERFINAL, as a LookaheadDecodeMapper.
+template <class Mapper>
+LookaheadDecodeMapper MakeLookaheadDecodeMapper(const Mapper &mapper) {
+  class MapperImpl : public LookaheadDecodeMapper::Impl {
+   public:
+    explicit MapperImpl(const Mapper &mapper) : mapper_(mapper) { }
+    StdArc Map(const StdArc &arc) const override { return mapper_(arc); }
+    uint64 Properties(uint64 props) const override {
+      return mapper_.Properties(props);
+    }
+    MapSymbolsAction InputSymbolsAction() const override {
+      return mapper_.InputSymbolsAction();
+    }
+    MapSymbolsAction OutputSymbolsAction() const override {
+      return mapper_.OutputSymbolsAction();
+    }
+   private:
+    Mapper mapper_;
+  };
+  static_assert(std::is_same<typename Mapper::FromArc, StdArc>::value &&
+                std::is_same<typename Mapper::ToArc, StdArc>::value,
+                "LookaheadDecodeFst maps StdArc to StdArc");
+  KALDI_ASSERT(mapper.FinalAction() == MAP_NO_SUPERFINAL);
+  return LookaheadDecodeMapper(std::make_shared<const MapperImpl>(mapper));
+}
+
+
+/**
+   LookaheadDecodeFst is an ArcMapFst applying a LookaheadDecodeMapper to a
+   (delayed) graph.  It is declared final so that calls through a pointer or
+   reference of this type can be devirtualized, and it has its own ArcIterator
+   specialization (below) which goes directly to the ArcMapFst cache instead
+   of through Fst::InitArcIterator().  It remains a full fst::Fst, so it can
+   still be used anywhere a Fst<StdArc> is expected.
+ */
+class LookaheadDecodeFst final
+    : public ArcMapFst<StdArc, StdArc, LookaheadDecodeMapper> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef LookaheadDecodeMapper Mapper;
+  typedef ArcMapFst<StdArc, StdArc, Mapper> Base;
+
+  LookaheadDecodeFst(const Fst<StdArc> &fst, const Mapper &mapper,
+                     const ArcMapFstOptions &opts)
+      : Base(fst, mapper, opts) {
+    GetMutableImpl()->SetType("lookahead-decode");
+  }
+
+  // See Fst<>::Copy() for doc.
+  LookaheadDecodeFst(const LookaheadDecodeFst &fst, bool safe = false)
+      : Base(fst, safe) {
+    GetMutableImpl()->SetType("lookahead-decode");  // A safe copy re-Init()s.
+  }
+
+  // Get a copy of this LookaheadDecodeFst. See Fst<>::Copy() for further doc.
+  LookaheadDecodeFst *Copy(bool safe = false) const override {
+    return new LookaheadDecodeFst(*this, safe);
+  }
+};
+
+
+template <>
+class ArcIterator<LookaheadDecodeFst>
+    : public ArcIterator<LookaheadDecodeFst::Base> {
+ public:
+  ArcIterator(const LookaheadDecodeFst &fst, LookaheadDecodeFst::StateId s)
+      : ArcIterator<LookaheadDecodeFst::Base>(fst, s) {}
+};
+
+
+} // namespace fst
+
+#endif  // KALDI_DECODER_LOOKAHEAD_DECODE_FST_H_
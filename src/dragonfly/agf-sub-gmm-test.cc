@@ -0,0 +1,159 @@
+// agf-sub-gmm-test
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <fstream>
+
+#include "base/kaldi-math.h"
+#include "gmm/model-test-common.h"
+#include "hmm/hmm-test-utils.h"
+
+#include "agf-sub-gmm.h"
+
+namespace dragonfly {
+
+using namespace kaldi;
+
+const int32 kFeatDim = 13;  // default MFCC dimension, without deltas
+const std::string kModelFilename = "agf-sub-gmm-test.mdl",
+    kCmvnFilename = "agf-sub-gmm-test.cmvn",
+    kConfigFilename = "agf-sub-gmm-test.conf",
+    kWordsFilename = "agf-sub-gmm-test.words.txt";
+
+// Writes a random model, with a pdf per pdf-id, for the default MFCC features.
+TransitionModel* WriteRandModel(AmDiagGmm* am_gmm) {
+    ContextDependency* ctx_dep = nullptr;
+    TransitionModel* trans_model = GenRandTransitionModel(&ctx_dep);
+    delete ctx_dep;
+    for (int32 pdf = 0; pdf < trans_model->NumPdfs(); pdf++) {
+        DiagGmm gmm;
+        unittest::InitRandDiagGmm(kFeatDim, RandInt(1, 4), &gmm);
+        am_gmm->AddPdf(gmm);
+    }
+    Output ko(kModelFilename, true);
+    trans_model->Write(ko.Stream(), true);
+    am_gmm->Write(ko.Stream(), true);
+    return trans_model;
+}
+
+void WriteFiles() {
+    // Global CMVN stats with zero mean and unit variance.
+    Matrix<double> cmvn_stats(2, kFeatDim + 1);
+    cmvn_stats(0, kFeatDim) = 1000.0;
+    for (int32 d = 0; d < kFeatDim; d++)
+        cmvn_stats(1, d) = 1000.0;
+    WriteKaldiObject(cmvn_stats, kCmvnFilename, true);
+
+    std::ofstream config(kConfigFilename);
+    config << "--model=" << kModelFilename << "\n";
+    config << "--global-cmvn-stats=" << kCmvnFilename << "\n";
+
+    std::ofstream words(kWordsFilename);
+    words << "<eps> 0\none 1\n";
+}
+
+void RemoveFiles() {
+    std::remove(kModelFilename.c_str());
+    std::remove(kCmvnFilename.c_str());
+    std::remove(kConfigFilename.c_str());
+    std::remove(kWordsFilename.c_str());
+}
+
+// The batched likelihoods must match the frame-by-frame ones, whatever order the frames and pdfs are requested in.
+void TestDecodableAmDiagGmmScaledBatch(const TransitionModel& trans_model, const AmDiagGmm& am_gmm) {
+    Matrix<BaseFloat> feats(10 + RandInt(0, 10), kFeatDim);
+    feats.SetRandn();
+    BaseFloat scale = 0.1;
+    DecodableAmDiagGmmScaled decodable(am_gmm, trans_model, feats, scale),
+        batched_decodable(am_gmm, trans_model, feats, scale, -1.0, RandInt(2, 5));
+    KALDI_ASSERT(batched_decodable.NumFramesReady() == feats.NumRows());
+    for (int32 frame = 0; frame < feats.NumRows(); frame++) {
+        for (int32 i = 0; i < 20; i++) {
+            // Sometimes go back a frame, which starts a new batch.
+            int32 f = (frame > 0 && RandInt(0, 3) == 0) ? frame - 1 : frame,
+                tid = RandInt(1, trans_model.NumTransitionIds());
+            BaseFloat loglike = decodable.LogLikelihood(f, tid),
+                batched_loglike = batched_decodable.LogLikelihood(f, tid);
+            KALDI_ASSERT(ApproxEqual(loglike, batched_loglike, 1.0e-3));
+        }
+    }
+}
+
+// Top FST: the first frame outputs "one", and any transition-ids follow.
+StdVectorFst* CreateTopFst(const TransitionModel& trans_model) {
+    auto fst = new StdVectorFst();
+    auto start = fst->AddState(), end = fst->AddState();
+    fst->SetStart(start);
+    for (int32 tid = 1; tid <= trans_model.NumTransitionIds(); tid++) {
+        fst->AddArc(start, StdArc(tid, 1, 0.0, end));
+        fst->AddArc(end, StdArc(tid, 0, 0.0, end));
+    }
+    fst->SetFinal(end, StdArc::Weight::One());
+    ArcSort(fst, ILabelCompare<StdArc>());
+    return fst;
+}
+
+Vector<BaseFloat> RandWaveform(int32 num_samples) {
+    Vector<BaseFloat> samples(num_samples);
+    for (int32 i = 0; i < num_samples; i++)
+        samples(i) = 1000.0 * RandGauss();
+    return samples;
+}
+
+void TestAgfGmmOnlineModelWrapper(StdVectorFst* top_fst) {
+    std::stringstream config_ss;
+    config_ss << "{ \"online_config_filename\": \"" << kConfigFilename << "\""
+        << ", \"word_syms_filename\": \"" << kWordsFilename << "\""
+        << ", \"top_fst\": " << reinterpret_cast<uint64>(top_fst)
+        << ", \"nonterm_phones_offset\": 1000, \"frames_per_batch\": 3 }";
+    AgfGmmOnlineModelWrapper model(AgfGmmOnlineModelConfig::Create(".", config_ss.str()), -2);
+
+    std::string decoded_string;
+    float likelihood;
+    std::vector<bool> grammars_activity;
+
+    // Whole utterance at once.
+    KALDI_ASSERT(model.Decode(16000, RandWaveform(16000), true, grammars_activity));
+    model.GetDecodedString(decoded_string, &likelihood, nullptr, nullptr);
+    KALDI_ASSERT(decoded_string == "one");
+
+    // In chunks, with a partial result, carrying the CMVN state over from the first utterance.
+    KALDI_ASSERT(model.Decode(16000, RandWaveform(4000), false, grammars_activity));
+    model.GetDecodedString(decoded_string, nullptr, nullptr, nullptr);
+    KALDI_ASSERT(decoded_string == "one");
+    KALDI_ASSERT(model.Decode(16000, RandWaveform(4000), false, grammars_activity));
+    KALDI_ASSERT(model.Decode(16000, Vector<BaseFloat>(), true, grammars_activity));
+    model.GetDecodedString(decoded_string, &likelihood, nullptr, nullptr);
+    KALDI_ASSERT(decoded_string == "one");
+}
+
+}  // namespace dragonfly
+
+int main() {
+    using namespace dragonfly;
+    AmDiagGmm am_gmm;
+    TransitionModel* trans_model = WriteRandModel(&am_gmm);
+    WriteFiles();
+    for (int32 i = 0; i < 3; i++)
+        TestDecodableAmDiagGmmScaledBatch(*trans_model, am_gmm);
+    StdVectorFst* top_fst = CreateTopFst(*trans_model);
+    TestAgfGmmOnlineModelWrapper(top_fst);
+    delete top_fst;
+    delete trans_model;
+    RemoveFiles();
+    std::cout << "Test OK.\n";
+}
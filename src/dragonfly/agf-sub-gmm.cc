@@ -0,0 +1,338 @@
+// GMM AGF
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "feat/wave-reader.h"
+#include "online2/online-feature-pipeline.h"
+#include "online2/online-gmm-decoding.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "gmm/decodable-am-diag-gmm.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice-lexicon.h"
+#include "decoder/active-grammar-fst.h"
+#include "decoder/lattice-faster-decoder.h"
+
+#include "agf-sub-gmm.h"
+#include "utils.h"
+#include "kaldi-utils.h"
+#include "nlohmann_json.hpp"
+
+namespace dragonfly {
+
+using namespace kaldi;
+using namespace fst;
+
+AgfGmmOnlineModelWrapper::AgfGmmOnlineModelWrapper(AgfGmmOnlineModelConfig::Ptr config, int32 verbosity)
+    : BaseGmmOnlineModelWrapper(config, verbosity), config_(config) {
+    if ((config_->top_fst != 0) == !config_->top_fst_filename.empty()) KALDI_ERR << "AgfGmmOnlineModelWrapper requires exactly one of top_fst and top_fst_filename";
+    if (config_->top_fst != 0)
+        top_fst_ = new StdConstFst(*static_cast<StdVectorFst*>((void*)config_->top_fst));
+    if (!config_->top_fst_filename.empty())
+        top_fst_ = CastOrConvertToConstFst(ReadFstKaldiGeneric(config_->top_fst_filename));
+    KALDI_VLOG(2) << "top_fst @ 0x" << top_fst_ << " " << top_fst_->NumStates() << " states";
+
+    if (!config_->dictation_fst_filename.empty())
+        dictation_fst_ = ReadFstFile(config_->dictation_fst_filename);
+
+    if (config_->frames_per_batch < 1) KALDI_ERR << "frames_per_batch must be at least 1";
+}
+
+AgfGmmOnlineModelWrapper::~AgfGmmOnlineModelWrapper() {
+    CleanupDecoder();
+    delete top_fst_;
+    delete dictation_fst_;
+    for (auto grammar_fst : grammar_fsts_)
+        delete grammar_fst;
+    delete active_grammar_fst_;
+}
+
+StdConstFst* AgfGmmOnlineModelWrapper::ReadFstFile(std::string filename) {
+    if (filename.compare(filename.length() - 4, 4, ".txt") == 0) {
+        KALDI_WARN << "cannot read text fst file " << filename;
+        return nullptr;
+    } else {
+        auto fst = dynamic_cast<StdConstFst*>(ReadFstKaldiGeneric(filename));
+        if (!fst) KALDI_ERR << "could not load as StdConstFst";
+        return fst;
+    }
+}
+
+int32 AgfGmmOnlineModelWrapper::AddGrammarFst(fst::StdConstFst* grammar_fst, std::string grammar_name) {
+    InvalidateActiveGrammarFST();
+    auto grammar_fst_index = grammar_fsts_.size();
+    if (grammar_fst_index >= config_->max_num_rules) KALDI_ERR << "cannot add more than max number of rules";
+    KALDI_VLOG(2) << "adding FST #" << grammar_fst_index << " @ 0x" << grammar_fst << " " << grammar_fst->NumStates() << " states " << grammar_name;
+    grammar_fsts_.push_back(grammar_fst);
+    grammar_fsts_name_map_[grammar_fst] = grammar_name;
+    return grammar_fst_index;
+}
+
+int32 AgfGmmOnlineModelWrapper::AddGrammarFst(std::string& grammar_fst_filename) {
+    auto grammar_fst = ReadFstFile(grammar_fst_filename);
+    return AddGrammarFst(grammar_fst, grammar_fst_filename);
+}
+
+bool AgfGmmOnlineModelWrapper::ReloadGrammarFst(int32 grammar_fst_index, fst::StdConstFst* grammar_fst, std::string grammar_name) {
+    InvalidateActiveGrammarFST();
+    auto old_grammar_fst = grammar_fsts_.at(grammar_fst_index);
+    grammar_fsts_name_map_.erase(old_grammar_fst);
+    delete old_grammar_fst;
+
+    KALDI_VLOG(2) << "reloading FST #" << grammar_fst_index << " @ 0x" << grammar_fst << " " << grammar_fst->NumStates() << " states " << grammar_name;
+    grammar_fsts_.at(grammar_fst_index) = grammar_fst;
+    grammar_fsts_name_map_[grammar_fst] = grammar_name;
+    return true;
+}
+
+bool AgfGmmOnlineModelWrapper::ReloadGrammarFst(int32 grammar_fst_index, std::string& grammar_fst_filename) {
+    auto grammar_fst = ReadFstFile(grammar_fst_filename);
+    return ReloadGrammarFst(grammar_fst_index, grammar_fst, grammar_fst_filename);
+}
+
+bool AgfGmmOnlineModelWrapper::RemoveGrammarFst(int32 grammar_fst_index) {
+    InvalidateActiveGrammarFST();
+    auto grammar_fst = grammar_fsts_.at(grammar_fst_index);
+    KALDI_VLOG(2) << "removing FST #" << grammar_fst_index << " @ 0x" << grammar_fst << " " << grammar_fsts_name_map_.at(grammar_fst);
+    grammar_fsts_.erase(grammar_fsts_.begin() + grammar_fst_index);
+    grammar_fsts_name_map_.erase(grammar_fst);
+    delete grammar_fst;
+    return true;
+}
+
+bool AgfGmmOnlineModelWrapper::InvalidateActiveGrammarFST() {
+    if (DecoderReady()) KALDI_ERR << "cannot modify/invalidate GrammarFst in the middle of decoding!";
+    if (active_grammar_fst_) {
+        delete active_grammar_fst_;
+        active_grammar_fst_ = nullptr;
+        return true;
+    }
+    return false;
+}
+
+void AgfGmmOnlineModelWrapper::StartDecoding() {
+    ExecutionTimer timer("StartDecoding", 2);
+    BaseGmmOnlineModelWrapper::StartDecoding();
+
+    if (active_grammar_fst_ == nullptr) {
+        std::vector<std::pair<int32, const StdConstFst *> > ifsts;
+        for (auto grammar_fst : grammar_fsts_) {
+            int32 nonterm_phone = config_->rules_phones_offset + ifsts.size();
+            ifsts.emplace_back(std::make_pair(nonterm_phone, grammar_fst));
+        }
+        if (dictation_fst_ != nullptr) {
+            ifsts.emplace_back(std::make_pair(config_->dictation_phones_offset, dictation_fst_));
+        }
+        active_grammar_fst_ = new ActiveGrammarFst(config_->nonterm_phones_offset, *top_fst_, ifsts);
+    }
+
+    auto grammars_activity = grammars_activity_;
+    if (grammars_activity.size() != grammar_fsts_.size())
+        KALDI_ERR << "got activity for " << grammars_activity.size() << " grammars, but have " << grammar_fsts_.size();
+    if (dictation_fst_ != nullptr)
+        grammars_activity.push_back(true);  // dictation_fst_ is always enabled if present
+    active_grammar_fst_->UpdateActivity(grammars_activity);
+
+    feature_pipeline_ = feature_pipeline_prototype_->New();
+    feature_pipeline_->SetCmvnState(adaptation_state_.cmvn_state);
+    feats_.Resize(0, 0);
+    decoder_ = new LatticeFasterDecoderTpl<fst::ActiveGrammarFst>(*active_grammar_fst_, decode_config_.faster_decoder_opts);
+    decoder_->InitDecoding();
+}
+
+void AgfGmmOnlineModelWrapper::CleanupDecoder() {
+    delete decoder_;
+    decoder_ = nullptr;
+    delete feature_pipeline_;
+    feature_pipeline_ = nullptr;
+}
+
+bool AgfGmmOnlineModelWrapper::Decode(BaseFloat samp_freq, const Vector<BaseFloat>& samples, bool finalize, bool save_adaptation_state) {
+    ExecutionTimer timer("Decode", 2);
+
+    if (!DecoderReady())
+        StartDecoding();
+
+    if (samples.Dim() > 0)
+        feature_pipeline_->AcceptWaveform(samp_freq, samples);
+
+    if (finalize)
+        feature_pipeline_->InputFinished();  // No more input, so flush out last frames.
+
+    // DecodableAmDiagGmmScaled scores a matrix of features, so append the newly ready frames.
+    int32 num_frames_old = feats_.NumRows(), num_frames = feature_pipeline_->NumFramesReady();
+    if (num_frames > num_frames_old) {
+        feats_.Resize(num_frames, feature_pipeline_->Dim(), kCopyData);
+        for (int32 frame = num_frames_old; frame < num_frames; frame++) {
+            SubVector<BaseFloat> row(feats_, frame);
+            feature_pipeline_->GetFrame(frame, &row);
+        }
+    }
+
+    DecodableAmDiagGmmScaled decodable(gmm_models_->GetOnlineAlignmentModel(), gmm_models_->GetTransitionModel(), feats_,
+        decode_config_.acoustic_scale, -1.0, config_->frames_per_batch);
+    decoder_->AdvanceDecoding(&decodable);
+    tot_frames_ = decoder_->NumFramesDecoded();
+
+    if (finalize) {
+        ExecutionTimer timer("Decode finalize", 2);
+        decoder_->FinalizeDecoding();
+        decoder_finalized_ = true;
+
+        tot_frames_decoded_ += tot_frames_;
+        tot_frames_ = 0;
+
+        if (save_adaptation_state)
+            feature_pipeline_->GetCmvnState(&adaptation_state_.cmvn_state);
+
+        if (decoder_->NumFramesDecoded() == 0) {
+            KALDI_WARN << "Decoded no frames";
+            return false;
+        }
+        Lattice raw_lat;
+        decoder_->GetRawLattice(&raw_lat, true);
+        CompactLattice clat;
+        DeterminizeLatticePhonePrunedWrapper(gmm_models_->GetTransitionModel(), &raw_lat,
+            decode_config_.faster_decoder_opts.lattice_beam, &clat, decode_config_.faster_decoder_opts.det_opts);
+        if (clat.NumStates() == 0) {
+            KALDI_WARN << "Empty lattice";
+            return false;
+        }
+        CompactLatticeShortestPath(clat, &best_path_clat_);
+    }
+
+    return true;
+}
+
+// grammars_activity is ignored once decoding has already started
+bool AgfGmmOnlineModelWrapper::Decode(BaseFloat samp_freq, const Vector<BaseFloat>& samples, bool finalize,
+        const std::vector<bool>& grammars_activity, bool save_adaptation_state) {
+    SetActiveGrammars(grammars_activity);
+    return Decode(samp_freq, samples, finalize, save_adaptation_state);
+}
+
+void AgfGmmOnlineModelWrapper::GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) {
+    ExecutionTimer timer("GetDecodedString", 2);
+
+    decoded_string = "";
+    if (likelihood) *likelihood = NAN;
+    if (lm_score) *lm_score = NAN;
+    if (am_score) *am_score = NAN;
+
+    if (!decoder_) KALDI_ERR << "No decoder";
+    Lattice best_path_lat;
+    if (!decoder_finalized_) {
+        // Decoding is not finished yet, so we will just look up the best partial result so far
+        if (decoder_->NumFramesDecoded() == 0) return;
+        decoder_->GetBestPath(&best_path_lat, false);
+    } else {
+        if (best_path_clat_.NumStates() == 0) {
+            KALDI_WARN << "GetDecodedString on empty decoder";
+            return;
+        }
+        ConvertLattice(best_path_clat_, &best_path_lat);
+    }
+
+    BestPathToDecodedString(best_path_lat, decoded_string, likelihood, am_score, lm_score);
+}
+
+} // namespace dragonfly
+
+
+extern "C" {
+#include "dragonfly.h"
+}
+
+using namespace dragonfly;
+
+void* gmm_agf__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    std::string model_dir(model_dir_cp),
+        config_str((config_str_cp != nullptr) ? config_str_cp : "");
+    auto model = new AgfGmmOnlineModelWrapper(AgfGmmOnlineModelConfig::Create(model_dir, config_str), verbosity);
+    return model;
+    END_INTERFACE_CATCH_HANDLER(nullptr)
+}
+
+bool gmm_agf__destruct(void* model_vp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    delete model;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+int32_t gmm_agf__add_grammar_fst(void* model_vp, void* grammar_fst_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    auto fst = static_cast<StdVectorFst*>(grammar_fst_cp);
+    auto const_fst = new StdConstFst(*fst);
+    int32_t grammar_fst_index = model->AddGrammarFst(const_fst);
+    return grammar_fst_index;
+    END_INTERFACE_CATCH_HANDLER(-1)
+}
+
+int32_t gmm_agf__add_grammar_fst_file(void* model_vp, char* grammar_fst_filename_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    std::string grammar_fst_filename(grammar_fst_filename_cp);
+    int32_t grammar_fst_index = model->AddGrammarFst(grammar_fst_filename);
+    return grammar_fst_index;
+    END_INTERFACE_CATCH_HANDLER(-1)
+}
+
+bool gmm_agf__reload_grammar_fst(void* model_vp, int32_t grammar_fst_index, void* grammar_fst_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    auto fst = static_cast<StdVectorFst*>(grammar_fst_cp);
+    auto const_fst = new StdConstFst(*fst);  // Newly-created FST, to be owned by the AgfGmmOnlineModelWrapper, disentangled from the grammar_fst
+    bool result = model->ReloadGrammarFst(grammar_fst_index, const_fst);
+    return result;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_agf__reload_grammar_fst_file(void* model_vp, int32_t grammar_fst_index, char* grammar_fst_filename_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    std::string grammar_fst_filename(grammar_fst_filename_cp);
+    bool result = model->ReloadGrammarFst(grammar_fst_index, grammar_fst_filename);
+    return result;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_agf__remove_grammar_fst(void* model_vp, int32_t grammar_fst_index) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+    bool result = model->RemoveGrammarFst(grammar_fst_index);
+    return result;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_agf__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize,
+    bool* grammars_activity_cp, int32_t grammars_activity_cp_size, bool save_adaptation_state) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    if (grammars_activity_cp_size) {
+        auto model = static_cast<AgfGmmOnlineModelWrapper*>(model_vp);
+        std::vector<bool> grammars_activity(grammars_activity_cp_size, false);
+        for (size_t i = 0; i < grammars_activity_cp_size; i++)
+            grammars_activity[i] = grammars_activity_cp[i];
+        model->SetActiveGrammars(std::move(grammars_activity));
+    }
+    return gmm_base__decode(model_vp, samp_freq, num_samples, samples, finalize, save_adaptation_state);
+    END_INTERFACE_CATCH_HANDLER(false)
+}
@@ -59,6 +59,8 @@ AgfNNet3OnlineModelWrapper::AgfNNet3OnlineModelWrapper(AgfNNet3OnlineModelConfig
         last_rule_sym = first_rule_sym + 9999;
     rule_relabel_mapper_ = new CombineRuleNontermMapper<CompactLatticeArc>(first_rule_sym, last_rule_sym);
 
+    decoder_config_.lookahead_cost_scale = config_->lookahead_cost_scale;
+
     if (enable_carpa_) KALDI_ERR << "AgfNNet3OnlineModelWrapper does not support carpa rescoring";
     if (enable_rnnlm_) KALDI_ERR << "AgfNNet3OnlineModelWrapper does not support rnnlm rescoring";
 }
@@ -90,6 +92,7 @@ bool AgfNNet3OnlineModelWrapper::ReloadGrammarFst(int32 grammar_fst_index, fst::
     InvalidateActiveGrammarFST();
     auto old_grammar_fst = grammar_fsts_.at(grammar_fst_index);
     grammar_fsts_name_map_.erase(old_grammar_fst);
+    lookahead_costs_.erase(old_grammar_fst);
     delete old_grammar_fst;
 
     KALDI_VLOG(2) << "reloading FST #" << grammar_fst_index << " @ 0x" << grammar_fst << " " << grammar_fst->NumStates() << " states " << grammar_name;
@@ -109,6 +112,7 @@ bool AgfNNet3OnlineModelWrapper::RemoveGrammarFst(int32 grammar_fst_index) {
     KALDI_VLOG(2) << "removing FST #" << grammar_fst_index << " @ 0x" << grammar_fst << " " << grammar_fsts_name_map_.at(grammar_fst);
     grammar_fsts_.erase(grammar_fsts_.begin() + grammar_fst_index);
     grammar_fsts_name_map_.erase(grammar_fst);
+    lookahead_costs_.erase(grammar_fst);
     delete grammar_fst;
     return true;
 }
@@ -123,6 +127,19 @@ bool AgfNNet3OnlineModelWrapper::InvalidateActiveGrammarFST() {
     return false;
 }
 
+const std::vector<float>* AgfNNet3OnlineModelWrapper::GetLookaheadCosts(const StdConstFst* fst) {
+    // Computed once per FST, and kept until it is reloaded or removed.
+    auto iter = lookahead_costs_.find(fst);
+    if (iter == lookahead_costs_.end()) {
+        ExecutionTimer timer("ComputeGrammarFstLookaheadCosts", 2);
+        iter = lookahead_costs_.emplace(fst, std::vector<float>()).first;
+        // The decoder scales the costs by lookahead_cost_scale, so this adds lookahead_no_final_beams beams to the pruning cost.
+        auto no_final_cost = config_->lookahead_no_final_beams * decoder_config_.beam / config_->lookahead_cost_scale;
+        ComputeGrammarFstLookaheadCosts(*fst, no_final_cost, &iter->second);
+    }
+    return &iter->second;
+}
+
 void AgfNNet3OnlineModelWrapper::StartDecoding() {
     ExecutionTimer timer("StartDecoding", 2);
     BaseNNet3OnlineModelWrapper::StartDecoding();
@@ -137,6 +154,11 @@ void AgfNNet3OnlineModelWrapper::StartDecoding() {
             ifsts.emplace_back(std::make_pair(config_->dictation_phones_offset, dictation_fst_));
         }
         active_grammar_fst_ = new ActiveGrammarFst(config_->nonterm_phones_offset, *top_fst_, ifsts);
+        if (config_->lookahead_cost_scale > 0) {
+            active_grammar_fst_->SetLookaheadCosts(-1, GetLookaheadCosts(top_fst_));
+            for (int32 i = 0; i < ifsts.size(); ++i)
+                active_grammar_fst_->SetLookaheadCosts(i, GetLookaheadCosts(ifsts[i].second));
+        }
     }
 
     auto grammars_activity = grammars_activity_;
@@ -434,6 +456,14 @@ void* nnet3_agf__compile_graph_text(void* compiler_vp, char* config_str_cp, char
     END_INTERFACE_CATCH_HANDLER(nullptr)
 }
 
+void* nnet3_agf__compile_graph_text_int(void* compiler_vp, char* config_str_cp, char* grammar_fst_text_cp, bool return_graph) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    StdVectorFst fst;
+    ParseIntegerFstText(grammar_fst_text_cp, &fst);
+    return nnet3_agf__compile_graph(compiler_vp, config_str_cp, &fst, return_graph);
+    END_INTERFACE_CATCH_HANDLER(nullptr)
+}
+
 void* nnet3_agf__compile_graph_file(void* compiler_vp, char* config_str_cp, char* grammar_fst_filename_cp, bool return_graph) {
     BEGIN_INTERFACE_CATCH_HANDLER
     auto fst = ReadFstKaldiGeneric(grammar_fst_filename_cp);
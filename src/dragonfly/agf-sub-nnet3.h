@@ -55,6 +55,8 @@ struct AgfNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
     std::string top_fst_filename;
     std::string dictation_fst_filename;
     int32 max_num_rules = 9999;
+    BaseFloat lookahead_cost_scale = 0.0;  // Prune with per-state best costs to the end of each FST; see LatticeFasterDecoderConfig::lookahead_cost_scale
+    BaseFloat lookahead_no_final_beams = 10.0;  // Pruning cost, in beams, added to states that cannot reach the end of their FST: enough to prune them whenever anything else is in the beam
 
     bool Set(const std::string& name, const nlohmann::json& value) override {
         if (BaseNNet3OnlineModelConfig::Set(name, value)) { return true; }
@@ -65,6 +67,8 @@ struct AgfNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
         if (name == "top_fst_filename") { value.get_to(top_fst_filename); return true; }
         if (name == "dictation_fst_filename") { value.get_to(dictation_fst_filename); return true; }
         if (name == "max_num_rules") { value.get_to(max_num_rules); return true; }
+        if (name == "lookahead_cost_scale") { value.get_to(lookahead_cost_scale); return true; }
+        if (name == "lookahead_no_final_beams") { value.get_to(lookahead_no_final_beams); return true; }
         return false;
     }
 
@@ -79,6 +83,8 @@ struct AgfNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
         ss << "\n    " << "top_fst_filename: " << top_fst_filename;
         ss << "\n    " << "dictation_fst_filename: " << dictation_fst_filename;
         ss << "\n    " << "max_num_rules: " << max_num_rules;
+        ss << "\n    " << "lookahead_cost_scale: " << lookahead_cost_scale;
+        ss << "\n    " << "lookahead_no_final_beams: " << lookahead_no_final_beams;
         return ss.str();
     }
 };
@@ -111,6 +117,7 @@ class AgfNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         std::map<StdFst*, std::string> grammar_fsts_name_map_;  // maps grammar_fst -> name; for debugging
         // INVARIANT: same size: grammar_fsts_, grammar_fsts_name_map_
         std::vector<bool> grammars_activity_;  // bitfield of whether each grammar is active for current/upcoming utterance
+        std::map<const StdConstFst*, std::vector<float>> lookahead_costs_;  // maps FST -> its lookahead costs; only if lookahead_cost_scale > 0
 
         // Model objects
         ActiveGrammarFst* active_grammar_fst_ = nullptr;
@@ -120,6 +127,7 @@ class AgfNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         CombineRuleNontermMapper<CompactLatticeArc>* rule_relabel_mapper_ = nullptr;
 
         bool InvalidateActiveGrammarFST();
+        const std::vector<float>* GetLookaheadCosts(const StdConstFst* fst);
         void StartDecoding() override;
         void CleanupDecoder() override;
 };
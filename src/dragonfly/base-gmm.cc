@@ -0,0 +1,210 @@
+// GMM Base
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "feat/wave-reader.h"
+#include "online2/online-feature-pipeline.h"
+#include "online2/online-gmm-decoding.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice-lexicon.h"
+
+#include "base-gmm.h"
+#include "utils.h"
+#include "kaldi-utils.h"
+#include "nlohmann_json.hpp"
+
+namespace dragonfly {
+
+using namespace kaldi;
+using namespace fst;
+
+BaseGmmOnlineModelWrapper::BaseGmmOnlineModelWrapper(BaseGmmOnlineModelConfig::Ptr config, int32 verbosity)
+    : config_(std::move(config)) {
+    SetVerboseLevel(verbosity);
+    if (verbosity >= 0) {
+        KALDI_LOG << "Verbosity: " << verbosity;
+    } else if (verbosity == -1) {
+        SetLogHandler([](const LogMessageEnvelope& envelope, const char* message) {
+            if (envelope.severity <= LogMessageEnvelope::kWarning) {
+                std::cerr << "[KALDI severity=" << envelope.severity << "] " << message << "\n";
+            }
+        });
+    } else {
+        // Silence kaldi output as well (even warnings and errors!)
+        SetLogHandler([](const LogMessageEnvelope& envelope, const char* message) {});
+    }
+
+    KALDI_LOG << config_->ToString();
+
+    ExecutionTimer timer("Initialization/loading");
+
+    if (config_->online_config_filename.empty()) KALDI_ERR << "GMM model wrappers require online_config_filename";
+    ParseOptions po("");
+    feature_cmdline_config_.Register(&po);
+    decode_config_.Register(&po);
+    po.ReadConfigFile(config_->online_config_filename);
+
+    decode_config_.faster_decoder_opts.max_active = config_->max_active;
+    decode_config_.faster_decoder_opts.min_active = config_->min_active;
+    decode_config_.faster_decoder_opts.beam = config_->beam;
+    decode_config_.faster_decoder_opts.lattice_beam = config_->lattice_beam;
+
+    feature_config_ = new OnlineFeaturePipelineConfig(feature_cmdline_config_);
+    feature_pipeline_prototype_ = new OnlineFeaturePipeline(*feature_config_);
+    gmm_models_ = new OnlineGmmDecodingModels(decode_config_);
+
+    if (!config_->word_syms_filename.empty())
+        if (!(word_syms_ = fst::SymbolTable::ReadText(config_->word_syms_filename)))
+            KALDI_ERR << "Could not read symbol table from file " << config_->word_syms_filename;
+
+    if (!config_->word_align_lexicon_filename.empty()) {
+        bool binary_in;
+        Input ki(config_->word_align_lexicon_filename, &binary_in);
+        KALDI_ASSERT(!binary_in && "Not expecting binary file for lexicon");
+        std::vector<std::vector<int32> > word_align_lexicon;
+        if (!ReadLexiconForWordAlign(ki.Stream(), &word_align_lexicon))
+            KALDI_ERR << "Error reading word alignment lexicon from file " << config_->word_align_lexicon_filename;
+        linear_word_aligner_ = new LinearWordAligner(word_align_lexicon, word_syms_);
+    }
+}
+
+BaseGmmOnlineModelWrapper::~BaseGmmOnlineModelWrapper() {
+    delete word_syms_;
+    delete linear_word_aligner_;
+    delete feature_config_;
+    delete feature_pipeline_prototype_;
+    delete gmm_models_;
+}
+
+void BaseGmmOnlineModelWrapper::StartDecoding() {
+    CleanupDecoder();
+    decoder_finalized_ = false;
+    tot_frames_ = 0;
+    best_path_clat_.DeleteStates();
+}
+
+void BaseGmmOnlineModelWrapper::BestPathToDecodedString(const Lattice& best_path_lat, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) {
+    std::vector<int32> words;
+    std::vector<int32> alignment;
+    LatticeWeight weight;
+    bool ok = GetLinearSymbolSequence(best_path_lat, &alignment, &words, &weight);
+    if (!ok) KALDI_ERR << "GetLinearSymbolSequence returned false";
+
+    int32 num_frames = alignment.size();
+    if (lm_score) *lm_score = weight.Value1();
+    if (am_score) *am_score = weight.Value2();
+    if (likelihood) *likelihood = expf(-(weight.Value1() + weight.Value2()) / num_frames);
+
+    decoded_string = WordIdsToString(words);
+}
+
+bool BaseGmmOnlineModelWrapper::GetWordAlignment(std::vector<string>& words, std::vector<int32>& times, std::vector<int32>& lengths, bool include_eps) {
+    if (!linear_word_aligner_) KALDI_ERR << "No word alignment lexicon loaded";
+    if (best_path_clat_.NumStates() == 0) KALDI_ERR << "No best path lattice";
+
+    std::vector<int32> word_idxs, times_raw, lengths_raw;
+    if (!linear_word_aligner_->Align(best_path_clat_, gmm_models_->GetTransitionModel(), &word_idxs, &times_raw, &lengths_raw)) {
+        KALDI_WARN << "Best path did not align correctly";
+        return false;
+    }
+
+    words.clear();
+    for (size_t i = 0; i < word_idxs.size(); i++) {
+        if (include_eps || (word_idxs[i] != 0)) {
+            words.push_back(word_syms_->Find(word_idxs[i]));
+            times.push_back(times_raw[i]);
+            lengths.push_back(lengths_raw[i]);
+        }
+    }
+    return true;
+}
+
+std::string BaseGmmOnlineModelWrapper::WordIdsToString(const std::vector<int32>& word_ids) {
+    stringstream text;
+    for (size_t i = 0; i < word_ids.size(); i++) {
+        std::string s = word_syms_->Find(word_ids[i]);
+        if (s == "") {
+            KALDI_WARN << "Word-id " << word_ids[i] << " not in symbol table";
+            s = "MISSING_WORD";
+        }
+        if (i != 0) text << " ";
+        text << s;
+    }
+    return text.str();
+}
+
+} // namespace dragonfly
+
+
+extern "C" {
+#include "dragonfly.h"
+}
+
+using namespace dragonfly;
+
+bool gmm_base__reset_adaptation_state(void* model_vp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<BaseGmmOnlineModelWrapper*>(model_vp);
+    model->ResetAdaptationState();
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_base__get_word_align(void* model_vp, int32_t* times_cp, int32_t* lengths_cp, int32_t num_words) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<BaseGmmOnlineModelWrapper*>(model_vp);
+    std::vector<string> words;
+    std::vector<int32> times, lengths;
+    bool result = model->GetWordAlignment(words, times, lengths, false);
+    if (result) {
+        KALDI_ASSERT(words.size() == num_words);
+        for (size_t i = 0; i < words.size(); i++) {
+            times_cp[i] = times[i];
+            lengths_cp[i] = lengths[i];
+        }
+    } else {
+        KALDI_WARN << "alignment failed";
+    }
+    return result;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_base__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize, bool save_adaptation_state) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<BaseGmmOnlineModelWrapper*>(model_vp);
+    Vector<BaseFloat> wave_data(num_samples, kUndefined);
+    for (int i = 0; i < num_samples; i++)
+        wave_data(i) = samples[i];
+    return model->Decode(samp_freq, wave_data, finalize, save_adaptation_state);
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool gmm_base__get_output(void* model_vp, char* output, int32_t output_max_length,
+        float* likelihood_p, float* am_score_p, float* lm_score_p) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<BaseGmmOnlineModelWrapper*>(model_vp);
+    if (output_max_length < 1) return false;
+    std::string decoded_string;
+    model->GetDecodedString(decoded_string, likelihood_p, am_score_p, lm_score_p);
+    const char* cstr = decoded_string.c_str();
+    strncpy(output, cstr, output_max_length);
+    output[output_max_length - 1] = 0;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
@@ -0,0 +1,122 @@
+// GMM Base
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "feat/wave-reader.h"
+#include "online2/online-feature-pipeline.h"
+#include "online2/online-gmm-decoding.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice-lexicon.h"
+
+#include "base-nnet3.h"
+#include "utils.h"
+#include "kaldi-utils.h"
+#include "nlohmann_json.hpp"
+
+namespace dragonfly {
+
+using namespace kaldi;
+using namespace fst;
+
+struct BaseGmmOnlineModelConfig {
+    using Ptr = std::shared_ptr<BaseGmmOnlineModelConfig>;
+
+    BaseFloat beam = 14.0;  // see LatticeFasterDecoderConfig
+    int32 max_active = 14000;  // see LatticeFasterDecoderConfig
+    int32 min_active = 200;  // see LatticeFasterDecoderConfig
+    BaseFloat lattice_beam = 5.0;  // see LatticeFasterDecoderConfig
+    std::string model_dir;
+    std::string online_config_filename;  // Kaldi config file for OnlineGmmDecodingConfig & OnlineFeaturePipelineCommandLineConfig, as for online2-wav-gmm-latgen-faster
+    std::string word_syms_filename;
+    std::string word_align_lexicon_filename;
+
+    virtual bool Set(const std::string& name, const nlohmann::json& value) {
+        if (name == "beam") { value.get_to(beam); return true; }
+        if (name == "max_active") { value.get_to(max_active); return true; }
+        if (name == "min_active") { value.get_to(min_active); return true; }
+        if (name == "lattice_beam") { value.get_to(lattice_beam); return true; }
+        if (name == "model_dir") { value.get_to(model_dir); return true; }
+        if (name == "online_config_filename") { value.get_to(online_config_filename); return true; }
+        if (name == "word_syms_filename") { value.get_to(word_syms_filename); return true; }
+        if (name == "word_align_lexicon_filename") { value.get_to(word_align_lexicon_filename); return true; }
+        return false;
+    }
+
+    virtual std::string ToString() {
+        stringstream ss;
+        ss << "BaseGmmOnlineModelConfig...";
+        ss << "\n    " << "beam: " << beam;
+        ss << "\n    " << "max_active: " << max_active;
+        ss << "\n    " << "min_active: " << min_active;
+        ss << "\n    " << "lattice_beam: " << lattice_beam;
+        ss << "\n    " << "model_dir: " << model_dir;
+        ss << "\n    " << "online_config_filename: " << online_config_filename;
+        ss << "\n    " << "word_syms_filename: " << word_syms_filename;
+        ss << "\n    " << "word_align_lexicon_filename: " << word_align_lexicon_filename;
+        return ss.str();
+    }
+};
+
+// Shared by the GMM wrappers, as BaseNNet3OnlineModelWrapper is by the nnet3 ones: the models are loaded once, and
+// each subclass reinstantiates its decoder per utterance.
+class BaseGmmOnlineModelWrapper {
+    public:
+
+        BaseGmmOnlineModelWrapper(BaseGmmOnlineModelConfig::Ptr config, int32 verbosity = DEFAULT_VERBOSITY);
+        virtual ~BaseGmmOnlineModelWrapper();
+
+        void ResetAdaptationState() { adaptation_state_ = OnlineGmmAdaptationState(); };
+        virtual bool GetWordAlignment(std::vector<string>& words, std::vector<int32>& times, std::vector<int32>& lengths, bool include_eps);
+
+        virtual bool Decode(BaseFloat samp_freq, const Vector<BaseFloat>& frames, bool finalize, bool save_adaptation_state = true) = 0;
+        virtual void GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) = 0;
+
+    protected:
+
+        BaseGmmOnlineModelConfig::Ptr config_;
+
+        // Model
+        fst::SymbolTable* word_syms_ = nullptr;
+        LinearWordAligner* linear_word_aligner_ = nullptr;
+
+        // Model objects
+        OnlineGmmDecodingConfig decode_config_;
+        OnlineFeaturePipelineCommandLineConfig feature_cmdline_config_;
+        OnlineFeaturePipelineConfig* feature_config_ = nullptr;
+        OnlineFeaturePipeline* feature_pipeline_prototype_ = nullptr;
+        OnlineGmmDecodingModels* gmm_models_ = nullptr;
+
+        // Decoder objects
+        OnlineGmmAdaptationState adaptation_state_;  // carried across utterances
+
+        // Miscellaneous
+        int32 tot_frames_ = 0, tot_frames_decoded_ = 0;  // frames decoded in the current utterance, and in all finished ones
+        bool decoder_finalized_ = false;
+        CompactLattice best_path_clat_;
+
+        void BestPathToDecodedString(const Lattice& best_path_lat, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score);
+        std::string WordIdsToString(const std::vector<int32>& word_ids);
+
+        virtual void StartDecoding();
+        virtual void CleanupDecoder() {};
+};
+
+} // namespace dragonfly
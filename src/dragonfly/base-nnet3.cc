@@ -133,6 +133,8 @@ BaseNNet3OnlineModelWrapper::BaseNNet3OnlineModelWrapper(BaseNNet3OnlineModelCon
     decoder_config_.min_active = config_->min_active;
     decoder_config_.beam = config_->beam;
     decoder_config_.lattice_beam = config_->lattice_beam;
+    decoder_config_.num_emitting_threads = config_->decoder_threads;
+    decoder_config_.precompute_loglikes = config_->precompute_loglikes;
     ResetAdaptationState();
 
     LoadLexicon(config_->word_syms_filename, config_->word_align_lexicon_filename);
@@ -144,11 +146,16 @@ BaseNNet3OnlineModelWrapper::BaseNNet3OnlineModelWrapper(BaseNNet3OnlineModelCon
         if (config_->carpa_filename.empty()) KALDI_ERR << "carpa_filename not set";
         ReadKaldiObject(config_->model_dir + "/" + config_->carpa_filename, &carpa_);
 
-        VectorFst<StdArc> *lm_to_subtract_fst = ReadAndPrepareLmFst(config_->model_dir + "/" + config_->orig_grammar_filename);  // FIXME: manage this and delete it, and share
-        fst::CacheOptions cache_opts(true, 50000000);  // Faster than 50000?
-        fst::MapFstOptions mapfst_opts(cache_opts);
-        fst::StdToLatticeMapper<kaldi::BaseFloat> mapper;
-        unscore_lm_fst_ = new fst::MapFst<fst::StdArc, kaldi::LatticeArc, fst::StdToLatticeMapper<kaldi::BaseFloat> >(*lm_to_subtract_fst, mapper, mapfst_opts);
+        carpa_lm_to_subtract_fst_ = ReadAndPrepareLmFst(config_->model_dir + "/" + config_->orig_grammar_filename);
+        if (config_->carpa_pruned_rescoring) {
+            carpa_lm_to_subtract_det_backoff_ = new BackoffDeterministicOnDemandFst<StdArc>(*carpa_lm_to_subtract_fst_);
+            carpa_lm_to_subtract_det_scale_ = new ScaleDeterministicOnDemandFst(-carpa_scale_, carpa_lm_to_subtract_det_backoff_);
+        } else {
+            fst::CacheOptions cache_opts(true, 50000000);  // Faster than 50000?
+            fst::MapFstOptions mapfst_opts(cache_opts);
+            fst::StdToLatticeMapper<kaldi::BaseFloat> mapper;
+            unscore_lm_fst_ = new fst::MapFst<fst::StdArc, kaldi::LatticeArc, fst::StdToLatticeMapper<kaldi::BaseFloat> >(*carpa_lm_to_subtract_fst_, mapper, mapfst_opts);
+        }
     } else if (!config_->carpa_filename.empty())
         KALDI_ERR << "enable_carpa_ is false, but some carpa options are set";
 
@@ -170,6 +177,8 @@ BaseNNet3OnlineModelWrapper::BaseNNet3OnlineModelWrapper(BaseNNet3OnlineModelCon
         rnnlm_opts_.bos_index = word_syms_->Find("<s>");
         rnnlm_opts_.eos_index = word_syms_->Find("</s>");
         rnnlm_info_ = new rnnlm::RnnlmComputeStateInfo(rnnlm_opts_, rnnlm_, word_embedding_mat_);
+        if (config_->rnnlm_state_cache_size > 0)
+            rnnlm_state_cache_ = new rnnlm::RnnlmComputeStateCache(*rnnlm_info_, config_->rnnlm_state_cache_size);
         rnnlm_max_ngram_order_ = 4;
     } else if (!config_->rnnlm_nnet_filename.empty() || !config_->rnnlm_word_embed_filename.empty())
         KALDI_ERR << "enable_rnnlm_ is false, but some rnnlm options are set";
@@ -185,6 +194,12 @@ BaseNNet3OnlineModelWrapper::~BaseNNet3OnlineModelWrapper() {
     delete decodable_info_;
     delete adaptation_state_;
     delete word_align_lexicon_info_;
+    delete linear_word_aligner_;
+    delete rnnlm_state_cache_;
+    delete carpa_lm_to_subtract_det_scale_;
+    delete carpa_lm_to_subtract_det_backoff_;
+    delete unscore_lm_fst_;
+    delete carpa_lm_to_subtract_fst_;
 }
 
 bool BaseNNet3OnlineModelWrapper::LoadLexicon(std::string& word_syms_filename, std::string& word_align_lexicon_filename) {
@@ -209,9 +224,8 @@ bool BaseNNet3OnlineModelWrapper::LoadLexicon(std::string& word_syms_filename, s
             delete word_align_lexicon_info_;
         word_align_lexicon_info_ = new WordAlignLatticeLexiconInfo(word_align_lexicon_);
 
-        word_align_lexicon_words_.clear();
-        for (auto entry : word_align_lexicon_)
-            word_align_lexicon_words_.insert(entry.at(0));
+        delete linear_word_aligner_;
+        linear_word_aligner_ = new LinearWordAligner(word_align_lexicon_, word_syms_);
     }
 
     return true;
@@ -290,39 +304,40 @@ bool BaseNNet3OnlineModelWrapper::GetWordAlignment(std::vector<string>& words, s
     if (!word_align_lexicon_.size() || !word_align_lexicon_info_) KALDI_ERR << "No word alignment lexicon loaded";
     if (best_path_clat_.NumStates() == 0) KALDI_ERR << "No best path lattice";
 
-    // if (!best_path_has_valid_word_align) {
-    //     KALDI_ERR << "There was a word not in word alignment lexicon";
-    // }
-    // if (!word_align_lexicon_words_.count(words[i])) {
-    //     KALDI_LOG << "Word " << s << " (id #" << words[i] << ") not in word alignment lexicon";
-    // }
-
-    CompactLattice aligned_clat;
-    WordAlignLatticeLexiconOpts opts;
-    bool ok = WordAlignLatticeLexicon(best_path_clat_, trans_model_, *word_align_lexicon_info_, opts, &aligned_clat);
+    std::vector<int32> word_idxs, times_raw, lengths_raw;
+    bool ok = false;
+    if (config_->linear_word_alignment && linear_word_aligner_) {
+        ok = linear_word_aligner_->Align(best_path_clat_, trans_model_, &word_idxs, &times_raw, &lengths_raw);
+        if (!ok) KALDI_VLOG(1) << "Linear word alignment failed; falling back to lattice word alignment";
+    }
 
     if (!ok) {
-        KALDI_WARN << "Lattice did not align correctly";
-        return false;
-    }
+        CompactLattice aligned_clat;
+        WordAlignLatticeLexiconOpts opts;
+        ok = WordAlignLatticeLexicon(best_path_clat_, trans_model_, *word_align_lexicon_info_, opts, &aligned_clat);
 
-    if (aligned_clat.Start() == fst::kNoStateId) {
-        KALDI_WARN << "Lattice was empty";
-        return false;
-    }
+        if (!ok) {
+            KALDI_WARN << "Lattice did not align correctly";
+            return false;
+        }
 
-    TopSortCompactLatticeIfNeeded(&aligned_clat);
+        if (aligned_clat.Start() == fst::kNoStateId) {
+            KALDI_WARN << "Lattice was empty";
+            return false;
+        }
 
-    // lattice-1best
-    CompactLattice best_path_aligned;
-    CompactLatticeShortestPath(aligned_clat, &best_path_aligned);
+        TopSortCompactLatticeIfNeeded(&aligned_clat);
 
-    // nbest-to-ctm
-    std::vector<int32> word_idxs, times_raw, lengths_raw;
-    ok = CompactLatticeToWordAlignment(best_path_aligned, &word_idxs, &times_raw, &lengths_raw);
-    if (!ok) {
-        KALDI_WARN << "CompactLatticeToWordAlignment failed.";
-        return false;
+        // lattice-1best
+        CompactLattice best_path_aligned;
+        CompactLatticeShortestPath(aligned_clat, &best_path_aligned);
+
+        // nbest-to-ctm
+        ok = CompactLatticeToWordAlignment(best_path_aligned, &word_idxs, &times_raw, &lengths_raw);
+        if (!ok) {
+            KALDI_WARN << "CompactLatticeToWordAlignment failed.";
+            return false;
+        }
     }
 
     // lexicon lookup
@@ -340,7 +355,38 @@ bool BaseNNet3OnlineModelWrapper::GetWordAlignment(std::vector<string>& words, s
 }
 
 void BaseNNet3OnlineModelWrapper::RescoreConstArpaLm(CompactLattice& clat) {
+    if (!config_->carpa_pruned_rescoring) {
+        RescoreConstArpaLmDeterminized(clat);
+        return;
+    }
     ExecutionTimer timer("carpa rescoring");
+    // See lattice-lmrescore-pruned.cc: subtracts the old LM and adds the CARPA LM in a single pruned composition, like
+    // RescoreRnnlm, instead of two full compose + DeterminizeLattice passes.
+    ConstArpaLmDeterministicFst const_arpa_fst(carpa_);
+    ScaleDeterministicOnDemandFst lm_to_add(carpa_scale_, &const_arpa_fst);
+    ComposeDeterministicOnDemandFst<StdArc> combined_lms(carpa_lm_to_subtract_det_scale_, &lm_to_add);
+
+    if (decodable_config_.acoustic_scale != 1.0)
+        ScaleLattice(AcousticLatticeScale(decodable_config_.acoustic_scale), &clat);
+    TopSortCompactLatticeIfNeeded(&clat);
+
+    CompactLattice composed_clat;
+    ComposeCompactLatticePruned(carpa_compose_opts_, clat, &combined_lms, &composed_clat);
+
+    if (composed_clat.NumStates() == 0) {
+        // Something went wrong. A warning will already have been printed.
+        KALDI_WARN << "Empty lattice after CARPA rescoring (incompatible LM?); keeping original";
+        if (decodable_config_.acoustic_scale != 1.0)
+            ScaleLattice(AcousticLatticeScale(1.0 / decodable_config_.acoustic_scale), &clat);
+    } else {
+        if (decodable_config_.acoustic_scale != 1.0)
+            ScaleLattice(AcousticLatticeScale(1.0 / decodable_config_.acoustic_scale), &composed_clat);
+        clat = composed_clat;
+    }
+}
+
+void BaseNNet3OnlineModelWrapper::RescoreConstArpaLmDeterminized(CompactLattice& clat) {
+    ExecutionTimer timer("carpa rescoring (determinized)");
     // See lattice-lmrescore.cc
     Lattice lat1;
     ConvertLattice(clat, &lat1);
@@ -369,7 +415,11 @@ void BaseNNet3OnlineModelWrapper::RescoreConstArpaLm(CompactLattice& clat) {
 void BaseNNet3OnlineModelWrapper::RescoreRnnlm(CompactLattice& clat, const std::string& prime_text) {
     ExecutionTimer timer("rnnlm rescoring");
     // See lattice-lmrescore-kaldi-rnnlm-pruned.cc
-    rnnlm::KaldiRnnlmDeterministicFst lm_to_add_orig(rnnlm_max_ngram_order_, *rnnlm_info_);
+    // With the cache, RNNLM states for histories (including priming text) already seen in earlier utterances are reused
+    std::unique_ptr<rnnlm::KaldiRnnlmDeterministicFst> lm_to_add_orig_ptr((rnnlm_state_cache_)
+        ? new rnnlm::KaldiRnnlmDeterministicFst(rnnlm_max_ngram_order_, rnnlm_state_cache_)
+        : new rnnlm::KaldiRnnlmDeterministicFst(rnnlm_max_ngram_order_, *rnnlm_info_));
+    auto& lm_to_add_orig = *lm_to_add_orig_ptr;
 
     if (!prime_text.empty()) {
         istringstream iss(prime_text);
@@ -412,6 +462,9 @@ void BaseNNet3OnlineModelWrapper::RescoreRnnlm(CompactLattice& clat, const std::
     }
 
     delete lm_to_add;
+    if (rnnlm_state_cache_)
+        KALDI_VLOG(1) << "RNNLM state cache: " << rnnlm_state_cache_->NumStates() << " states, "
+            << rnnlm_state_cache_->NumHits() << " hits, " << rnnlm_state_cache_->NumMisses() << " misses";
 }
 
 template <typename Decoder>
@@ -41,14 +41,6 @@
 
 #define DEFAULT_VERBOSITY 0
 
-#define BEGIN_INTERFACE_CATCH_HANDLER \
-    try {
-#define END_INTERFACE_CATCH_HANDLER(expr) \
-    } catch(const std::exception& e) { \
-        KALDI_WARN << "Trying to survive fatal exception: " << e.what(); \
-        return (expr); \
-    }
-
 namespace dragonfly {
 
 using namespace kaldi;
@@ -61,6 +53,8 @@ struct BaseNNet3OnlineModelConfig {
     int32 max_active = 14000;  // Kaldi recipe is 7000; see LatticeFasterDecoderConfig.
     int32 min_active = 200;  // Kaldi recipe is ???; see LatticeFasterDecoderConfig.
     BaseFloat lattice_beam = 5.0;  // Kaldi recipe is 4.0?; see LatticeFasterDecoderConfig.
+    int32 decoder_threads = 1;  // Threads for token propagation within an utterance; see LatticeFasterDecoderConfig::num_emitting_threads
+    bool precompute_loglikes = true;  // Gather all transition-id scores once per frame; see LatticeFasterDecoderConfig::precompute_loglikes
     BaseFloat acoustic_scale = 1.0;
     BaseFloat lm_weight = 7.0;  // 10.0 would be "neutral", with no scaling
     BaseFloat silence_weight = 1.0;  // default (1.0) means silence weighting disabled
@@ -72,15 +66,18 @@ struct BaseNNet3OnlineModelConfig {
     std::string model_filename;
     std::string word_syms_filename;
     std::string word_align_lexicon_filename;
+    bool linear_word_alignment = true;  // Align the best path directly (LinearWordAligner), falling back to WordAlignLatticeLexicon
     bool enable_ivector = true;
     bool enable_online_cmvn = false;
     std::string online_cmvn_config_filename;  // frequently file exists but is empty (except for comment)
     std::string orig_grammar_filename;
     bool enable_carpa = false;
     std::string carpa_filename;
+    bool carpa_pruned_rescoring = true;  // Single pruned composition (like rnnlm); false uses the exact two-determinization method
     bool enable_rnnlm = false;
     std::string rnnlm_nnet_filename;
     std::string rnnlm_word_embed_filename;
+    int32 rnnlm_state_cache_size = 20000;  // Max number of RNNLM states kept across utterances (0 disables the cache)
     std::string ivector_extraction_config_json;  // extracted from ie_config_filename
 
     virtual bool Set(const std::string& name, const nlohmann::json& value) {
@@ -88,6 +85,8 @@ struct BaseNNet3OnlineModelConfig {
         if (name == "max_active") { value.get_to(max_active); return true; }
         if (name == "min_active") { value.get_to(min_active); return true; }
         if (name == "lattice_beam") { value.get_to(lattice_beam); return true; }
+        if (name == "decoder_threads") { value.get_to(decoder_threads); return true; }
+        if (name == "precompute_loglikes") { value.get_to(precompute_loglikes); return true; }
         if (name == "acoustic_scale") { value.get_to(acoustic_scale); return true; }
         if (name == "lm_weight") { value.get_to(lm_weight); return true; }
         if (name == "silence_weight") { value.get_to(silence_weight); return true; }
@@ -99,15 +98,18 @@ struct BaseNNet3OnlineModelConfig {
         if (name == "model_filename") { value.get_to(model_filename); return true; }
         if (name == "word_syms_filename") { value.get_to(word_syms_filename); return true; }
         if (name == "word_align_lexicon_filename") { value.get_to(word_align_lexicon_filename); return true; }
+        if (name == "linear_word_alignment") { value.get_to(linear_word_alignment); return true; }
         if (name == "enable_ivector") { value.get_to(enable_ivector); return true; }
         if (name == "enable_online_cmvn") { value.get_to(enable_online_cmvn); return true; }
         if (name == "online_cmvn_config_filename") { value.get_to(online_cmvn_config_filename); return true; }
         if (name == "orig_grammar_filename") { value.get_to(orig_grammar_filename); return true; }
         if (name == "enable_carpa") { value.get_to(enable_carpa); return true; }
         if (name == "carpa_filename") { value.get_to(carpa_filename); return true; }
+        if (name == "carpa_pruned_rescoring") { value.get_to(carpa_pruned_rescoring); return true; }
         if (name == "enable_rnnlm") { value.get_to(enable_rnnlm); return true; }
         if (name == "rnnlm_nnet_filename") { value.get_to(rnnlm_nnet_filename); return true; }
         if (name == "rnnlm_word_embed_filename") { value.get_to(rnnlm_word_embed_filename); return true; }
+        if (name == "rnnlm_state_cache_size") { value.get_to(rnnlm_state_cache_size); return true; }
         if (name == "ivector_extraction_config_json") { ivector_extraction_config_json = value.dump(); return true; }
         return false;
     }
@@ -119,6 +121,8 @@ struct BaseNNet3OnlineModelConfig {
         ss << "\n    " << "max_active: " << max_active;
         ss << "\n    " << "min_active: " << min_active;
         ss << "\n    " << "lattice_beam: " << lattice_beam;
+        ss << "\n    " << "decoder_threads: " << decoder_threads;
+        ss << "\n    " << "precompute_loglikes: " << precompute_loglikes;
         ss << "\n    " << "acoustic_scale: " << acoustic_scale;
         ss << "\n    " << "lm_weight: " << lm_weight;
         ss << "\n    " << "silence_weight: " << silence_weight;
@@ -130,15 +134,18 @@ struct BaseNNet3OnlineModelConfig {
         ss << "\n    " << "model_filename: " << model_filename;
         ss << "\n    " << "word_syms_filename: " << word_syms_filename;
         ss << "\n    " << "word_align_lexicon_filename: " << word_align_lexicon_filename;
+        ss << "\n    " << "linear_word_alignment: " << linear_word_alignment;
         ss << "\n    " << "enable_ivector: " << enable_ivector;
         ss << "\n    " << "enable_online_cmvn: " << enable_online_cmvn;
         ss << "\n    " << "online_cmvn_config_filename: " << online_cmvn_config_filename;
         ss << "\n    " << "orig_grammar_filename: " << orig_grammar_filename;
         ss << "\n    " << "enable_carpa: " << enable_carpa;
         ss << "\n    " << "carpa_filename: " << carpa_filename;
+        ss << "\n    " << "carpa_pruned_rescoring: " << carpa_pruned_rescoring;
         ss << "\n    " << "enable_rnnlm: " << enable_rnnlm;
         ss << "\n    " << "rnnlm_nnet_filename: " << rnnlm_nnet_filename;
         ss << "\n    " << "rnnlm_word_embed_filename: " << rnnlm_word_embed_filename;
+        ss << "\n    " << "rnnlm_state_cache_size: " << rnnlm_state_cache_size;
         ss << "\n    " << "ivector_extraction_config_json: " << ivector_extraction_config_json;
         return ss.str();
     }
@@ -206,7 +213,7 @@ class BaseNNet3OnlineModelWrapper {
         OnlineNnet2FeaturePipeline* feature_pipeline_ = nullptr;  // reinstantiated per utterance
         OnlineSilenceWeighting* silence_weighting_ = nullptr;  // reinstantiated per utterance
         WordAlignLatticeLexiconInfo* word_align_lexicon_info_ = nullptr;
-        std::set<int32> word_align_lexicon_words_;  // contains word-ids that are in word_align_lexicon_info_
+        LinearWordAligner* linear_word_aligner_ = nullptr;  // indexes the same lexicon as word_align_lexicon_info_
 
         // Ivector
         bool enable_ivector_ = false;
@@ -219,9 +226,13 @@ class BaseNNet3OnlineModelWrapper {
 
         // CARPA
         bool enable_carpa_ = false;
-        fst::MapFst<fst::StdArc, kaldi::LatticeArc, fst::StdToLatticeMapper<kaldi::BaseFloat> >* unscore_lm_fst_ = nullptr;
+        fst::VectorFst<fst::StdArc>* carpa_lm_to_subtract_fst_ = nullptr;
+        fst::MapFst<fst::StdArc, kaldi::LatticeArc, fst::StdToLatticeMapper<kaldi::BaseFloat> >* unscore_lm_fst_ = nullptr;  // only for !carpa_pruned_rescoring
+        fst::BackoffDeterministicOnDemandFst<fst::StdArc>* carpa_lm_to_subtract_det_backoff_ = nullptr;  // only for carpa_pruned_rescoring
+        fst::ScaleDeterministicOnDemandFst* carpa_lm_to_subtract_det_scale_ = nullptr;  // wraps carpa_lm_to_subtract_det_backoff_
         ConstArpaLm carpa_;
         BaseFloat carpa_scale_ = 1.0;
+        ComposeLatticePrunedOptions carpa_compose_opts_;
 
         // RNNLM
         bool enable_rnnlm_ = false;
@@ -230,6 +241,7 @@ class BaseNNet3OnlineModelWrapper {
         fst::ScaleDeterministicOnDemandFst* lm_to_subtract_det_scale_ = nullptr;
         rnnlm::RnnlmComputeStateComputationOptions rnnlm_opts_;
         rnnlm::RnnlmComputeStateInfo* rnnlm_info_ = nullptr;
+        rnnlm::RnnlmComputeStateCache* rnnlm_state_cache_ = nullptr;  // shared across utterances; nullptr if disabled
         int32 rnnlm_max_ngram_order_;
         ComposeLatticePrunedOptions rnnlm_compose_opts_;
         BaseFloat rnnlm_scale_ = 1.0;
@@ -244,6 +256,7 @@ class BaseNNet3OnlineModelWrapper {
         StdConstFst* ReadFstFile(std::string filename);
         std::string WordIdsToString(const std::vector<int32> &wordIds);
         void RescoreConstArpaLm(CompactLattice& clat);
+        void RescoreConstArpaLmDeterminized(CompactLattice& clat);
         void RescoreRnnlm(CompactLattice& clat, const std::string& prime_text = "");
 
         virtual void StartDecoding();
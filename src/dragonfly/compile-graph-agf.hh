@@ -58,6 +58,7 @@ struct AgfCompilerConfig {
     int32 grammar_prepend_nonterm = -1;
     int32 grammar_append_nonterm = -1;
     bool simplify_lg = true;  // Bool whether to simplify LG (do for command grammars, but not for dictation graph!)
+    bool minimize_pushed_weights = false;  // Bool whether to re-minimize HCLG after pushing its weights; see MinimizePushedWeights()
 
     std::string word_syms_filename;
 };
@@ -84,12 +85,37 @@ void from_json(const nlohmann::json& j, AgfCompilerConfig& c) {
         else if (el.key() == "grammar_prepend_nonterm") j.at(el.key()).get_to(c.grammar_prepend_nonterm);
         else if (el.key() == "grammar_append_nonterm") j.at(el.key()).get_to(c.grammar_append_nonterm);
         else if (el.key() == "simplify_lg") j.at(el.key()).get_to(c.simplify_lg);
+        else if (el.key() == "minimize_pushed_weights") j.at(el.key()).get_to(c.minimize_pushed_weights);
         else if (el.key() == "word_syms_filename") j.at(el.key()).get_to(c.word_syms_filename);
         else KALDI_WARN << "unrecognized json object item " << el.key() << ": " << el.value();
     }
 }
 
 
+// Approximate size in memory of a ConstFst<StdArc> (as the decoder loads graphs): a weight and four offsets/counts per
+// state, and an arc per arc.
+inline int64 ConstFstBytes(int64 num_states, int64 num_arcs) {
+    return num_states * (sizeof(StdArc::Weight) + 4 * sizeof(uint32)) + num_arcs * sizeof(StdArc);
+}
+
+// Pushes the weights of HCLG towards its start state in the log semiring, then minimizes it again. MinimizeEncoded()
+// treats each weight as part of the label, so sub-graphs that are identical except for a constant cost, e.g. the words
+// following rule alternatives of different weights, are only shared once their costs have been pushed out of them.
+// Pushing leaves the cost of every complete path through the graph unchanged, so the scores of the rules, as
+// ActiveGrammarFst stitches them together, are unchanged; the costs are just paid earlier along each path.  Must be called
+// before AddSelfLoops(), while HCLG is still deterministic.
+void MinimizePushedWeights(VectorFst<StdArc>* hclg_fst) {
+    int64 num_states_before = hclg_fst->NumStates(), num_arcs_before = NumArcs(*hclg_fst);
+    PushInLog<REWEIGHT_TO_INITIAL>(hclg_fst, kPushWeights, kDelta);
+    MinimizeEncoded(hclg_fst, kDelta);
+    int64 num_states_after = hclg_fst->NumStates(), num_arcs_after = NumArcs(*hclg_fst);
+    KALDI_LOG << "Minimizing with pushed weights reduced HCLG from " << num_states_before << " states, "
+              << num_arcs_before << " arcs (~" << ConstFstBytes(num_states_before, num_arcs_before) << " bytes) to "
+              << num_states_after << " states, " << num_arcs_after << " arcs (~"
+              << ConstFstBytes(num_states_after, num_arcs_after) << " bytes), before adding self-loops";
+}
+
+
 class AgfCompiler {
    public:
     AgfCompiler(const AgfCompilerConfig& config);
@@ -293,6 +319,9 @@ StdVectorFst* AgfCompiler::CompileGrammar(const StdFst* grammar_fst_in, const Ag
     // Encoded minimization.
     MinimizeEncoded(&hclg_fst);
 
+    if (config->minimize_pushed_weights)
+      MinimizePushedWeights(&hclg_fst);
+
     std::vector<int32> disambig;
     bool check_no_self_loops = true,
         reorder = true;
@@ -31,18 +31,24 @@
 
 #include <stdint.h>
 
-DRAGONFLY_API void* gmm__init(float beam, int32_t max_active, int32_t min_active, float lattice_beam,
-    char* word_syms_filename_cp, char* fst_in_str_cp, char* config_cp);
-DRAGONFLY_API bool gmm__decode(void* model_vp, float samp_freq, int32_t num_frames, float* frames, bool finalize);
-DRAGONFLY_API bool gmm__get_output(void* model_vp, char* output, int32_t output_length, double* likelihood_p);
+DRAGONFLY_API bool gmm_base__reset_adaptation_state(void* model_vp);
+DRAGONFLY_API bool gmm_base__get_word_align(void* model_vp, int32_t* times_cp, int32_t* lengths_cp, int32_t num_words);
+DRAGONFLY_API bool gmm_base__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize, bool save_adaptation_state);
+DRAGONFLY_API bool gmm_base__get_output(void* model_vp, char* output, int32_t output_max_length,
+        float* likelihood_p, float* am_score_p, float* lm_score_p);
 
-DRAGONFLY_API void* gmm_otf__init(float beam, int32_t max_active, int32_t min_active, float lattice_beam,
-	char* word_syms_filename_cp, char* config_cp,
-	char* hcl_fst_filename_cp, char** grammar_fst_filenames_cp, int32_t grammar_fst_filenames_len);
-DRAGONFLY_API bool gmm_otf__add_grammar_fst(void* model_vp, char* grammar_fst_filename_cp);
-DRAGONFLY_API bool gmm_otf__decode(void* model_vp, float samp_freq, int32_t num_frames, float* frames, bool finalize,
-	bool* grammars_activity, int32_t grammars_activity_size);
-DRAGONFLY_API bool gmm_otf__get_output(void* model_vp, char* output, int32_t output_length, double* likelihood_p);
+DRAGONFLY_API void* gmm_plain__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity);
+DRAGONFLY_API bool gmm_plain__destruct(void* model_vp);
+
+DRAGONFLY_API void* gmm_agf__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity);
+DRAGONFLY_API bool gmm_agf__destruct(void* model_vp);
+DRAGONFLY_API int32_t gmm_agf__add_grammar_fst(void* model_vp, void* grammar_fst_cp);
+DRAGONFLY_API int32_t gmm_agf__add_grammar_fst_file(void* model_vp, char* grammar_fst_filename_cp);
+DRAGONFLY_API bool gmm_agf__reload_grammar_fst(void* model_vp, int32_t grammar_fst_index, void* grammar_fst_cp);
+DRAGONFLY_API bool gmm_agf__reload_grammar_fst_file(void* model_vp, int32_t grammar_fst_index, char* grammar_fst_filename_cp);
+DRAGONFLY_API bool gmm_agf__remove_grammar_fst(void* model_vp, int32_t grammar_fst_index);
+DRAGONFLY_API bool gmm_agf__decode(void* model_vp, float samp_freq, int32_t num_frames, float* frames, bool finalize,
+    bool* grammars_activity_cp, int32_t grammars_activity_cp_size, bool save_adaptation_state);
 
 DRAGONFLY_API bool nnet3_base__load_lexicon(void* model_vp, char* word_syms_filename_cp, char* word_align_lexicon_filename_cp);
 DRAGONFLY_API bool nnet3_base__save_adaptation_state(void* model_vp);
@@ -56,6 +62,9 @@ DRAGONFLY_API bool nnet3_base__set_lm_prime_text(void* model_vp, char* prime_cp)
 DRAGONFLY_API void* nnet3_plain__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity);
 DRAGONFLY_API bool nnet3_plain__destruct(void* model_vp);
 DRAGONFLY_API bool nnet3_plain__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize, bool save_adaptation_state);
+DRAGONFLY_API bool nnet3_plain__get_rescored_output(void* model_vp, bool wait, char* output, int32_t output_max_length,
+        float* likelihood_p, float* am_score_p, float* lm_score_p, float* confidence_p, float* expected_error_rate_p,
+        int32_t* utterance_id_p, bool* ready_p);
 
 DRAGONFLY_API void* nnet3_agf__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity);
 DRAGONFLY_API bool nnet3_agf__destruct(void* model_vp);
@@ -70,6 +79,7 @@ DRAGONFLY_API void* nnet3_agf__construct_compiler(char* config_str_cp);
 DRAGONFLY_API bool nnet3_agf__destruct_compiler(void* compiler_vp);
 DRAGONFLY_API void* nnet3_agf__compile_graph(void* compiler_vp, char* config_str_cp, void* grammar_fst_cp, bool return_graph);
 DRAGONFLY_API void* nnet3_agf__compile_graph_text(void* compiler_vp, char* config_str_cp, char* grammar_fst_text_cp, bool return_graph);
+DRAGONFLY_API void* nnet3_agf__compile_graph_text_int(void* compiler_vp, char* config_str_cp, char* grammar_fst_text_cp, bool return_graph);
 DRAGONFLY_API void* nnet3_agf__compile_graph_file(void* compiler_vp, char* config_str_cp, char* grammar_fst_filename_cp, bool return_graph);
 
 DRAGONFLY_API void* nnet3_laf__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity);
@@ -80,6 +90,10 @@ DRAGONFLY_API bool nnet3_laf__reload_grammar_fst(void* model_vp, int32_t grammar
 DRAGONFLY_API bool nnet3_laf__remove_grammar_fst(void* model_vp, int32_t grammar_fst_index);
 DRAGONFLY_API bool nnet3_laf__decode(void* model_vp, float samp_freq, int32_t num_frames, float* frames, bool finalize,
     bool* grammars_activity_cp, int32_t grammars_activity_cp_size, bool save_adaptation_state);
+DRAGONFLY_API bool nnet3_laf__get_decode_stats(void* model_vp, int32_t* num_frames_p, float* active_tokens_per_frame_p, float* real_time_factor_p);
+// Cache limits and current (estimated) usage in bytes of the model's replace/compose/decode Fsts; the budget is per model, not per process.
+DRAGONFLY_API bool nnet3_laf__get_decode_fst_cache_info(void* model_vp, int64_t* replace_limit_p, int64_t* compose_limit_p, int64_t* decode_limit_p,
+    int64_t* replace_usage_p, int64_t* compose_usage_p, int64_t* decode_usage_p, int32_t* num_compose_fst_builds_p, int32_t* num_decode_fst_builds_p);
 
 DRAGONFLY_API bool utils__build_L_disambig(char* lexicon_fst_text_cp, char* isymbols_file_cp, char* osymbols_file_cp, char* wdisambig_phones_file_cp, char* wdisambig_words_file_cp, char* fst_out_file_cp);
 
@@ -88,12 +102,20 @@ DRAGONFLY_API void* fst__construct();
 DRAGONFLY_API bool fst__destruct(void* fst_vp);
 DRAGONFLY_API int32_t fst__add_state(void* fst_vp, float weight, bool initial);
 DRAGONFLY_API bool fst__add_arc(void* fst_vp, int32_t src_state_id, int32_t dst_state_id, int32_t ilabel, int32_t olabel, float weight);
+DRAGONFLY_API int32_t fst__add_states(void* fst_vp, int32_t num_states, float weights_cp[], bool initials_cp[]);
+DRAGONFLY_API bool fst__add_arcs(void* fst_vp, int32_t num_arcs, int32_t src_state_ids_cp[], int32_t dst_state_ids_cp[], int32_t ilabels_cp[], int32_t olabels_cp[], float weights_cp[]);
 DRAGONFLY_API bool fst__compute_md5(void* fst_vp, char* md5_cp, char* dependencies_seed_md5_cp);
+DRAGONFLY_API void* fst__construct_from_arrays(int32_t num_states, float final_weights_cp[], bool initials_cp[],
+        int32_t num_arcs, int32_t src_state_ids_cp[], int32_t dst_state_ids_cp[], int32_t ilabels_cp[], int32_t olabels_cp[], float weights_cp[],
+        bool arcsort, char* md5_cp, char* dependencies_seed_md5_cp);
 DRAGONFLY_API bool fst__has_path(void* fst_vp);
 DRAGONFLY_API bool fst__has_eps_path(void* fst_vp, int32_t path_src_state, int32_t path_dst_state);
 DRAGONFLY_API bool fst__does_match(void* fst_vp, int32_t target_labels_len, int32_t target_labels_cp[], int32_t output_labels_cp[], int32_t* output_labels_len);
+DRAGONFLY_API bool fst__does_match_nbest(void* fst_vp, int32_t target_labels_len, int32_t target_labels_cp[], int32_t max_num_matches,
+        int32_t output_labels_cp[], int32_t* output_labels_len, int32_t output_lens_cp[], int32_t* num_matches);
 DRAGONFLY_API void* fst__load_file(char* filename_cp);
 DRAGONFLY_API bool fst__write_file(void* fst_vp, char* filename_cp);
 DRAGONFLY_API bool fst__write_file_const(void* fst_vp, char* filename_cp);
 DRAGONFLY_API bool fst__print(void* fst_vp, char* filename_cp);
 DRAGONFLY_API void* fst__compile_text(char* fst_text_cp, char* isymbols_file_cp, char* osymbols_file_cp);
+DRAGONFLY_API void* fst__compile_text_int(char* fst_text_cp);
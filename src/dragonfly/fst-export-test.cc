@@ -0,0 +1,171 @@
+// fst-export-test
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "base/kaldi-math.h"
+#include "fstext/fstext-lib.h"
+
+extern "C" {
+#include "dragonfly.h"
+}
+
+namespace dragonfly {
+
+using namespace kaldi;
+
+const int32 kWildcardLabel = 1000, kWildcardLabel2 = 1001, kSilentLabel = 1002;
+const float kNonFinal = std::numeric_limits<float>::infinity();
+
+void InitLabels() {
+    int32 eps_like_ilabels[] = { kSilentLabel };
+    int32 silent_olabels[] = { kSilentLabel };
+    int32 wildcard_olabels[] = { kWildcardLabel, kWildcardLabel2 };
+    fst__init(1, eps_like_ilabels, 1, silent_olabels, 2, wildcard_olabels);
+}
+
+// Grammar: "1 <dictation> 2 <dictation> #end", matched against a long input with
+// hundreds of dictated words per wildcard.
+void TestDoesMatchLongDictation() {
+    void* fst = fst__construct();
+    int32 s1 = fst__add_state(fst, kNonFinal, false),
+        s2 = fst__add_state(fst, kNonFinal, false),
+        s3 = fst__add_state(fst, kNonFinal, false),
+        s4 = fst__add_state(fst, kNonFinal, false),
+        s5 = fst__add_state(fst, 0.0, false);
+    fst__add_arc(fst, 0, s1, 1, 1, 0.0);
+    fst__add_arc(fst, s1, s2, kWildcardLabel, kWildcardLabel, 0.0);
+    fst__add_arc(fst, s2, s3, 2, 2, 0.0);
+    fst__add_arc(fst, s3, s4, kWildcardLabel, kWildcardLabel, 0.0);
+    fst__add_arc(fst, s4, s5, kSilentLabel, kSilentLabel, 0.0);
+
+    std::vector<int32> target = { 1 }, expected = { 1, kWildcardLabel };
+    for (int32 i = 0; i < 300; i++) {
+        int32 word = 3 + RandInt(0, 100);
+        target.push_back(word);
+        expected.push_back(word);
+    }
+    target.push_back(2);
+    expected.push_back(2);  // A wildcard label already output is not output again.
+    for (int32 i = 0; i < 300; i++) {
+        int32 word = 3 + RandInt(0, 100);
+        target.push_back(word);
+        expected.push_back(word);
+    }
+    expected.push_back(kSilentLabel);
+
+    std::vector<int32> output(expected.size() + 10);
+    int32 output_len = output.size();
+    KALDI_ASSERT(fst__does_match(fst, target.size(), target.data(), output.data(), &output_len));
+    output.resize(output_len);
+    KALDI_ASSERT(output == expected);
+
+    // Dropping the literal "2" leaves no way through the grammar.
+    target.erase(std::find(target.begin(), target.end(), 2));
+    output_len = output.size();
+    KALDI_ASSERT(!fst__does_match(fst, target.size(), target.data(), output.data(), &output_len));
+
+    fst__destruct(fst);
+}
+
+// Parallel wildcards in a loop make the number of ways to segment the input grow
+// exponentially with its length; the matcher must stay polynomial.
+void TestDoesMatchAmbiguousWildcards() {
+    void* fst = fst__construct();
+    int32 s1 = fst__add_state(fst, 0.0, false);
+    fst__add_arc(fst, 0, s1, kWildcardLabel, kWildcardLabel, 0.0);
+    fst__add_arc(fst, 0, s1, kWildcardLabel2, kWildcardLabel2, 0.0);
+    fst__add_arc(fst, s1, 0, kSilentLabel, kSilentLabel, 0.0);
+
+    std::vector<int32> target;
+    for (int32 i = 0; i < 200; i++)
+        target.push_back(1 + RandInt(0, 100));
+
+    int32 max_num_matches = 5, num_matches = 0;
+    std::vector<int32> output(target.size() * 4 * max_num_matches), output_lens(max_num_matches);
+    int32 output_len = output.size();
+    KALDI_ASSERT(fst__does_match_nbest(fst, target.size(), target.data(), max_num_matches,
+        output.data(), &output_len, output_lens.data(), &num_matches));
+    KALDI_ASSERT(num_matches == max_num_matches);
+
+    std::set<std::vector<int32> > distinct_matches;
+    int32 offset = 0;
+    for (int32 m = 0; m < num_matches; m++) {
+        std::vector<int32> match(output.begin() + offset, output.begin() + offset + output_lens[m]);
+        offset += output_lens[m];
+        // Every target word must appear, in order, among the output labels.
+        std::vector<int32> words;
+        for (auto label : match)
+            if (label != kWildcardLabel && label != kWildcardLabel2 && label != kSilentLabel)
+                words.push_back(label);
+        KALDI_ASSERT(words == target);
+        distinct_matches.insert(match);
+    }
+    KALDI_ASSERT(offset == output_len);
+    KALDI_ASSERT(distinct_matches.size() == num_matches);
+
+    fst__destruct(fst);
+}
+
+// What a wildcard arc outputs must not leak into the paths through its sibling arcs.
+void TestDoesMatchWildcardSibling() {
+    void* fst = fst__construct();
+    int32 s1 = fst__add_state(fst, 0.0, false),
+        s2 = fst__add_state(fst, 0.0, false);
+    fst__add_arc(fst, 0, s1, kWildcardLabel, kWildcardLabel, 0.0);
+    fst__add_arc(fst, 0, s2, 1, 1, 0.0);
+
+    // "1" could also be dictated and end in s1, but the literal path is found first.
+    std::vector<int32> target = { 1 }, output(10);
+    int32 output_len = output.size();
+    KALDI_ASSERT(fst__does_match(fst, target.size(), target.data(), output.data(), &output_len));
+    output.resize(output_len);
+    KALDI_ASSERT(output == std::vector<int32>({ 1 }));
+
+    fst__destruct(fst);
+}
+
+// Paths with the same output must not use up the n-best list.
+void TestDoesMatchNbestDistinct() {
+    void* fst = fst__construct();
+    int32 s1 = fst__add_state(fst, 0.0, false);
+    fst__add_arc(fst, 0, s1, kSilentLabel, kSilentLabel, 0.0);
+    fst__add_arc(fst, 0, s1, kSilentLabel, kSilentLabel, 0.0);
+    fst__add_arc(fst, 0, s1, kSilentLabel, 5, 0.0);
+
+    int32 max_num_matches = 2, num_matches = 0;
+    std::vector<int32> output(10), output_lens(max_num_matches);
+    int32 output_len = output.size();
+    KALDI_ASSERT(fst__does_match_nbest(fst, 0, NULL, max_num_matches,
+        output.data(), &output_len, output_lens.data(), &num_matches));
+    KALDI_ASSERT(num_matches == 2 && output_len == 2);
+    KALDI_ASSERT(output[0] == kSilentLabel && output[1] == 5);
+
+    fst__destruct(fst);
+}
+
+}  // namespace dragonfly
+
+int main() {
+    using namespace dragonfly;
+    InitLabels();
+    for (int32 i = 0; i < 3; i++) {
+        TestDoesMatchLongDictation();
+        TestDoesMatchAmbiguousWildcards();
+    }
+    TestDoesMatchWildcardSibling();
+    TestDoesMatchNbestDistinct();
+    std::cout << "Test OK.\n";
+}
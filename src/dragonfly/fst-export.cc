@@ -15,11 +15,14 @@
 // You should have received a copy of the GNU Affero General Public License
 // along with this program. If not, see <https://www.gnu.org/licenses/>.
 
+#include <memory>
+
 #include "fstext/fstext-lib.h"
 #include "fst/script/compile.h"
 #include "util/common-utils.h"
 
 #include "utils.h"
+#include "kaldi-utils.h"
 #include "md5.h"
 
 extern "C" {
@@ -77,6 +80,44 @@ bool fst__add_arc(void* fst_vp, int32_t src_state_id, int32_t dst_state_id, int3
     return true;
 }
 
+// Bulk version of fst__add_state: adds num_states contiguous states, returning the id of the first.
+int32_t fst__add_states(void* fst_vp, int32_t num_states, float weights_cp[], bool initials_cp[]) {
+    auto fst = static_cast<StdVectorFst*>(fst_vp);
+    auto first_state_id = fst->NumStates();
+    fst->ReserveStates(first_state_id + num_states);
+    auto num_initial = std::count(initials_cp, initials_cp + num_states, true);
+    if (num_initial)
+        fst->ReserveArcs(0, fst->NumArcs(0) + num_initial);
+    for (int32_t i = 0; i < num_states; ++i) {
+        auto state_id = fst->AddState();
+        fst->SetFinal(state_id, weights_cp[i]);
+        if (initials_cp[i])
+            fst->AddArc(0, StdArc(0, 0, Weight::One(), state_id));
+    }
+    return first_state_id;
+}
+
+// Bulk version of fst__add_arc: arc i is (src_state_ids_cp[i], dst_state_ids_cp[i], ilabels_cp[i], olabels_cp[i], weights_cp[i]).
+bool fst__add_arcs(void* fst_vp, int32_t num_arcs, int32_t src_state_ids_cp[], int32_t dst_state_ids_cp[], int32_t ilabels_cp[], int32_t olabels_cp[], float weights_cp[]) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto fst = static_cast<StdVectorFst*>(fst_vp);
+    auto num_states = fst->NumStates();
+    // Count the new arcs per source state first, so each state's arc vector is grown only once.
+    std::vector<size_t> num_new_arcs(num_states, 0);
+    for (int32_t i = 0; i < num_arcs; ++i) {
+        if (src_state_ids_cp[i] < 0 || src_state_ids_cp[i] >= num_states || dst_state_ids_cp[i] < 0 || dst_state_ids_cp[i] >= num_states)
+            KALDI_ERR << "fst__add_arcs: bad state id in arc #" << i;
+        ++num_new_arcs[src_state_ids_cp[i]];
+    }
+    for (StateId state = 0; state < num_states; ++state)
+        if (num_new_arcs[state])
+            fst->ReserveArcs(state, fst->NumArcs(state) + num_new_arcs[state]);
+    for (int32_t i = 0; i < num_arcs; ++i)
+        fst->AddArc(src_state_ids_cp[i], StdArc(ilabels_cp[i], olabels_cp[i], weights_cp[i], dst_state_ids_cp[i]));
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
 bool fst__compute_md5(void* fst_vp, char* md5_cp, char* dependencies_seed_md5_cp) {
     auto fst = static_cast<StdVectorFst*>(fst_vp);
     MD5 md5;
@@ -100,6 +141,24 @@ bool fst__compute_md5(void* fst_vp, char* md5_cp, char* dependencies_seed_md5_cp
     return true;
 }
 
+// Builds a whole FST in one call: equivalent to fst__construct, then fst__add_states and fst__add_arcs with the given arrays,
+// optionally followed by an ilabel arc-sort and fst__compute_md5 (if md5_cp is non-null). Returns null on failure.
+void* fst__construct_from_arrays(int32_t num_states, float final_weights_cp[], bool initials_cp[],
+        int32_t num_arcs, int32_t src_state_ids_cp[], int32_t dst_state_ids_cp[], int32_t ilabels_cp[], int32_t olabels_cp[], float weights_cp[],
+        bool arcsort, char* md5_cp, char* dependencies_seed_md5_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    std::unique_ptr<StdVectorFst> fst(static_cast<StdVectorFst*>(fst__construct()));  // freed if anything fails
+    fst__add_states(fst.get(), num_states, final_weights_cp, initials_cp);
+    if (!fst__add_arcs(fst.get(), num_arcs, src_state_ids_cp, dst_state_ids_cp, ilabels_cp, olabels_cp, weights_cp))
+        return nullptr;
+    if (arcsort)
+        ArcSort(fst.get(), ILabelCompare<StdArc>());
+    if (md5_cp)
+        fst__compute_md5(fst.get(), md5_cp, dependencies_seed_md5_cp);
+    return fst.release();
+    END_INTERFACE_CATCH_HANDLER(nullptr)
+}
+
 bool fst__has_path(void* fst_vp) {
     auto fst = static_cast<StdVectorFst*>(fst_vp);
     auto path_src_state = fst->Start();
@@ -141,53 +200,162 @@ bool fst__has_eps_path(void* fst_vp, int32_t path_src_state, int32_t path_dst_st
     return false;
 }
 
-bool fst__does_match(void* fst_vp, int32_t target_labels_len, int32_t target_labels_cp[], int32_t output_labels_cp[], int32_t* output_labels_len) {
-    auto fst = static_cast<StdVectorFst*>(fst_vp);
-    using Path = std::vector<Label>;
-    using Entry = std::tuple<StateId, Path, size_t>;
-    std::deque<Entry> queue = { std::make_tuple(fst->Start(), Path(), 0) };
+// Finds up to max_num_matches distinct output label sequences for target_labels through the FST, fewest steps first.
+// Arcs whose ilabel matches the next target consume it; silent arcs consume nothing; a wildcard arc either consumes the
+// next target while staying in its source state, or leaves it without consuming. A wildcard arc outputs its
+// olabel only if that label is not already in the output so far, and each consumed target is output as itself.
+// Search nodes are (state, target position, wildcard labels already output). Output prefixes are interned in a trie, and
+// each node is expanded for at most max_num_matches distinct prefixes: any further prefix could only complete to matches
+// ranked after those of the earlier ones. So the cost is polynomial in the FST size and input length.
+static std::vector<std::vector<Label>> FindMatches(const StdVectorFst& fst, int32_t target_labels_len, const int32_t target_labels[], int32_t max_num_matches) {
+    // Bit i of Node::wildcards_output is set once the i-th olabel of the wildcard arcs is in the output.
+    std::unordered_map<Label, int32_t> wildcard_bits;
+    for (StateIterator<StdVectorFst> siter(fst); !siter.Done(); siter.Next())
+        for (ArcIterator<StdVectorFst> aiter(fst, siter.Value()); !aiter.Done(); aiter.Next())
+            if (wildcard_olabels.count(aiter.Value().ilabel) && !wildcard_bits.count(aiter.Value().olabel)) {
+                int32_t bit = wildcard_bits.size();
+                wildcard_bits[aiter.Value().olabel] = bit;
+            }
+    if (wildcard_bits.size() > 64) KALDI_ERR << "FindMatches: more than 64 distinct wildcard olabels";
 
-    while (!queue.empty()) {
+    struct Node {
         StateId state;
-        Path path;
-        size_t target_label_index;
-        std::tie(state, path, target_label_index) = queue.front();
+        int32_t target_index;
+        uint64_t wildcards_output;
+        bool operator==(const Node& other) const {
+            return state == other.state && target_index == other.target_index && wildcards_output == other.wildcards_output;
+        }
+    };
+    struct NodeHash {
+        size_t operator()(const Node& node) const {
+            return (static_cast<size_t>(node.state) * 7853 + node.target_index) * 7919 + node.wildcards_output;
+        }
+    };
+    // prefixes[i] is output prefix #i: prefix #parent followed by label. Prefix #0 is empty.
+    struct Prefix {
+        int32_t parent;
+        Label label;
+    };
+    std::vector<Prefix> prefixes = { {-1, 0} };
+    std::unordered_map<std::pair<int32_t, Label>, int32_t, kaldi::PairHasher<int32_t, Label>> prefix_children;
+    struct Entry {
+        Node node;
+        int32_t prefix;
+    };
+    std::deque<Entry> queue;
+    std::unordered_map<Node, std::vector<int32_t>, NodeHash> node_prefixes;  // distinct prefixes each node was reached with
+    std::unordered_set<int32_t> match_prefixes;
+    std::vector<std::vector<Label>> matches;
+
+    // Appends label to the output of entry.
+    auto output = [&](Entry* entry, Label label) {
+        auto result = prefix_children.emplace(std::make_pair(entry->prefix, label), prefixes.size());
+        if (result.second)
+            prefixes.push_back({entry->prefix, label});
+        entry->prefix = result.first->second;
+        auto bit = wildcard_bits.find(label);
+        if (bit != wildcard_bits.end())
+            entry->node.wildcards_output |= (static_cast<uint64_t>(1) << bit->second);
+    };
+    // Returns whether wildcard olabel label is in the output of entry.
+    auto in_output = [&](const Entry& entry, Label label) {
+        return (entry.node.wildcards_output & (static_cast<uint64_t>(1) << wildcard_bits.at(label))) != 0;
+    };
+    // Entries are queued in breadth-first order, so the first prefixes a node is reached with are its shortest.
+    auto push = [&](const Entry& entry) {
+        auto& reached = node_prefixes[entry.node];
+        if (reached.size() >= max_num_matches || std::find(reached.begin(), reached.end(), entry.prefix) != reached.end())
+            return;
+        reached.push_back(entry.prefix);
+        queue.push_back(entry);
+    };
+
+    push({{fst.Start(), 0, 0}, 0});
+    while (!queue.empty() && matches.size() < max_num_matches) {
+        const Entry entry = queue.front();
         queue.pop_front();
-
-        auto target_label = (target_label_index < target_labels_len) ? target_labels_cp[target_label_index] : -1;
-        if ((target_label == -1) && (fst->Final(state) != Weight::Zero())) {
-            for (auto i = 0; i < std::min((int32_t)path.size(), *output_labels_len); ++i) {
-                output_labels_cp[i] = path[i];
-            }
-            if (path.size() > *output_labels_len)
-                KALDI_WARN << "fst__does_match: output_labels_len < " << path.size();
-            *output_labels_len = path.size();
-            return true;
+        const Node& node = entry.node;
+
+        auto target_label = (node.target_index < target_labels_len) ? target_labels[node.target_index] : -1;
+        if ((target_label == -1) && (fst.Final(node.state) != Weight::Zero()) && match_prefixes.insert(entry.prefix).second) {
+            std::vector<Label> path;
+            for (auto i = entry.prefix; i > 0; i = prefixes[i].parent)
+                path.push_back(prefixes[i].label);
+            std::reverse(path.begin(), path.end());
+            matches.emplace_back(std::move(path));
         }
 
-        for (ArcIterator<StdFst> aiter(*fst, state); !aiter.Done(); aiter.Next()) {
-            auto arc = aiter.Value();
+        for (ArcIterator<StdFst> aiter(fst, node.state); !aiter.Done(); aiter.Next()) {
+            const auto& arc = aiter.Value();
+            // Each arc extends its own copy of entry, so nothing output for one arc leaks into the paths of its siblings.
+            Entry next = entry;
             if ((target_label != -1) && (arc.ilabel == target_label)) {
-                Path next_path(path);
-                next_path.emplace_back(arc.olabel);
-                queue.emplace_back(std::forward_as_tuple(arc.nextstate, next_path, target_label_index+1));
+                next.node = {arc.nextstate, node.target_index + 1, node.wildcards_output};
+                output(&next, arc.olabel);
+                push(next);
             } else if (wildcard_olabels.count(arc.ilabel)) {
-                if (std::find(path.begin(), path.end(), arc.olabel) == path.end())
-                    path.emplace_back(arc.olabel);
+                if (!in_output(entry, arc.olabel))
+                    output(&next, arc.olabel);
                 if (target_label != -1) {
-                    Path next_path(path);
-                    next_path.emplace_back(target_label);
-                    queue.emplace_back(std::forward_as_tuple(state, next_path, target_label_index+1));
+                    Entry consume = next;
+                    consume.node.target_index++;
+                    output(&consume, target_label);
+                    push(consume);
                 }
-                queue.emplace_back(std::forward_as_tuple(arc.nextstate, path, target_label_index));
+                next.node.state = arc.nextstate;
+                push(next);
             } else if (silent_olabels.count(arc.ilabel)) {
-                Path next_path(path);
-                next_path.emplace_back(arc.olabel);
-                queue.emplace_back(std::forward_as_tuple(arc.nextstate, next_path, target_label_index));
+                next.node.state = arc.nextstate;
+                output(&next, arc.olabel);
+                push(next);
             }
         }
     }
-    return false;
+    return matches;
+}
+
+bool fst__does_match(void* fst_vp, int32_t target_labels_len, int32_t target_labels_cp[], int32_t output_labels_cp[], int32_t* output_labels_len) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto fst = static_cast<StdVectorFst*>(fst_vp);
+    auto matches = FindMatches(*fst, target_labels_len, target_labels_cp, 1);
+    if (matches.empty())
+        return false;
+
+    const auto& path = matches.front();
+    for (auto i = 0; i < std::min((int32_t)path.size(), *output_labels_len); ++i) {
+        output_labels_cp[i] = path[i];
+    }
+    if (path.size() > *output_labels_len)
+        KALDI_WARN << "fst__does_match: output_labels_len < " << path.size();
+    *output_labels_len = path.size();
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+// Like fst__does_match, but outputs up to max_num_matches distinct matches: their output labels are concatenated into
+// output_labels_cp (of capacity *output_labels_len, which is set to the total length), and their individual lengths are
+// written to output_lens_cp (of capacity max_num_matches).
+bool fst__does_match_nbest(void* fst_vp, int32_t target_labels_len, int32_t target_labels_cp[], int32_t max_num_matches,
+        int32_t output_labels_cp[], int32_t* output_labels_len, int32_t output_lens_cp[], int32_t* num_matches) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto fst = static_cast<StdVectorFst*>(fst_vp);
+    auto matches = FindMatches(*fst, target_labels_len, target_labels_cp, max_num_matches);
+
+    int32_t total_len = 0;
+    for (size_t m = 0; m < matches.size(); ++m) {
+        for (auto label : matches[m]) {
+            if (total_len < *output_labels_len)
+                output_labels_cp[total_len] = label;
+            ++total_len;
+        }
+        output_lens_cp[m] = matches[m].size();
+    }
+    if (total_len > *output_labels_len)
+        KALDI_WARN << "fst__does_match_nbest: output_labels_len < " << total_len;
+    *output_labels_len = total_len;
+    *num_matches = matches.size();
+    return !matches.empty();
+    END_INTERFACE_CATCH_HANDLER(false)
 }
 
 void* fst__load_file(char* filename_cp) {
@@ -230,6 +398,16 @@ void* fst__compile_text(char* fst_text_cp, char* isymbols_file_cp, char* osymbol
     return fst;
 }
 
+// Fast path for integer-labeled text FSTs: no symbol tables and no intermediate string copies.
+void* fst__compile_text_int(char* fst_text_cp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    ExecutionTimer timer("fst__compile_text_int:compiling");
+    std::unique_ptr<StdVectorFst> fst(new StdVectorFst());  // freed if parsing fails
+    dragonfly::ParseIntegerFstText(fst_text_cp, fst.get());
+    return fst.release();
+    END_INTERFACE_CATCH_HANDLER(nullptr)
+}
+
 bool utils__build_L_disambig(char* lexicon_fst_text_cp, char* isymbols_file_cp, char* osymbols_file_cp, char* wdisambig_phones_file_cp, char* wdisambig_words_file_cp, char* fst_out_file_cp) {
     auto fst = static_cast<StdVectorFst*>(fst__compile_text(lexicon_fst_text_cp, isymbols_file_cp, osymbols_file_cp));
 
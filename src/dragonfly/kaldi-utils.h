@@ -17,10 +17,17 @@
 
 #pragma once
 
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
 #include "fstext/fstext-lib.h"
+#include "hmm/hmm-utils.h"
+#include "lat/kaldi-lattice.h"
 #include "online2/online-ivector-feature.h"
+#include "util/const-integer-set.h"
 
 #include "nlohmann_json.hpp"
 
@@ -70,6 +77,83 @@ inline void WriteLattice(const CompactLattice clat_in, std::string name = "latti
 }
 
 
+// Builds an FST from OpenFst AT&T text format with integer labels, parsing straight out of the C string (no istream
+// copy and no symbol table lookups). Arc lines are "src dst ilabel olabel [weight]" and final lines are "state [weight]";
+// the source state of the first line is the start state. All states and arcs are reserved before insertion.
+inline void ParseIntegerFstText(const char* text, StdVectorFst* fst) {
+    using StateId = StdArc::StateId;
+    struct TextArc { StateId src; StdArc arc; };
+    struct TextFinal { StateId state; StdArc::Weight weight; };
+
+    // Each line holds at most one arc, so the line count bounds the arcs we need room for.
+    size_t max_num_lines = 1;
+    for (const char* p = text; (p = strchr(p, '\n')) != nullptr; ++p) ++max_num_lines;
+    std::vector<TextArc> arcs;
+    std::vector<TextFinal> finals;
+    arcs.reserve(max_num_lines);
+
+    StateId start_state = kNoStateId, max_state = kNoStateId;
+    size_t line_num = 0;
+    const char* p = text;
+    while (*p != '\0') {
+        ++line_num;
+        const char* fields[5];
+        int32 num_fields = 0;
+        while (*p != '\0' && *p != '\n') {
+            while (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+            if (*p == '\0' || *p == '\n') break;
+            if (num_fields == 5) KALDI_ERR << "ParseIntegerFstText: too many fields on line " << line_num;
+            fields[num_fields++] = p;
+            while (*p != '\0' && *p != '\n' && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+        }
+        if (*p == '\n') ++p;
+        if (num_fields == 0) continue;
+
+        auto parse_int = [&](const char* field) -> int32 {
+            char* end;
+            long value = strtol(field, &end, 10);
+            if (end == field || (*end != ' ' && *end != '\t' && *end != '\r' && *end != '\n' && *end != '\0')
+                    || value < 0 || value > std::numeric_limits<int32>::max())
+                KALDI_ERR << "ParseIntegerFstText: bad integer on line " << line_num;
+            return static_cast<int32>(value);
+        };
+        auto parse_weight = [&](const char* field) -> float {
+            char* end;
+            float value = strtof(field, &end);
+            if (end == field) KALDI_ERR << "ParseIntegerFstText: bad weight on line " << line_num;
+            return value;
+        };
+
+        StateId state = parse_int(fields[0]);
+        if (start_state == kNoStateId) start_state = state;
+        max_state = std::max(max_state, state);
+        if (num_fields <= 2) {
+            finals.push_back({state, (num_fields == 2) ? parse_weight(fields[1]) : StdArc::Weight::One().Value()});
+        } else if (num_fields >= 4) {
+            StateId nextstate = parse_int(fields[1]);
+            max_state = std::max(max_state, nextstate);
+            float weight = (num_fields == 5) ? parse_weight(fields[4]) : StdArc::Weight::One().Value();
+            arcs.push_back({state, StdArc(parse_int(fields[2]), parse_int(fields[3]), weight, nextstate)});
+        } else {
+            KALDI_ERR << "ParseIntegerFstText: wrong number of fields on line " << line_num;
+        }
+    }
+
+    fst->DeleteStates();
+    if (start_state == kNoStateId) return;
+    std::vector<size_t> num_arcs(max_state + 1, 0);
+    for (const auto& text_arc : arcs) ++num_arcs[text_arc.src];
+    fst->ReserveStates(max_state + 1);
+    for (StateId s = 0; s <= max_state; ++s) {
+        fst->AddState();
+        if (num_arcs[s]) fst->ReserveArcs(s, num_arcs[s]);
+    }
+    fst->SetStart(start_state);
+    for (const auto& text_arc : arcs) fst->AddArc(text_arc.src, text_arc.arc);
+    for (const auto& text_final : finals) fst->SetFinal(text_final.state, text_final.weight);
+}
+
+
 // RAII object that sets Kaldi verbosity level upon construction, and resets it upon destruction.
 class VerboseLevelResetter {
    public:
@@ -89,6 +173,132 @@ class VerboseLevelResetter {
 };
 
 
+// Word-aligns a linear (single path) CompactLattice, such as a best path, directly from its transition-id and word
+// sequences, using a hashed index of the word-alignment lexicon, rather than through the general lattice machinery of
+// WordAlignLatticeLexicon(). The path's phones are segmented into lexicon entries, in order, by a small dynamic program
+// over (phone position, word position). Words with no lexicon entry whose symbol starts with "#nonterm" (rule and
+// dictation nonterminals) align to zero phones.
+class LinearWordAligner {
+   public:
+    // lexicon as read by ReadLexiconForWordAlign(): each entry is (word-id, output-word-id, phone1, phone2, ...)
+    LinearWordAligner(const std::vector<std::vector<int32>>& lexicon, const fst::SymbolTable* word_syms = nullptr) {
+        for (const auto& entry : lexicon) {
+            KALDI_ASSERT(entry.size() >= 2);
+            Pron pron{ entry[1], std::vector<int32>(entry.begin() + 2, entry.end()) };
+            if (entry[0] != 0)
+                word_prons_[entry[0]].push_back(std::move(pron));
+            else if (!pron.phones.empty())  // (an empty epsilon entry would match anywhere)
+                eps_prons_.push_back(std::move(pron));
+        }
+        if (word_syms) {
+            for (SymbolTableIterator siter(*word_syms); !siter.Done(); siter.Next()) {
+                int32 word = siter.Value();
+                if (siter.Symbol().compare(0, 8, "#nonterm") == 0 && word_prons_.count(word) == 0)
+                    word_prons_[word].push_back(Pron{ word, {} });
+            }
+        }
+    }
+
+    // Outputs parallel vectors, like CompactLatticeToWordAlignment(), including epsilon entries (e.g. silence) as word
+    // 0. Returns false if clat is not linear, or its path cannot be segmented into lexicon entries.
+    bool Align(const CompactLattice& clat, const TransitionModel& trans_model,
+            std::vector<int32>* words, std::vector<int32>* times, std::vector<int32>* lengths) const {
+        words->clear();
+        times->clear();
+        lengths->clear();
+
+        // Read off the path's word and transition-id sequences
+        std::vector<int32> path_words, alignment;
+        CompactLattice::StateId state = clat.Start();
+        if (state == fst::kNoStateId) return false;
+        while (true) {
+            size_t num_arcs = clat.NumArcs(state);
+            if (clat.Final(state) != CompactLatticeWeight::Zero()) {
+                if (num_arcs != 0) return false;
+                const std::vector<int32>& final_string = clat.Final(state).String();
+                alignment.insert(alignment.end(), final_string.begin(), final_string.end());
+                break;
+            }
+            if (num_arcs != 1) return false;
+            ArcIterator<CompactLattice> aiter(clat, state);
+            const CompactLatticeArc& arc = aiter.Value();
+            if (arc.olabel != 0) path_words.push_back(arc.olabel);
+            const std::vector<int32>& arc_string = arc.weight.String();
+            alignment.insert(alignment.end(), arc_string.begin(), arc_string.end());
+            if (arc.nextstate <= state) return false;  // guards against cycles; lattices are topologically sorted
+            state = arc.nextstate;
+        }
+
+        std::vector<std::vector<int32>> split;
+        if (!SplitToPhones(trans_model, alignment, &split)) return false;
+        int32 num_phones = split.size(), num_words = path_words.size();
+        std::vector<int32> phones(num_phones), phone_start_frames(num_phones + 1, 0);
+        for (int32 p = 0; p < num_phones; p++) {
+            phones[p] = trans_model.TransitionIdToPhone(split[p][0]);
+            phone_start_frames[p + 1] = phone_start_frames[p] + split[p].size();
+        }
+
+        // Each (phone position, word position) node records the node it was first reached from, and the output word.
+        // Nodes are visited in order of phone position then word position, which all transitions increase.
+        struct BackPointer { int32 prev = -1; int32 word = 0; };
+        int32 stride = num_words + 1;
+        std::vector<BackPointer> back_pointers((num_phones + 1) * stride);
+        std::vector<bool> reached((num_phones + 1) * stride, false);
+        reached[0] = true;
+        auto matches = [&phones, num_phones](int32 p, const std::vector<int32>& pron_phones) {
+            return (p + static_cast<int32>(pron_phones.size()) <= num_phones
+                && std::equal(pron_phones.begin(), pron_phones.end(), phones.begin() + p));
+        };
+        auto next_node = [stride](int32 p, const Pron& pron, int32 j) {
+            return (p + static_cast<int32>(pron.phones.size())) * stride + j;
+        };
+        auto visit = [&](int32 node, int32 next, int32 word) {
+            if (reached[next]) return;
+            reached[next] = true;
+            back_pointers[next].prev = node;
+            back_pointers[next].word = word;
+        };
+        for (int32 p = 0; p <= num_phones; p++) {
+            for (int32 j = 0; j <= num_words; j++) {
+                int32 node = p * stride + j;
+                if (!reached[node]) continue;
+                for (const auto& pron : eps_prons_)
+                    if (matches(p, pron.phones))
+                        visit(node, next_node(p, pron, j), pron.word);
+                if (j == num_words) continue;
+                auto iter = word_prons_.find(path_words[j]);
+                if (iter == word_prons_.end()) return false;  // word not in lexicon
+                for (const auto& pron : iter->second)
+                    if (matches(p, pron.phones))
+                        visit(node, next_node(p, pron, j + 1), pron.word);
+            }
+        }
+
+        int32 node = num_phones * stride + num_words;
+        if (!reached[node]) return false;
+        while (node != 0) {
+            int32 prev = back_pointers[node].prev;
+            int32 start_frame = phone_start_frames[prev / stride], end_frame = phone_start_frames[node / stride];
+            words->push_back(back_pointers[node].word);
+            times->push_back(start_frame);
+            lengths->push_back(end_frame - start_frame);
+            node = prev;
+        }
+        std::reverse(words->begin(), words->end());
+        std::reverse(times->begin(), times->end());
+        std::reverse(lengths->begin(), lengths->end());
+        return true;
+    }
+
+   private:
+    struct Pron {
+        int32 word;  // output word-id; 0 for epsilon
+        std::vector<int32> phones;
+    };
+    std::unordered_map<int32, std::vector<Pron>> word_prons_;  // keyed by word-id in the lattice
+    std::vector<Pron> eps_prons_;  // entries for lattice word-id 0, e.g. optional silence
+};
+
 // ArcMapper that takes acceptor and relabels all nonterm:rules to nonterm:rule0, so redundant/ambiguous rules don't count as differing for measuring
 // confidence.
 template <class A>
@@ -124,6 +334,49 @@ class CombineRuleNontermMapper {
     Label last_rule_sym_;
 };
 
+// ArcMapper for LAF decoding that removes disambiguation ilabels (like RemoveSomeInputSymbolsMapper), and also disables
+// arcs entering inactive rules by giving them infinite cost (the decoder never expands them). Since only this outermost
+// layer depends on the rules' activity, the delayed composition beneath it (and its cache) can be reused across activity
+// changes.
+template <class A>
+class RemoveDisambigAndInactiveRulesMapper {
+   public:
+    using FromArc = A;
+    using ToArc = A;
+    using Label = typename FromArc::Label;
+
+    RemoveDisambigAndInactiveRulesMapper(const std::vector<int32>& disambig_ilabels, Label first_rule_label, const std::vector<bool>& rules_activity)
+        : disambig_ilabels_(disambig_ilabels), first_rule_label_(first_rule_label), rules_activity_(rules_activity) {}
+
+    ToArc operator()(const FromArc& arc) const {
+        ToArc ans = arc;
+        if (disambig_ilabels_.count(ans.ilabel) != 0)
+            ans.ilabel = 0;
+        int64 rule = static_cast<int64>(arc.olabel) - first_rule_label_;
+        if (rule >= 0 && rule < static_cast<int64>(rules_activity_.size()) && !rules_activity_[rule])
+            ans.weight = ToArc::Weight::Zero();
+        return ans;
+    }
+
+    constexpr MapFinalAction FinalAction() const { return MAP_NO_SUPERFINAL; }
+
+    constexpr MapSymbolsAction InputSymbolsAction() const { return MAP_CLEAR_SYMBOLS; }
+
+    constexpr MapSymbolsAction OutputSymbolsAction() const { return MAP_COPY_SYMBOLS; }
+
+    uint64 Properties(uint64 props) const {
+        // Remove the following, as we don't know now if any of them are true.
+        uint64 to_remove = kAcceptor | kNotAcceptor | kIDeterministic | kNonIDeterministic |
+            kNoEpsilons | kNoIEpsilons | kILabelSorted | kNotILabelSorted | kWeighted | kUnweighted;
+        return props & ~to_remove;
+    }
+
+   private:
+    kaldi::ConstIntegerSet<int32> disambig_ilabels_;
+    Label first_rule_label_;
+    std::vector<bool> rules_activity_;
+};
+
 template <class Arc>
 class CopyDictationVisitor {
    public:
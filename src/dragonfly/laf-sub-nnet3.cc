@@ -29,6 +29,7 @@
 #include "lat/word-align-lattice-lexicon.h"
 #include "nnet3/nnet-utils.h"
 #include "decoder/active-grammar-fst.h"
+#include "decoder/lookahead-decode-fst.h"
 #include "fst/script/compile.h"
 
 #include "laf-sub-nnet3.h"
@@ -85,6 +86,7 @@ LafNNet3OnlineModelWrapper::LafNNet3OnlineModelWrapper(LafNNet3OnlineModelConfig
 
 LafNNet3OnlineModelWrapper::~LafNNet3OnlineModelWrapper() {
     CleanupDecoder();
+    InvalidateDecodeFst();
     delete hcl_fst_;
     delete word_syms_relabeled_;
     delete dictation_fst_;
@@ -183,23 +185,57 @@ bool LafNNet3OnlineModelWrapper::RemoveGrammarFst(int32 grammar_fst_index) {
     return true;
 }
 
-// Adapted from src/fstext/fstext-utils-inl.h
-template <class Arc, class I>
-LookaheadFst<Arc, I>* LookaheadComposeFst(const Fst<Arc>& ifst1, const Fst<Arc>& ifst2, const std::vector<I>& to_remove, size_t cache_size) {
-    fst::CacheOptions cache_opts_0(false, 0);  // FirstCacheStore
-    fst::CacheOptions cache_opts(true, cache_size);
-    // fst::ArcMapFstOptions arcmap_opts(cache_opts);  // TODO: should we set this, or leave the default of no caching?
-    // fst::ArcMapFstOptions arcmap_opts(fst::CacheOptions(true, 1<<19));  // TODO: should we set this, or leave the default of no caching?
-    fst::ArcMapFstOptions arcmap_opts(fst::CacheOptions(false, 0));  // TODO: should we set this, or leave the default of no caching?
-    RemoveSomeInputSymbolsMapper<Arc, I> mapper(to_remove);
-    auto compose_fst = ComposeFst<Arc>(ifst1, ifst2, cache_opts_0);
-    return new LookaheadFst<Arc, I>(compose_fst, mapper, arcmap_opts);
+// Splits the decode_fst_cache_size budget between the ReplaceFst, the ComposeFst, and the outermost ArcMapFst.
+void LafNNet3OnlineModelWrapper::GetDecodeFstCacheLimits(size_t* replace_limit, size_t* compose_limit, size_t* decode_limit) const {
+    auto total = config_->decode_fst_cache_size;
+    if (config_->replace_fst_cache_fraction < 0 || config_->compose_fst_cache_fraction < 0
+            || config_->replace_fst_cache_fraction + config_->compose_fst_cache_fraction > 1)
+        KALDI_ERR << "bad decode fst cache fractions";
+    *replace_limit = total * config_->replace_fst_cache_fraction;
+    *compose_limit = total * config_->compose_fst_cache_fraction;
+    *decode_limit = total - *replace_limit - *compose_limit;
 }
 
-void LafNNet3OnlineModelWrapper::BuildDecodeFst() {
+// Estimates the bytes currently held in the cache of a delayed Fst, counting each cached state and its arcs the way
+// GCCacheStore does against its gc_limit. The Fst classes hide their impl, but the inherited (protected)
+// ImplToFst::GetSharedImpl can still be reached through a member pointer formed in a derived class.
+template <class F>
+class FstCacheUsage : public F {
+    public:
+        static size_t Bytes(const F& fst) {
+            std::shared_ptr<typename F::Impl> (F::*get_shared_impl)() const = &FstCacheUsage::GetSharedImpl;
+            auto impl = (fst.*get_shared_impl)();
+            auto cache_store = impl->GetCacheStore();
+            size_t bytes = 0;
+            for (typename F::StateId s = 0; s < impl->NumKnownStates(); ++s) {
+                auto state = cache_store->GetState(s);
+                if (state) bytes += sizeof(*state) + state->NumArcs() * sizeof(typename F::Arc);
+            }
+            return bytes;
+        }
+};
+
+void LafNNet3OnlineModelWrapper::GetDecodeFstCacheInfo(size_t* replace_limit, size_t* compose_limit, size_t* decode_limit,
+        size_t* replace_usage, size_t* compose_usage, size_t* decode_usage, int32* num_compose_fst_builds, int32* num_decode_fst_builds) const {
+    GetDecodeFstCacheLimits(replace_limit, compose_limit, decode_limit);
+    *replace_usage = replace_fst_ ? FstCacheUsage<ReplaceFst<StdArc>>::Bytes(*replace_fst_) : 0;
+    *compose_usage = compose_fst_ ? FstCacheUsage<ComposeFst<StdArc>>::Bytes(*compose_fst_) : 0;
+    if (!decode_fst_)
+        *decode_usage = 0;
+    else if (config_->specialized_decode_fst)  // LookaheadDecodeFst is final, so go through its ArcMapFst base
+        *decode_usage = FstCacheUsage<LookaheadDecodeFst::Base>::Bytes(*static_cast<LookaheadDecodeFst*>(decode_fst_));
+    else
+        *decode_usage = FstCacheUsage<ArcMapFst<StdArc, StdArc, RemoveDisambigAndInactiveRulesMapper<StdArc>>>::Bytes(
+            *static_cast<ArcMapFst<StdArc, StdArc, RemoveDisambigAndInactiveRulesMapper<StdArc>>*>(decode_fst_));
+    *num_compose_fst_builds = num_compose_fst_builds_;
+    *num_decode_fst_builds = num_decode_fst_builds_;
+}
+
+void LafNNet3OnlineModelWrapper::BuildComposeFst() {
     InvalidateDecodeFst();
-    ExecutionTimer timer("BuildDecodeFst", -1);
-    auto cache_size = config_->decode_fst_cache_size;
+    ExecutionTimer timer("BuildComposeFst", -1);
+    size_t replace_cache_limit, compose_cache_limit, decode_cache_limit;
+    GetDecodeFstCacheLimits(&replace_cache_limit, &compose_cache_limit, &decode_cache_limit);
 
     std::vector<std::pair<int32, const StdFst *> > label_fst_pairs;
     auto rules_words_offset = word_syms_->Find("#nonterm:rule0");
@@ -217,33 +253,66 @@ void LafNNet3OnlineModelWrapper::BuildDecodeFst() {
     for (auto word : std::vector<std::string>{ "!SIL", "<unk>" })  // FIXME: make these configurable
         top_fst.AddArc(0, StdArc(word_syms_->Find(word), 0, 0.0, final_state));
 
+    // All grammars are included regardless of activity, which is instead applied on top by BuildDecodeFst().
     if (grammar_fsts_.size() > config_->max_num_rules) KALDI_ERR << "more grammars than max number";
     for (size_t i = 0; i < grammar_fsts_.size(); ++i) {
-        if (decode_fst_grammars_activity_[i]) {
-            top_fst.AddArc(0, StdArc(0, (rules_words_offset + i), 0.0, final_state));
-            label_fst_pairs.emplace_back((rules_words_offset + i), grammar_fsts_.at(i));
-        }
+        top_fst.AddArc(0, StdArc(0, (rules_words_offset + i), 0.0, final_state));
+        label_fst_pairs.emplace_back((rules_words_offset + i), grammar_fsts_.at(i));
     }
     if (dictation_fst_ != nullptr)
         label_fst_pairs.emplace_back(word_syms_->Find("#nonterm:dictation"), dictation_fst_);
     // top_fst.AddArc(0, StdArc(0, word_syms_->Find("#nonterm:dictation"), 0.0, final_state));
     fst::ArcSort(&top_fst, fst::StdILabelCompare());
-    label_fst_pairs.emplace_back(top_fst_nonterm, new fst::StdConstFst(top_fst));
+    fst::StdConstFst top_const_fst(top_fst);  // ReplaceFst keeps its own copy (sharing the impl), so this can be a local
+    label_fst_pairs.emplace_back(top_fst_nonterm, &top_const_fst);
     timer.step("top_fst");
 
     fst::ReplaceFstOptions<StdArc> replace_options(top_fst_nonterm, fst::REPLACE_LABEL_OUTPUT, fst::REPLACE_LABEL_OUTPUT, word_syms_->Find("#nonterm:end"));
-    replace_options.gc_limit = cache_size;  // ReplaceFst needs the most cache space of the 3 delayed Fsts?
-    auto replace_fst = fst::ReplaceFst<StdArc>(label_fst_pairs, replace_options);
+    replace_options.gc = true;
+    replace_options.gc_limit = replace_cache_limit;
+    replace_fst_ = new fst::ReplaceFst<StdArc>(label_fst_pairs, replace_options);
     timer.step("replace_fst");
-    auto decode_fst = LookaheadComposeFst(*hcl_fst_, replace_fst, disambig_tids_, 1ULL<<25);
-    decode_fst_ = decode_fst;
+    fst::CacheOptions compose_cache_opts(true, compose_cache_limit);
+    if (config_->lookahead_compose) {
+        // ComposeFst selects the label-lookahead matcher and the weight/label-pushing lookahead filter itself, but only if
+        // HCLr is an olabel_lookahead Fst; the grammars' ilabels must be relabeled to match (relabel_ilabels_filename).
+        if (fst::LookAheadMatchType(*hcl_fst_, *replace_fst_) != fst::MATCH_OUTPUT)
+            KALDI_WARN << "HCL fst does not support output label-lookahead; composing without lookahead";
+        compose_fst_ = new ComposeFst<StdArc>(*hcl_fst_, *replace_fst_, compose_cache_opts);
+    } else {
+        fst::ComposeFstOptions<StdArc> plain_compose_opts(compose_cache_opts);  // Default matcher & sequence filter
+        compose_fst_ = new ComposeFst<StdArc>(*hcl_fst_, *replace_fst_, plain_compose_opts);
+    }
+    num_compose_fst_builds_++;
+}
+
+void LafNNet3OnlineModelWrapper::BuildDecodeFst() {
+    if (!compose_fst_) BuildComposeFst();
+    delete decode_fst_;
+    // The ArcMapFst shares compose_fst_'s implementation (and so its cache) rather than copying it.
+    auto rules_words_offset = word_syms_->Find("#nonterm:rule0");
+    RemoveDisambigAndInactiveRulesMapper<StdArc> mapper(disambig_tids_, rules_words_offset, decode_fst_grammars_activity_);
+    size_t replace_cache_limit, compose_cache_limit, decode_cache_limit;
+    GetDecodeFstCacheLimits(&replace_cache_limit, &compose_cache_limit, &decode_cache_limit);
+    fst::ArcMapFstOptions arcmap_opts(fst::CacheOptions(true, decode_cache_limit));
+    if (config_->specialized_decode_fst)
+        decode_fst_ = new LookaheadDecodeFst(*compose_fst_, fst::MakeLookaheadDecodeMapper(mapper), arcmap_opts);  // Decoder switches to its non-virtual instantiation
+    else
+        decode_fst_ = new ArcMapFst<StdArc, StdArc, RemoveDisambigAndInactiveRulesMapper<StdArc>>(*compose_fst_, mapper, arcmap_opts);
+    num_decode_fst_builds_++;
+    KALDI_VLOG(1) << "BuildDecodeFst: reusing composition built " << num_compose_fst_builds_ << " times for "
+        << num_decode_fst_builds_ << " grammar activity configurations";
 }
 
 bool LafNNet3OnlineModelWrapper::InvalidateDecodeFst() {
     if (DecoderReady(decoder_)) KALDI_ERR << "cannot modify/invalidate GrammarFst in the middle of decoding!";
-    if (decode_fst_) {
+    if (decode_fst_ || compose_fst_ || replace_fst_) {
         delete decode_fst_;
         decode_fst_ = nullptr;
+        delete compose_fst_;
+        compose_fst_ = nullptr;
+        delete replace_fst_;
+        replace_fst_ = nullptr;
         return true;
     }
     return false;
@@ -254,19 +323,16 @@ void LafNNet3OnlineModelWrapper::StartDecoding() {
     BaseNNet3OnlineModelWrapper::StartDecoding();
 
     if (!decode_fst_ || (decode_fst_grammars_activity_ != grammars_activity_)) {
-        InvalidateDecodeFst();
+        // Only the outermost layer is rebuilt for an activity change; compose_fst_ is rebuilt only if the grammars changed.
         KALDI_ASSERT(grammar_fsts_.size() == grammars_activity_.size());
         decode_fst_grammars_activity_ = grammars_activity_;
-
-        std::vector<fst::StdFst*> active_grammar_fsts;
-        for (size_t i = 0; i < grammar_fsts_.size(); ++i)
-            if (decode_fst_grammars_activity_[i])
-                active_grammar_fsts.push_back(grammar_fsts_[i]);
         BuildDecodeFst();
     }
 
     decoder_ = new SingleUtteranceNnet3DecoderTpl<fst::StdFst>(
         decoder_config_, trans_model_, *decodable_info_, *decode_fst_, feature_pipeline_);
+    utterance_decode_seconds_ = 0;
+    utterance_audio_seconds_ = 0;
 }
 
 void LafNNet3OnlineModelWrapper::CleanupDecoder() {
@@ -278,7 +344,28 @@ void LafNNet3OnlineModelWrapper::CleanupDecoder() {
 bool LafNNet3OnlineModelWrapper::Decode(BaseFloat samp_freq, const Vector<BaseFloat>& samples, bool finalize, bool save_adaptation_state) {
     if (!DecoderReady(decoder_))
         StartDecoding();
-    return BaseNNet3OnlineModelWrapper::Decode(decoder_, samp_freq, samples, finalize, save_adaptation_state);
+    Timer timer;
+    auto result = BaseNNet3OnlineModelWrapper::Decode(decoder_, samp_freq, samples, finalize, save_adaptation_state);
+    utterance_decode_seconds_ += timer.Elapsed();
+    utterance_audio_seconds_ += samples.Dim() / samp_freq;
+
+    if (finalize && GetVerboseLevel() >= 1) {
+        int32 num_frames;
+        float active_tokens_per_frame, real_time_factor;
+        GetDecodeStats(&num_frames, &active_tokens_per_frame, &real_time_factor);
+        KALDI_VLOG(1) << "Decoded " << num_frames << " frames " << (config_->lookahead_compose ? "with" : "without")
+            << " lookahead composition, " << (config_->specialized_decode_fst ? "specialized" : "generic") << " decode fst: " << active_tokens_per_frame << " active tokens/frame, real time factor " << real_time_factor;
+    }
+    return result;
+}
+
+// Search effort and speed of the current (or just finished) utterance, for comparing decode graph configurations
+void LafNNet3OnlineModelWrapper::GetDecodeStats(int32* num_frames, float* active_tokens_per_frame, float* real_time_factor) const {
+    if (!decoder_) KALDI_ERR << "No decoder";
+    const auto& decoder = decoder_->Decoder();
+    *num_frames = decoder.NumFramesDecoded();
+    *active_tokens_per_frame = (*num_frames > 0) ? static_cast<float>(decoder.NumActiveTokensTotal()) / *num_frames : 0;
+    *real_time_factor = (utterance_audio_seconds_ > 0) ? utterance_decode_seconds_ / utterance_audio_seconds_ : 0;
 }
 
 // grammars_activity is ignored once decoding has already started
@@ -492,6 +579,39 @@ bool nnet3_laf__remove_grammar_fst(void* model_vp, int32_t grammar_fst_index) {
     END_INTERFACE_CATCH_HANDLER(false)
 }
 
+bool nnet3_laf__get_decode_stats(void* model_vp, int32_t* num_frames_p, float* active_tokens_per_frame_p, float* real_time_factor_p) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<LafNNet3OnlineModelWrapper*>(model_vp);
+    int32 num_frames;
+    float active_tokens_per_frame, real_time_factor;
+    model->GetDecodeStats(&num_frames, &active_tokens_per_frame, &real_time_factor);
+    if (num_frames_p) *num_frames_p = num_frames;
+    if (active_tokens_per_frame_p) *active_tokens_per_frame_p = active_tokens_per_frame;
+    if (real_time_factor_p) *real_time_factor_p = real_time_factor;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
+bool nnet3_laf__get_decode_fst_cache_info(void* model_vp, int64_t* replace_limit_p, int64_t* compose_limit_p, int64_t* decode_limit_p,
+    int64_t* replace_usage_p, int64_t* compose_usage_p, int64_t* decode_usage_p, int32_t* num_compose_fst_builds_p, int32_t* num_decode_fst_builds_p) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<LafNNet3OnlineModelWrapper*>(model_vp);
+    size_t replace_limit, compose_limit, decode_limit, replace_usage, compose_usage, decode_usage;
+    int32 num_compose_fst_builds, num_decode_fst_builds;
+    model->GetDecodeFstCacheInfo(&replace_limit, &compose_limit, &decode_limit, &replace_usage, &compose_usage, &decode_usage,
+        &num_compose_fst_builds, &num_decode_fst_builds);
+    if (replace_limit_p) *replace_limit_p = replace_limit;
+    if (compose_limit_p) *compose_limit_p = compose_limit;
+    if (decode_limit_p) *decode_limit_p = decode_limit;
+    if (replace_usage_p) *replace_usage_p = replace_usage;
+    if (compose_usage_p) *compose_usage_p = compose_usage;
+    if (decode_usage_p) *decode_usage_p = decode_usage;
+    if (num_compose_fst_builds_p) *num_compose_fst_builds_p = num_compose_fst_builds;
+    if (num_decode_fst_builds_p) *num_decode_fst_builds_p = num_decode_fst_builds;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
+
 bool nnet3_laf__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize,
     bool* grammars_activity_cp, int32_t grammars_activity_cp_size, bool save_adaptation_state) {
     BEGIN_INTERFACE_CATCH_HANDLER
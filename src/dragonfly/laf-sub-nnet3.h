@@ -55,7 +55,11 @@ struct LafNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
     std::string dictation_fst_filename;
     int32 rules_words_offset = 1000000;
     int32 max_num_rules = 9999;
-    size_t decode_fst_cache_size = 1ULL << 30;  // Note: this is used independently for 3 separate Fsts! FIXME: should we adjust this based on size of grammars + dictation fsts?
+    size_t decode_fst_cache_size = 1ULL << 30;  // Cache budget (bytes) of each model wrapper (not of the process), shared by its 3 delayed decode Fsts, split by the fractions below. FIXME: should we adjust this based on size of grammars + dictation fsts?
+    float replace_fst_cache_fraction = 0.5;  // ReplaceFst needs the most cache space of the 3 delayed Fsts?
+    float compose_fst_cache_fraction = 0.375;  // The remainder goes to the outermost ArcMapFst
+    bool lookahead_compose = true;  // Compose with HCLr's output label-lookahead matcher (with weight & label pushing); false composes plainly, for benchmarking
+    bool specialized_decode_fst = true;  // Decode from LookaheadDecodeFst, for which the decoder avoids virtual Fst calls; false uses the generic path, for benchmarking
 
     bool Set(const std::string& name, const nlohmann::json& value) override {
         if (BaseNNet3OnlineModelConfig::Set(name, value)) { return true; }
@@ -67,6 +71,10 @@ struct LafNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
         if (name == "rules_words_offset") { value.get_to(rules_words_offset); return true; }
         if (name == "max_num_rules") { value.get_to(max_num_rules); return true; }
         if (name == "decode_fst_cache_size") { value.get_to(decode_fst_cache_size); return true; }
+        if (name == "replace_fst_cache_fraction") { value.get_to(replace_fst_cache_fraction); return true; }
+        if (name == "compose_fst_cache_fraction") { value.get_to(compose_fst_cache_fraction); return true; }
+        if (name == "lookahead_compose") { value.get_to(lookahead_compose); return true; }
+        if (name == "specialized_decode_fst") { value.get_to(specialized_decode_fst); return true; }
         return false;
     }
 
@@ -82,6 +90,10 @@ struct LafNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
         ss << "\n    " << "rules_words_offset: " << rules_words_offset;
         ss << "\n    " << "max_num_rules: " << max_num_rules;
         ss << "\n    " << "decode_fst_cache_size: " << decode_fst_cache_size;
+        ss << "\n    " << "replace_fst_cache_fraction: " << replace_fst_cache_fraction;
+        ss << "\n    " << "compose_fst_cache_fraction: " << compose_fst_cache_fraction;
+        ss << "\n    " << "lookahead_compose: " << lookahead_compose;
+        ss << "\n    " << "specialized_decode_fst: " << specialized_decode_fst;
         return ss.str();
     }
 };
@@ -99,6 +111,9 @@ class LafNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         bool ReloadGrammarFst(int32 grammar_fst_index, fst::StdExpandedFst* grammar_fst, std::string grammar_name = "<unnamed>");  // Does not take ownership of FST!
         bool RemoveGrammarFst(int32 grammar_fst_index);
         void SetActiveGrammars(const std::vector<bool>& grammars_activity) { grammars_activity_ = grammars_activity; };
+        void GetDecodeStats(int32* num_frames, float* active_tokens_per_frame, float* real_time_factor) const;
+        void GetDecodeFstCacheInfo(size_t* replace_limit, size_t* compose_limit, size_t* decode_limit,
+            size_t* replace_usage, size_t* compose_usage, size_t* decode_usage, int32* num_compose_fst_builds, int32* num_decode_fst_builds) const;
 
         bool Decode(BaseFloat samp_freq, const Vector<BaseFloat>& frames, bool finalize, const std::vector<bool>& grammars_activity, bool save_adaptation_state = true);
         bool Decode(BaseFloat samp_freq, const Vector<BaseFloat>& frames, bool finalize, bool save_adaptation_state = true) override;
@@ -120,13 +135,19 @@ class LafNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         std::vector<bool> grammars_activity_;  // bitfield of whether each grammar is active for current/upcoming utterance
 
         // Model objects
-        StdFst* decode_fst_ = nullptr;
+        ReplaceFst<StdArc>* replace_fst_ = nullptr;  // all grammars (regardless of activity); shares its impl (and so its cache) with the copy inside compose_fst_
+        ComposeFst<StdArc>* compose_fst_ = nullptr;  // HCL composed with all grammars (regardless of activity); persists across activity changes
+        StdFst* decode_fst_ = nullptr;  // compose_fst_ with disambig tids removed and inactive grammars disabled
         std::vector<bool> decode_fst_grammars_activity_;  // grammars_activity_ for decode_fst_ creation
+        int32 num_compose_fst_builds_ = 0, num_decode_fst_builds_ = 0;  // for reporting how often compose_fst_ is reused
+        double utterance_decode_seconds_ = 0, utterance_audio_seconds_ = 0;  // For real time factor of the current utterance
 
         // Decoder objects
         SingleUtteranceNnet3DecoderTpl<fst::StdFst>* decoder_ = nullptr;  // reinstantiated per utterance
         CombineRuleNontermMapper<CompactLatticeArc>* rule_relabel_mapper_ = nullptr;
 
+        void GetDecodeFstCacheLimits(size_t* replace_limit, size_t* compose_limit, size_t* decode_limit) const;
+        void BuildComposeFst();
         void BuildDecodeFst();
         bool InvalidateDecodeFst();
         void StartDecoding() override;
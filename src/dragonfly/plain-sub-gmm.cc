@@ -0,0 +1,149 @@
+// GMM Plain
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#include "feat/wave-reader.h"
+#include "online2/online-feature-pipeline.h"
+#include "online2/online-gmm-decoding.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice-lexicon.h"
+
+#include "plain-sub-gmm.h"
+#include "utils.h"
+#include "kaldi-utils.h"
+#include "nlohmann_json.hpp"
+
+namespace dragonfly {
+
+using namespace kaldi;
+using namespace fst;
+
+PlainGmmOnlineModelWrapper::PlainGmmOnlineModelWrapper(PlainGmmOnlineModelConfig::Ptr config, int32 verbosity)
+    : BaseGmmOnlineModelWrapper(config, verbosity), config_(config) {
+    decode_fst_ = CastOrConvertToConstFst(ReadFstKaldiGeneric(config_->decode_fst_filename));
+}
+
+PlainGmmOnlineModelWrapper::~PlainGmmOnlineModelWrapper() {
+    CleanupDecoder();
+    delete decode_fst_;
+}
+
+void PlainGmmOnlineModelWrapper::StartDecoding() {
+    ExecutionTimer timer("StartDecoding", 2);
+    BaseGmmOnlineModelWrapper::StartDecoding();
+    decoder_ = new SingleUtteranceGmmDecoder(
+        decode_config_, *gmm_models_, *feature_pipeline_prototype_, *decode_fst_, adaptation_state_);
+}
+
+void PlainGmmOnlineModelWrapper::CleanupDecoder() {
+    delete decoder_;
+    decoder_ = nullptr;
+}
+
+bool PlainGmmOnlineModelWrapper::Decode(BaseFloat samp_freq, const Vector<BaseFloat>& samples, bool finalize, bool save_adaptation_state) {
+    ExecutionTimer timer("Decode", 2);
+
+    if (!decoder_ || decoder_finalized_)
+        StartDecoding();
+
+    if (samples.Dim() > 0)
+        decoder_->FeaturePipeline().AcceptWaveform(samp_freq, samples);
+
+    if (finalize)
+        decoder_->FeaturePipeline().InputFinished();  // No more input, so flush out last frames.
+
+    decoder_->AdvanceDecoding();
+    tot_frames_ = decoder_->NumFramesDecoded();
+
+    if (finalize) {
+        ExecutionTimer timer("Decode finalize", 2);
+        decoder_->FinalizeDecoding();
+        decoder_finalized_ = true;
+
+        tot_frames_decoded_ += tot_frames_;
+        tot_frames_ = 0;
+
+        bool end_of_utterance = true;
+        decoder_->EstimateFmllr(end_of_utterance);
+        CompactLattice clat;
+        decoder_->GetLattice(true, end_of_utterance, &clat);
+        if (clat.NumStates() == 0) {
+            KALDI_WARN << "Empty lattice";
+            return false;
+        }
+        CompactLatticeShortestPath(clat, &best_path_clat_);
+
+        // Only after GetLattice(), because the decoder refers to adaptation_state_ to decide whether to rescore.
+        if (save_adaptation_state)
+            decoder_->GetAdaptationState(&adaptation_state_);
+    }
+
+    return true;
+}
+
+void PlainGmmOnlineModelWrapper::GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) {
+    ExecutionTimer timer("GetDecodedString", 2);
+
+    decoded_string = "";
+    if (likelihood) *likelihood = NAN;
+    if (lm_score) *lm_score = NAN;
+    if (am_score) *am_score = NAN;
+
+    if (!decoder_) KALDI_ERR << "No decoder";
+    Lattice best_path_lat;
+    if (!decoder_finalized_) {
+        // Decoding is not finished yet, so we will just look up the best partial result so far
+        if (decoder_->NumFramesDecoded() == 0) return;
+        decoder_->GetBestPath(false, &best_path_lat);
+    } else {
+        if (best_path_clat_.NumStates() == 0) {
+            KALDI_WARN << "GetDecodedString on empty decoder";
+            return;
+        }
+        ConvertLattice(best_path_clat_, &best_path_lat);
+    }
+
+    BestPathToDecodedString(best_path_lat, decoded_string, likelihood, am_score, lm_score);
+}
+
+} // namespace dragonfly
+
+
+extern "C" {
+#include "dragonfly.h"
+}
+
+using namespace dragonfly;
+
+void* gmm_plain__construct(char* model_dir_cp, char* config_str_cp, int32_t verbosity) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    std::string model_dir(model_dir_cp),
+        config_str((config_str_cp != nullptr) ? config_str_cp : "");
+    auto model = new PlainGmmOnlineModelWrapper(PlainGmmOnlineModelConfig::Create(model_dir, config_str), verbosity);
+    return model;
+    END_INTERFACE_CATCH_HANDLER(nullptr)
+}
+
+bool gmm_plain__destruct(void* model_vp) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<PlainGmmOnlineModelWrapper*>(model_vp);
+    delete model;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
@@ -0,0 +1,85 @@
+// GMM Plain
+
+// Copyright   2019  David Zurow
+
+// This program is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Affero General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License
+// for more details.
+
+// You should have received a copy of the GNU Affero General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "feat/wave-reader.h"
+#include "online2/online-feature-pipeline.h"
+#include "online2/online-gmm-decoding.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice-lexicon.h"
+
+#include "base-gmm.h"
+#include "utils.h"
+#include "kaldi-utils.h"
+#include "nlohmann_json.hpp"
+
+namespace dragonfly {
+
+using namespace kaldi;
+using namespace fst;
+
+struct PlainGmmOnlineModelConfig : public BaseGmmOnlineModelConfig {
+    using Ptr = std::shared_ptr<PlainGmmOnlineModelConfig>;
+
+    static constexpr auto Create = BaseNNet3OnlineModelConfig::Create<PlainGmmOnlineModelConfig>;
+
+    std::string decode_fst_filename;
+
+    bool Set(const std::string& name, const nlohmann::json& value) override {
+        if (BaseGmmOnlineModelConfig::Set(name, value)) { return true; }
+        if (name == "decode_fst_filename") { value.get_to(decode_fst_filename); return true; }
+        return false;
+    }
+
+    std::string ToString() override {
+        stringstream ss;
+        ss << BaseGmmOnlineModelConfig::ToString() << '\n';
+        ss << "PlainGmmOnlineModelConfig...";
+        ss << "\n    " << "decode_fst_filename: " << decode_fst_filename;
+        return ss.str();
+    }
+};
+
+// Decodes a single graph with an online (fMLLR-adapting) GMM model, through SingleUtteranceGmmDecoder.
+class PlainGmmOnlineModelWrapper : public BaseGmmOnlineModelWrapper {
+    public:
+
+        PlainGmmOnlineModelWrapper(PlainGmmOnlineModelConfig::Ptr config, int32 verbosity = DEFAULT_VERBOSITY);
+        ~PlainGmmOnlineModelWrapper() override;
+
+        bool Decode(BaseFloat samp_freq, const Vector<BaseFloat>& frames, bool finalize, bool save_adaptation_state = true) override;
+        void GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) override;
+
+    protected:
+
+        PlainGmmOnlineModelConfig::Ptr config_;
+
+        // Model objects
+        StdConstFst* decode_fst_ = nullptr;
+
+        // Decoder objects
+        SingleUtteranceGmmDecoder* decoder_ = nullptr;  // reinstantiated per utterance
+
+        void StartDecoding() override;
+        void CleanupDecoder() override;
+};
+
+} // namespace dragonfly
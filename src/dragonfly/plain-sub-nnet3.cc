@@ -44,9 +44,13 @@ PlainNNet3OnlineModelWrapper::PlainNNet3OnlineModelWrapper(PlainNNet3OnlineModel
     : BaseNNet3OnlineModelWrapper(config, verbosity), config_(config) {
     if (!config_->decode_fst_filename.empty())
         decode_fst_ = dynamic_cast<StdConstFst*>(ReadFstKaldiGeneric(config_->decode_fst_filename));
+    background_rescoring_ = config_->background_rescoring;
+    if (background_rescoring_ && !enable_rnnlm_ && !enable_carpa_)
+        KALDI_WARN << "background_rescoring enabled but no rescoring (rnnlm/carpa) enabled; ignoring";
 }
 
 PlainNNet3OnlineModelWrapper::~PlainNNet3OnlineModelWrapper() {
+    WaitForBackgroundRescoring();  // it uses the rescoring LMs, which are deleted by the base class
     CleanupDecoder();
     delete decode_fst_;
 }
@@ -54,6 +58,8 @@ PlainNNet3OnlineModelWrapper::~PlainNNet3OnlineModelWrapper() {
 void PlainNNet3OnlineModelWrapper::StartDecoding() {
     ExecutionTimer timer("StartDecoding", 2);
     BaseNNet3OnlineModelWrapper::StartDecoding();
+    background_rescoring_started_ = false;
+    utterance_id_ = -1;
     decoder_ = new SingleUtteranceNnet3Decoder(
         decoder_config_, trans_model_, *decodable_info_, *decode_fst_, feature_pipeline_);
 }
@@ -67,7 +73,10 @@ void PlainNNet3OnlineModelWrapper::CleanupDecoder() {
 bool PlainNNet3OnlineModelWrapper::Decode(BaseFloat samp_freq, const Vector<BaseFloat>& samples, bool finalize, bool save_adaptation_state) {
     if (!DecoderReady(decoder_))
         StartDecoding();
-    return BaseNNet3OnlineModelWrapper::Decode(decoder_, samp_freq, samples, finalize, save_adaptation_state);
+    auto result = BaseNNet3OnlineModelWrapper::Decode(decoder_, samp_freq, samples, finalize, save_adaptation_state);
+    if (decoder_finalized_ && utterance_id_ < 0)
+        utterance_id_ = num_finalized_utterances_++;
+    return result;
 }
 
 void PlainNNet3OnlineModelWrapper::GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score, float* confidence, float* expected_error_rate) {
@@ -92,95 +101,117 @@ void PlainNNet3OnlineModelWrapper::GetDecodedString(std::string& decoded_string,
         // Decoding is not finished yet, so we will just look up the best partial result so far
         decoder_->GetBestPath(false, &best_path_lat);
 
-    } else {
+    } else if (background_rescoring_ && (enable_rnnlm_ || enable_carpa_)) {
         decoder_->GetLattice(true, &decoded_clat_);
         if (decoded_clat_.NumStates() == 0) KALDI_ERR << "Empty decoded lattice";
-        // WriteLattice(decoded_clat, "tmp/lattice");
+        if (!background_rescoring_started_) {
+            StartBackgroundRescoring(decoded_clat_);
+            background_rescoring_started_ = true;
+        }
 
-        if (enable_rnnlm_)
-            RescoreRnnlm(decoded_clat_, lm_prime_text_);
-        else if (!lm_prime_text_.empty())
-            KALDI_WARN << "prime text only supported by rnnlm";
-        if (enable_carpa_)
-            RescoreConstArpaLm(decoded_clat_);
+        // First-pass result only; confidence and expected_error_rate come with the rescored result.
         if (config_->lm_weight != 10.0)
             ScaleLattice(LatticeScale(config_->lm_weight / 10.0, 1.0), &decoded_clat_);
+        CompactLatticeShortestPath(decoded_clat_, &best_path_clat_);
+        ConvertLattice(best_path_clat_, &best_path_lat);
 
-        CompactLattice decoded_clat_relabeled = decoded_clat_;
+    } else {
+        decoder_->GetLattice(true, &decoded_clat_);
+        if (decoded_clat_.NumStates() == 0) KALDI_ERR << "Empty decoded lattice";
+        // WriteLattice(decoded_clat, "tmp/lattice");
+        ProcessFinalLattice(decoded_clat_, lm_prime_text_, &best_path_clat_, confidence, expected_error_rate);
+        ConvertLattice(best_path_clat_, &best_path_lat);
+    } // if (decoder_finalized_)
 
-        if (false || (true && (GetVerboseLevel() >= 1))) {
-            // Difference between best path and second best path
-            ExecutionTimer timer("confidence");
-            int32 num_paths;
-            // float conf = SentenceLevelConfidence(decoded_clat, &num_paths, NULL, NULL);
-            std::vector<int32> best_sentence, second_best_sentence;
-            float conf = SentenceLevelConfidence(decoded_clat_relabeled, &num_paths, &best_sentence, &second_best_sentence);
-            timer.stop();
-            KALDI_LOG << "SLC(" << num_paths << "paths): " << conf;
-            if (num_paths >= 1) KALDI_LOG << "    1st best: " << WordIdsToString(best_sentence);
-            if (num_paths >= 2) KALDI_LOG << "    2nd best: " << WordIdsToString(second_best_sentence);
-            if (confidence) *confidence = conf;
-        }
+    GetBestPathOutput(best_path_lat, decoded_string, likelihood, am_score, lm_score);
+}
 
-        if (false || (true && (GetVerboseLevel() >= 1))) {
-            // Expected sentence error rate
-            ExecutionTimer timer("expected_ser");
-            MinimumBayesRiskOptions mbr_opts;
-            mbr_opts.decode_mbr = false;
-            MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
-            const vector<int32> &words = mbr.GetOneBest();
-            // const vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
-            // const vector<pair<BaseFloat, BaseFloat> > &times = mbr.GetOneBestTimes();
-            auto risk = mbr.GetBayesRisk();
-            timer.stop();
-            KALDI_LOG << "MBR(SER): " << risk << " : " << WordIdsToString(words);
-            if (expected_error_rate) *expected_error_rate = risk;
-        }
+void PlainNNet3OnlineModelWrapper::ProcessFinalLattice(CompactLattice& clat, const std::string& prime_text, CompactLattice* best_path_clat,
+        float* confidence, float* expected_error_rate) {
+    if (enable_rnnlm_)
+        RescoreRnnlm(clat, prime_text);
+    else if (!prime_text.empty())
+        KALDI_WARN << "prime text only supported by rnnlm";
+    if (enable_carpa_)
+        RescoreConstArpaLm(clat);
+    if (config_->lm_weight != 10.0)
+        ScaleLattice(LatticeScale(config_->lm_weight / 10.0, 1.0), &clat);
+
+    CompactLattice decoded_clat_relabeled = clat;
+
+    if (false || (true && (GetVerboseLevel() >= 1))) {
+        // Difference between best path and second best path
+        ExecutionTimer timer("confidence");
+        int32 num_paths;
+        // float conf = SentenceLevelConfidence(decoded_clat, &num_paths, NULL, NULL);
+        std::vector<int32> best_sentence, second_best_sentence;
+        float conf = SentenceLevelConfidence(decoded_clat_relabeled, &num_paths, &best_sentence, &second_best_sentence);
+        timer.stop();
+        KALDI_LOG << "SLC(" << num_paths << "paths): " << conf;
+        if (num_paths >= 1) KALDI_LOG << "    1st best: " << WordIdsToString(best_sentence);
+        if (num_paths >= 2) KALDI_LOG << "    2nd best: " << WordIdsToString(second_best_sentence);
+        if (confidence) *confidence = conf;
+    }
 
-        if (false || (true && (GetVerboseLevel() >= 1))) {
-            // Expected word error rate
-            ExecutionTimer timer("expected_wer");
-            MinimumBayesRiskOptions mbr_opts;
-            mbr_opts.decode_mbr = true;
-            MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
-            const vector<int32> &words = mbr.GetOneBest();
-            // const vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
-            // const vector<pair<BaseFloat, BaseFloat> > &times = mbr.GetOneBestTimes();
-            auto risk = mbr.GetBayesRisk();
-            timer.stop();
-            KALDI_LOG << "MBR(WER): " << risk << " : " << WordIdsToString(words);
-            if (expected_error_rate) *expected_error_rate = risk;
-
-            if (true) {
-                ExecutionTimer timer("compare mbr");
-                MinimumBayesRiskOptions mbr_opts;
-                mbr_opts.decode_mbr = false;
-                MinimumBayesRisk mbr_ser(decoded_clat_relabeled, mbr_opts);
-                const vector<int32> &words_ser = mbr_ser.GetOneBest();
-                timer.stop();
-                if (mbr.GetBayesRisk() != mbr_ser.GetBayesRisk()) KALDI_WARN << "MBR risks differ";
-                if (words != words_ser) KALDI_WARN << "MBR words differ";
-            }
-        }
+    if (false || (true && (GetVerboseLevel() >= 1))) {
+        // Expected sentence error rate
+        ExecutionTimer timer("expected_ser");
+        MinimumBayesRiskOptions mbr_opts;
+        mbr_opts.decode_mbr = false;
+        MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
+        const vector<int32> &words = mbr.GetOneBest();
+        // const vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
+        // const vector<pair<BaseFloat, BaseFloat> > &times = mbr.GetOneBestTimes();
+        auto risk = mbr.GetBayesRisk();
+        timer.stop();
+        KALDI_LOG << "MBR(SER): " << risk << " : " << WordIdsToString(words);
+        if (expected_error_rate) *expected_error_rate = risk;
+    }
+
+    if (false || (true && (GetVerboseLevel() >= 1))) {
+        // Expected word error rate
+        ExecutionTimer timer("expected_wer");
+        MinimumBayesRiskOptions mbr_opts;
+        mbr_opts.decode_mbr = true;
+        MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
+        const vector<int32> &words = mbr.GetOneBest();
+        // const vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
+        // const vector<pair<BaseFloat, BaseFloat> > &times = mbr.GetOneBestTimes();
+        auto risk = mbr.GetBayesRisk();
+        timer.stop();
+        KALDI_LOG << "MBR(WER): " << risk << " : " << WordIdsToString(words);
+        if (expected_error_rate) *expected_error_rate = risk;
 
         if (true) {
-            // Use MAP (SER) as expected error rate
-            ExecutionTimer timer("expected_error_rate");
+            ExecutionTimer timer("compare mbr");
             MinimumBayesRiskOptions mbr_opts;
             mbr_opts.decode_mbr = false;
-            MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
-            // const vector<int32> &words = mbr.GetOneBest();
-            if (expected_error_rate) *expected_error_rate = mbr.GetBayesRisk();
-            // FIXME: also do confidence?
+            MinimumBayesRisk mbr_ser(decoded_clat_relabeled, mbr_opts);
+            const vector<int32> &words_ser = mbr_ser.GetOneBest();
+            timer.stop();
+            if (mbr.GetBayesRisk() != mbr_ser.GetBayesRisk()) KALDI_WARN << "MBR risks differ";
+            if (words != words_ser) KALDI_WARN << "MBR words differ";
         }
+    }
 
-        // if (enable_rnnlm_)
-        //     RescoreRnnlm(decoded_clat_, "back");
+    if (true) {
+        // Use MAP (SER) as expected error rate
+        ExecutionTimer timer("expected_error_rate");
+        MinimumBayesRiskOptions mbr_opts;
+        mbr_opts.decode_mbr = false;
+        MinimumBayesRisk mbr(decoded_clat_relabeled, mbr_opts);
+        // const vector<int32> &words = mbr.GetOneBest();
+        if (expected_error_rate) *expected_error_rate = mbr.GetBayesRisk();
+        // FIXME: also do confidence?
+    }
 
-        CompactLatticeShortestPath(decoded_clat_, &best_path_clat_);
-        ConvertLattice(best_path_clat_, &best_path_lat);
-    } // if (decoder_finalized_)
+    // if (enable_rnnlm_)
+    //     RescoreRnnlm(decoded_clat_, "back");
+
+    CompactLatticeShortestPath(clat, best_path_clat);
+}
 
+void PlainNNet3OnlineModelWrapper::GetBestPathOutput(const Lattice& best_path_lat, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score) {
     std::vector<int32> words;
     std::vector<int32> alignment;
     LatticeWeight weight;
@@ -191,11 +222,62 @@ void PlainNNet3OnlineModelWrapper::GetDecodedString(std::string& decoded_string,
     // int32 num_words = words.size();
     if (lm_score) *lm_score = weight.Value1();
     if (am_score) *am_score = weight.Value2();
-    if (likelihood) *likelihood = expf(-(*lm_score + *am_score) / num_frames);
+    if (likelihood) *likelihood = expf(-(weight.Value1() + weight.Value2()) / num_frames);
 
     decoded_string = WordIdsToString(words);
 }
 
+void PlainNNet3OnlineModelWrapper::StartBackgroundRescoring(const CompactLattice& clat) {
+    // Only one job at a time; normally the previous one finished while this utterance was being decoded.
+    WaitForBackgroundRescoring();
+    // The lattice and prime text are copied into the thread, since the caller moves on to the next utterance.
+    rescoring_thread_ = std::thread(&PlainNNet3OnlineModelWrapper::RescoreInBackground, this, clat, lm_prime_text_, utterance_id_);
+}
+
+void PlainNNet3OnlineModelWrapper::RescoreInBackground(CompactLattice clat, std::string prime_text, int32 utterance_id) {
+    try {
+        ExecutionTimer timer("background rescoring", 1);
+        RescoredOutput output;
+        output.utterance_id = utterance_id;
+        CompactLattice best_path_clat;
+        ProcessFinalLattice(clat, prime_text, &best_path_clat, &output.confidence, &output.expected_error_rate);
+        Lattice best_path_lat;
+        ConvertLattice(best_path_clat, &best_path_lat);
+        GetBestPathOutput(best_path_lat, output.decoded_string, &output.likelihood, &output.am_score, &output.lm_score);
+        std::lock_guard<std::mutex> lock(rescored_outputs_mutex_);
+        rescored_outputs_[utterance_id] = std::move(output);
+    } catch (const std::exception& e) {
+        KALDI_WARN << "Background rescoring of utterance " << utterance_id << " failed: " << e.what();
+    }
+}
+
+void PlainNNet3OnlineModelWrapper::WaitForBackgroundRescoring() {
+    if (rescoring_thread_.joinable())
+        rescoring_thread_.join();
+}
+
+bool PlainNNet3OnlineModelWrapper::GetRescoredOutput(bool wait, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score,
+        float* confidence, float* expected_error_rate, int32* utterance_id) {
+    if (wait)
+        WaitForBackgroundRescoring();
+    RescoredOutput output;
+    {
+        std::lock_guard<std::mutex> lock(rescored_outputs_mutex_);
+        if (rescored_outputs_.empty())
+            return false;
+        output = std::move(rescored_outputs_.begin()->second);
+        rescored_outputs_.erase(rescored_outputs_.begin());
+    }
+    decoded_string = output.decoded_string;
+    if (likelihood) *likelihood = output.likelihood;
+    if (am_score) *am_score = output.am_score;
+    if (lm_score) *lm_score = output.lm_score;
+    if (confidence) *confidence = output.confidence;
+    if (expected_error_rate) *expected_error_rate = output.expected_error_rate;
+    if (utterance_id) *utterance_id = output.utterance_id;
+    return true;
+}
+
 } // namespace dragonfly
 
 
@@ -225,3 +307,21 @@ bool nnet3_plain__destruct(void* model_vp) {
 bool nnet3_plain__decode(void* model_vp, float samp_freq, int32_t num_samples, float* samples, bool finalize, bool save_adaptation_state) {
     return nnet3_base__decode(model_vp, samp_freq, num_samples, samples, finalize, save_adaptation_state);
 }
+
+bool nnet3_plain__get_rescored_output(void* model_vp, bool wait, char* output, int32_t output_max_length,
+        float* likelihood_p, float* am_score_p, float* lm_score_p, float* confidence_p, float* expected_error_rate_p,
+        int32_t* utterance_id_p, bool* ready_p) {
+    BEGIN_INTERFACE_CATCH_HANDLER
+    auto model = static_cast<PlainNNet3OnlineModelWrapper*>(model_vp);
+    if (output_max_length < 1) return false;
+    std::string decoded_string;
+    int32 utterance_id = -1;
+    bool ready = model->GetRescoredOutput(wait, decoded_string, likelihood_p, am_score_p, lm_score_p, confidence_p, expected_error_rate_p, &utterance_id);
+    if (utterance_id_p) *utterance_id_p = utterance_id;
+    if (ready_p) *ready_p = ready;
+    const char* cstr = decoded_string.c_str();
+    strncpy(output, cstr, output_max_length);
+    output[output_max_length - 1] = 0;
+    return true;
+    END_INTERFACE_CATCH_HANDLER(false)
+}
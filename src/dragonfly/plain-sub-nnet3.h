@@ -32,6 +32,10 @@
 #include "nnet3/nnet-utils.h"
 #include "decoder/active-grammar-fst.h"
 
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include "base-nnet3.h"
 #include "utils.h"
 #include "kaldi-utils.h"
@@ -48,10 +52,12 @@ struct PlainNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
     static constexpr auto Create = BaseNNet3OnlineModelConfig::Create<PlainNNet3OnlineModelConfig>;
 
     std::string decode_fst_filename;
+    bool background_rescoring = false;  // Return the first-pass result immediately, and rescore (rnnlm/carpa) on a worker thread; see GetRescoredOutput()
 
     bool Set(const std::string& name, const nlohmann::json& value) override {
         if (BaseNNet3OnlineModelConfig::Set(name, value)) { return true; }
         if (name == "decode_fst_filename") { decode_fst_filename = value.get<std::string>(); return true; }
+        if (name == "background_rescoring") { value.get_to(background_rescoring); return true; }
         return false;
     }
 
@@ -60,6 +66,7 @@ struct PlainNNet3OnlineModelConfig : public BaseNNet3OnlineModelConfig {
         ss << BaseNNet3OnlineModelConfig::ToString() << '\n';
         ss << "PlainNNet3OnlineModelConfig...";
         ss << "\n    " << "decode_fst_filename: " << decode_fst_filename;
+        ss << "\n    " << "background_rescoring: " << background_rescoring;
         return ss.str();
     }
 };
@@ -73,8 +80,21 @@ class PlainNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         bool Decode(BaseFloat samp_freq, const Vector<BaseFloat>& frames, bool finalize, bool save_adaptation_state = true) override;
         void GetDecodedString(std::string& decoded_string, float* likelihood, float* am_score, float* lm_score, float* confidence, float* expected_error_rate) override;
 
+        // With background_rescoring, GetDecodedString() on a finalized utterance returns the first-pass result, and the
+        // rescored result is delivered here later. Results are queued, and each call retrieves the oldest one not yet
+        // retrieved; returns whether there was one. If wait, first blocks until any rescoring in progress has finished.
+        // utterance_id counts every finalized utterance from 0, whether or not it was rescored in the background.
+        bool GetRescoredOutput(bool wait, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score,
+            float* confidence, float* expected_error_rate, int32* utterance_id);
+
     protected:
 
+        struct RescoredOutput {
+            int32 utterance_id = -1;
+            std::string decoded_string;
+            float likelihood = NAN, am_score = NAN, lm_score = NAN, confidence = NAN, expected_error_rate = NAN;
+        };
+
         PlainNNet3OnlineModelConfig::Ptr config_;
 
         // Model objects
@@ -83,8 +103,24 @@ class PlainNNet3OnlineModelWrapper : public BaseNNet3OnlineModelWrapper {
         // Decoder objects
         SingleUtteranceNnet3Decoder* decoder_ = nullptr;  // reinstantiated per utterance
 
+        // Background rescoring: at most one job runs at a time, so the rescoring LMs (and their caches) are only ever
+        // used from one thread; the decoder never touches them in this mode.
+        bool background_rescoring_ = false;
+        bool background_rescoring_started_ = false;  // for the current utterance
+        int32 num_finalized_utterances_ = 0;
+        int32 utterance_id_ = -1;  // of the current utterance, once finalized
+        std::thread rescoring_thread_;
+        std::mutex rescored_outputs_mutex_;  // guards rescored_outputs_
+        std::map<int32, RescoredOutput> rescored_outputs_;  // not yet retrieved, by utterance_id
+
         void StartDecoding() override;
         void CleanupDecoder() override;
+        void ProcessFinalLattice(CompactLattice& clat, const std::string& prime_text, CompactLattice* best_path_clat,
+            float* confidence, float* expected_error_rate);
+        void GetBestPathOutput(const Lattice& best_path_lat, std::string& decoded_string, float* likelihood, float* am_score, float* lm_score);
+        void StartBackgroundRescoring(const CompactLattice& clat);
+        void RescoreInBackground(CompactLattice clat, std::string prime_text, int32 utterance_id);  // runs on rescoring_thread_
+        void WaitForBackgroundRescoring();
 };
 
 } // namespace dragonfly
@@ -22,6 +22,15 @@
 #include <sstream>
 #include "base/kaldi-error.h"
 
+// For the extern "C" interface functions: KALDI_ERR must not propagate across it.
+#define BEGIN_INTERFACE_CATCH_HANDLER \
+    try {
+#define END_INTERFACE_CATCH_HANDLER(expr) \
+    } catch(const std::exception& e) { \
+        KALDI_WARN << "Trying to survive fatal exception: " << e.what(); \
+        return (expr); \
+    }
+
 // Adapted from wav2letter and https://stackoverflow.com/questions/22387586/measuring-execution-time-of-a-function-in-c/48220627#48220627
 class ExecutionTimer {
    public:
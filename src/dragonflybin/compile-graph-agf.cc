@@ -27,6 +27,25 @@
 #include "decoder/active-grammar-fst.h"
 #include "fst/script/compile.h"
 
+#include <future>
+#if !defined(_MSC_VER)
+#include <sys/resource.h>
+#endif
+
+// Returns the peak resident set size of this process in megabytes, or -1 if unknown.
+static double PeakMemoryMb() {
+#if !defined(_MSC_VER)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+    return usage.ru_maxrss / 1024.0;  // kilobytes
+#endif
+  }
+#endif
+  return -1;
+}
 
 
 int main(int argc, char *argv[]) {
@@ -84,6 +103,12 @@ int main(int argc, char *argv[]) {
     po.Register("grammar-append-nonterm", &grammar_append_nonterm, "");
     po.Register("simplify-lg", &simplify_lg, "Bool whether to simplify LG (do for command grammars, but not for dictation graph!)");
 
+    bool parallel_prepare_g = false;
+    po.Register("parallel-prepare-g", &parallel_prepare_g, "If true, read and "
+                "prepare G on a separate thread, concurrently with reading the "
+                "tree, model and lexicon.  (The later composition/determinization "
+                "stages are inherently sequential.)");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -97,6 +122,88 @@ int main(int argc, char *argv[]) {
         grammar_rxfilename = po.GetArg(4),
         hclg_wxfilename = po.GetArg(5);
 
+    Timer timer;
+    auto report_stage = [&timer](const std::string &stage) {
+      KALDI_VLOG(1) << "Finished " << stage << " at " << timer.Elapsed()
+                    << " seconds, peak memory " << PeakMemoryMb() << " MB";
+    };
+
+    VectorFst<StdArc> *grammar_fst = NULL;
+    auto prepare_grammar = [&]() {
+      KALDI_VLOG(1) << "Preparing G...";
+
+      if (compile_grammar) {
+        KALDI_ERR << "compile-grammar not supported";
+        // kaldi::Input ki;
+        // ki.OpenTextMode(grammar_rxfilename);
+        // std::unique_ptr<const SymbolTable> isyms, osyms, ssyms;
+        // isyms.reset(SymbolTable::ReadText(grammar_symbols));
+        // if (!isyms) return 1;
+        // osyms.reset(SymbolTable::ReadText(grammar_symbols));
+        // if (!osyms) return 1;
+        // auto compiled_fst = fst::script::CompileFstInternal(
+        //     ki.Stream(), grammar_rxfilename, "vector", "standard", isyms.get(),
+        //     osyms.get(), ssyms.get(), false, false, false, false, false);
+        // // grammar_fst = fst::CastOrConvertToVectorFst(compiled_fst);
+        // // grammar_fst = fst::CastOrConvertToVectorFst(compiled_fst->GetFst<StdArc>());
+        // // auto f = VectorFst<StdArc>(*compiled_fst->GetFst<StdArc>());
+        // grammar_fst = new VectorFst<StdArc>(*compiled_fst->GetFst<StdArc>());
+        // // grammar_fst = fst::Convert<StdArc>(compiled_fst->GetFst<StdArc>(), "vector");
+        // // grammar_fst = compiled_fst->GetFst<StdArc>();
+        // // auto compiled_vectorfst = fst::script::VectorFstClass(*compiled_fst);
+        // // grammar_fst = compiled_vectorfst.;
+      } else {
+        grammar_fst = fst::ReadFstKaldi(grammar_rxfilename);
+      }
+
+      if (arcsort_grammar) {
+        fst::ArcSort(grammar_fst, fst::ILabelCompare<StdArc>());
+      }
+
+      if (!grammar_prepend_nonterm_fst.empty()) {
+        VectorFst<StdArc> *nonterm_fst = fst::ReadFstKaldi(grammar_prepend_nonterm_fst);
+        fst::Concat(*nonterm_fst, grammar_fst);
+      }
+      if (!grammar_append_nonterm_fst.empty()) {
+        VectorFst<StdArc> *nonterm_fst = fst::ReadFstKaldi(grammar_append_nonterm_fst);
+        fst::Concat(grammar_fst, *nonterm_fst);
+      }
+      if (grammar_prepend_nonterm > 0) {
+        VectorFst<StdArc> nonterm_fst;
+        nonterm_fst.AddState();
+        nonterm_fst.SetStart(0);
+        nonterm_fst.AddState();
+        nonterm_fst.SetFinal(1, 0.0);
+        nonterm_fst.AddArc(0, StdArc(grammar_prepend_nonterm, 0, 0.0, 1));
+        fst::Concat(nonterm_fst, grammar_fst);
+      }
+      if (grammar_append_nonterm > 0) {
+        VectorFst<StdArc> nonterm_fst;
+        nonterm_fst.AddState();
+        nonterm_fst.SetStart(0);
+        nonterm_fst.AddState();
+        nonterm_fst.SetFinal(1, 0.0);
+        nonterm_fst.AddArc(0, StdArc(grammar_append_nonterm, 0, 0.0, 1));
+        fst::Concat(grammar_fst, nonterm_fst);
+      }
+
+      if (simplify_lg) {
+        // I think this should speed later stages
+        KALDI_VLOG(1) << "Determinizing G fst...";
+        VectorFst<StdArc> tmp_fst;
+        Determinize(*grammar_fst, &tmp_fst);
+        *grammar_fst = tmp_fst;
+      }
+    };
+
+    // G is typically the largest input, so with --parallel-prepare-g we read and
+    // prepare it while the main thread reads the tree, model and lexicon.
+    // (The future's destructor waits for the task, so an error on the main
+    // thread cannot leave it running.)
+    std::future<void> grammar_future;
+    if (parallel_prepare_g)
+      grammar_future = std::async(std::launch::async, prepare_grammar);
+
     ContextDependency ctx_dep;  // the tree.
     ReadKaldiObject(tree_rxfilename, &ctx_dep);
 
@@ -105,71 +212,11 @@ int main(int argc, char *argv[]) {
 
     VectorFst<StdArc> *lex_fst = fst::ReadFstKaldi(lex_rxfilename);
 
-    KALDI_VLOG(1) << "Preparing G...";
-
-    VectorFst<StdArc> *grammar_fst;
-    if (compile_grammar) {
-      KALDI_ERR << "compile-grammar not supported";
-      // kaldi::Input ki;
-      // ki.OpenTextMode(grammar_rxfilename);
-      // std::unique_ptr<const SymbolTable> isyms, osyms, ssyms;
-      // isyms.reset(SymbolTable::ReadText(grammar_symbols));
-      // if (!isyms) return 1;
-      // osyms.reset(SymbolTable::ReadText(grammar_symbols));
-      // if (!osyms) return 1;
-      // auto compiled_fst = fst::script::CompileFstInternal(
-      //     ki.Stream(), grammar_rxfilename, "vector", "standard", isyms.get(),
-      //     osyms.get(), ssyms.get(), false, false, false, false, false);
-      // // grammar_fst = fst::CastOrConvertToVectorFst(compiled_fst);
-      // // grammar_fst = fst::CastOrConvertToVectorFst(compiled_fst->GetFst<StdArc>());
-      // // auto f = VectorFst<StdArc>(*compiled_fst->GetFst<StdArc>());
-      // grammar_fst = new VectorFst<StdArc>(*compiled_fst->GetFst<StdArc>());
-      // // grammar_fst = fst::Convert<StdArc>(compiled_fst->GetFst<StdArc>(), "vector");
-      // // grammar_fst = compiled_fst->GetFst<StdArc>();
-      // // auto compiled_vectorfst = fst::script::VectorFstClass(*compiled_fst);
-      // // grammar_fst = compiled_vectorfst.;
-    } else {
-      grammar_fst = fst::ReadFstKaldi(grammar_rxfilename);
-    }
-
-    if (arcsort_grammar) {
-      fst::ArcSort(grammar_fst, fst::ILabelCompare<StdArc>());
-    }
-
-    if (!grammar_prepend_nonterm_fst.empty()) {
-      VectorFst<StdArc> *nonterm_fst = fst::ReadFstKaldi(grammar_prepend_nonterm_fst);
-      fst::Concat(*nonterm_fst, grammar_fst);
-    }
-    if (!grammar_append_nonterm_fst.empty()) {
-      VectorFst<StdArc> *nonterm_fst = fst::ReadFstKaldi(grammar_append_nonterm_fst);
-      fst::Concat(grammar_fst, *nonterm_fst);
-    }
-    if (grammar_prepend_nonterm > 0) {
-      VectorFst<StdArc> nonterm_fst;
-      nonterm_fst.AddState();
-      nonterm_fst.SetStart(0);
-      nonterm_fst.AddState();
-      nonterm_fst.SetFinal(1, 0.0);
-      nonterm_fst.AddArc(0, StdArc(grammar_prepend_nonterm, 0, 0.0, 1));
-      fst::Concat(nonterm_fst, grammar_fst);
-    }
-    if (grammar_append_nonterm > 0) {
-      VectorFst<StdArc> nonterm_fst;
-      nonterm_fst.AddState();
-      nonterm_fst.SetStart(0);
-      nonterm_fst.AddState();
-      nonterm_fst.SetFinal(1, 0.0);
-      nonterm_fst.AddArc(0, StdArc(grammar_append_nonterm, 0, 0.0, 1));
-      fst::Concat(grammar_fst, nonterm_fst);
-    }
-
-    if (simplify_lg) {
-      // I think this should speed later stages
-      KALDI_VLOG(1) << "Determinizing G fst...";
-      VectorFst<StdArc> tmp_fst;
-      Determinize(*grammar_fst, &tmp_fst);
-      *grammar_fst = tmp_fst;
-    }
+    if (grammar_future.valid())
+      grammar_future.get();  // rethrows any error from prepare_grammar().
+    else
+      prepare_grammar();
+    report_stage("reading inputs and preparing G");
 
     std::vector<int32> disambig_syms;
     if (disambig_rxfilename != "")
@@ -226,6 +273,7 @@ int main(int argc, char *argv[]) {
 
     delete grammar_fst;
     delete lex_fst;
+    report_stage("preparing LG");
 
     VectorFst<StdArc> clg_fst;
 
@@ -249,6 +297,7 @@ int main(int argc, char *argv[]) {
                                 lg_fst, &clg_fst, &ilabels);
     }
     lg_fst.DeleteStates();
+    report_stage("composing CLG");
 
     KALDI_VLOG(1) << "Constructing H fst...";
     HTransducerConfig h_cfg;
@@ -267,6 +316,7 @@ int main(int argc, char *argv[]) {
     TableCompose(*h_fst, clg_fst, &hclg_fst);
     clg_fst.DeleteStates();
     delete h_fst;
+    report_stage("composing HCLG");
 
     KALDI_ASSERT(hclg_fst.Start() != fst::kNoStateId);
 
@@ -281,6 +331,7 @@ int main(int argc, char *argv[]) {
 
     // Encoded minimization.
     MinimizeEncoded(&hclg_fst);
+    report_stage("determinizing and minimizing HCLG");
 
     std::vector<int32> disambig;
     bool check_no_self_loops = true,
@@ -304,7 +355,8 @@ int main(int argc, char *argv[]) {
     }
 
     KALDI_LOG << "Wrote graph with " << hclg_fst.NumStates()
-              << " states to " << hclg_wxfilename;
+              << " states to " << hclg_wxfilename << " in " << timer.Elapsed()
+              << " seconds, peak memory " << PeakMemoryMb() << " MB";
     return 0;
   } catch(const std::exception &e) {
     KALDI_ERR << "Exception in compile-graph-agf";
@@ -156,6 +156,24 @@ typename Arc::Weight ComposeDeterministicOnDemandFst<Arc>::Final(StateId s) {
   return Times(fst1_->Final(pr.first), fst2_->Final(pr.second));
 }
 
+template<class Arc>
+void ComposeDeterministicOnDemandFst<Arc>::PrefetchArcs(
+    StateId s, const std::vector<Label> &ilabels) {
+  KALDI_ASSERT(s < static_cast<StateId>(state_vec_.size()));
+  const std::pair<StateId, StateId> pr (state_vec_[s]);
+  fst1_->PrefetchArcs(pr.first, ilabels);
+  // fst2_ is queried with the output labels of fst1_'s arcs, not the input
+  // labels.  Arcs with no output label don't reach fst2_ at all.
+  std::vector<Label> olabels;
+  olabels.reserve(ilabels.size());
+  Arc arc1;
+  for (size_t i = 0; i < ilabels.size(); i++)
+    if (fst1_->GetArc(pr.first, ilabels[i], &arc1) && arc1.olabel != 0)
+      olabels.push_back(arc1.olabel);
+  if (!olabels.empty())
+    fst2_->PrefetchArcs(pr.second, olabels);
+}
+
 template<class Arc>
 bool ComposeDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
                                                   Arc *oarc) {
@@ -209,13 +227,14 @@ bool ComposeDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
 template<class Arc>
 inline size_t CacheDeterministicOnDemandFst<Arc>::GetIndex(
     StateId src_state, Label ilabel) {
-  const StateId p1 = 26597, p2 = 50329; // these are two
+  const size_t p1 = 26597, p2 = 50329; // these are two
   // values that I drew at random from a table of primes.
   // note: num_cached_arcs_ > 0.
 
-  // We cast to size_t before the modulus, to ensure the
-  // result is positive.
-  return static_cast<size_t>(src_state * p1 + ilabel * p2) %
+  // We cast to size_t before multiplying, to ensure the result is positive
+  // and to avoid signed overflow for large LM state ids.
+  return (static_cast<size_t>(src_state) * p1 +
+          static_cast<size_t>(ilabel) * p2) %
       static_cast<size_t>(num_cached_arcs_);
 }
 
@@ -255,6 +274,74 @@ bool CacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
   }
 }
 
+template<class Arc>
+inline size_t ConcurrentCacheDeterministicOnDemandFst<Arc>::GetIndex(
+    StateId src_state, Label ilabel) {
+  // Same as for CacheDeterministicOnDemandFst.
+  const size_t p1 = 26597, p2 = 50329;
+  return (static_cast<size_t>(src_state) * p1 +
+          static_cast<size_t>(ilabel) * p2) %
+      static_cast<size_t>(num_cached_arcs_);
+}
+
+template<class Arc>
+ConcurrentCacheDeterministicOnDemandFst<Arc>::
+ConcurrentCacheDeterministicOnDemandFst(DeterministicOnDemandFst<Arc> *fst,
+                                        StateId num_cached_arcs,
+                                        int32 num_locks):
+    fst_(fst), start_state_(fst->Start()), num_cached_arcs_(num_cached_arcs),
+    cached_arcs_(num_cached_arcs), cache_mutexes_(num_locks) {
+  KALDI_ASSERT(num_cached_arcs > 0 && num_locks > 0);
+  for (StateId i = 0; i < num_cached_arcs; i++)
+    cached_arcs_[i].first = kNoStateId; // Invalidate all elements of the cache.
+}
+
+template<class Arc>
+typename Arc::Weight ConcurrentCacheDeterministicOnDemandFst<Arc>::Final(
+    StateId s) {
+  std::lock_guard<std::mutex> lock(fst_mutex_);
+  return fst_->Final(s);
+}
+
+template<class Arc>
+bool ConcurrentCacheDeterministicOnDemandFst<Arc>::GetArc(StateId s,
+                                                          Label ilabel,
+                                                          Arc *oarc) {
+  // As in CacheDeterministicOnDemandFst, we don't cache the nonexistence of
+  // arcs.
+  KALDI_ASSERT(s >= 0 && ilabel != 0);
+  size_t index = this->GetIndex(s, ilabel);
+  std::mutex &cache_mutex = cache_mutexes_[index % cache_mutexes_.size()];
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (cached_arcs_[index].first == s &&
+        cached_arcs_[index].second.ilabel == ilabel) {
+      *oarc = cached_arcs_[index].second;
+      return true;
+    }
+  }
+  Arc arc;
+  {
+    std::lock_guard<std::mutex> lock(fst_mutex_);
+    if (!fst_->GetArc(s, ilabel, &arc))
+      return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cached_arcs_[index].first = s;
+    cached_arcs_[index].second = arc;
+  }
+  *oarc = arc;
+  return true;
+}
+
+template<class Arc>
+void ConcurrentCacheDeterministicOnDemandFst<Arc>::PrefetchArcs(
+    StateId s, const std::vector<Label> &ilabels) {
+  std::lock_guard<std::mutex> lock(fst_mutex_);
+  fst_->PrefetchArcs(s, ilabels);
+}
+
 template<class Arc>
 LmExampleDeterministicOnDemandFst<Arc>::LmExampleDeterministicOnDemandFst(
     void *lm, Label bos_symbol, Label eos_symbol):
@@ -22,6 +22,7 @@
 #include "util/kaldi-io.h"
 
 #include <sys/stat.h>
+#include <thread>
 
 namespace fst {
 using std::cout;
@@ -180,6 +181,44 @@ void TestBackoffAndCache() {
   delete rfst;
 }
 
+// Checks that ConcurrentCacheDeterministicOnDemandFst gives the same arcs as
+// the FST it wraps when several threads look them up at once, with a cache
+// small enough that they keep evicting each other's arcs.
+void TestConcurrentCache() {
+  StdVectorFst *nfst = CreateBackoffFst();
+  StdVectorFst *rfst = CreateResultFst();
+  ArcSort(nfst, StdILabelCompare());
+  BackoffDeterministicOnDemandFst<StdArc> dfst1a(*nfst);
+  ConcurrentCacheDeterministicOnDemandFst<StdArc> dfst1(&dfst1a, 3, 2);
+
+  auto check = [rfst, &dfst1] () {
+    for (int32 i = 0; i < 100; i++) {
+      for (StateIterator<StdVectorFst> riter(*rfst); !riter.Done();
+           riter.Next()) {
+        StateId rsrc = riter.Value();
+        KALDI_ASSERT(ApproxEqual(rfst->Final(rsrc), dfst1.Final(rsrc)));
+        for (ArcIterator<StdVectorFst> aiter(*rfst, rsrc); !aiter.Done();
+             aiter.Next()) {
+          const StdArc &rarc = aiter.Value();
+          StdArc darc;
+          KALDI_ASSERT(dfst1.GetArc(rsrc, rarc.ilabel, &darc));
+          KALDI_ASSERT(ApproxEqual(rarc.weight, darc.weight, 0.001) &&
+                       rarc.ilabel == darc.ilabel &&
+                       rarc.olabel == darc.olabel &&
+                       rarc.nextstate == darc.nextstate);
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < 4; t++)
+    threads.push_back(std::thread(check));
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  delete nfst;
+  delete rfst;
+}
+
 void TestCompose() {
   cout << "Test with single generated backoff FST" << endl;
   StdVectorFst *nfst = CreateBackoffFst();
@@ -227,6 +266,7 @@ void TestCompose() {
 int main() {
   using namespace fst;
   TestBackoffAndCache();
+  TestConcurrentCache();
   TestCompose();
 }
 
@@ -49,6 +49,7 @@
 */
 
 #include <algorithm>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -85,6 +86,12 @@ class DeterministicOnDemandFst {
   /// Note: ilabel must not be epsilon.
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc) = 0;
 
+  /// Optional hint that GetArc() is likely to be called from state s for the
+  /// given input labels, so that implementations which can evaluate many labels
+  /// more cheaply at once (e.g. neural language models) may do so now.  It
+  /// does not change the results of GetArc().  The default does nothing.
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels) { }
+
   virtual ~DeterministicOnDemandFst() { }
 };
 
@@ -155,6 +162,10 @@ class ScaleDeterministicOnDemandFst:  public DeterministicOnDemandFst<StdArc> {
     }
   }
 
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels) {
+    det_fst_.PrefetchArcs(s, ilabels);
+  }
+
  private:
   float scale_;
   DeterministicOnDemandFst<StdArc> &det_fst_;
@@ -215,6 +226,10 @@ class ComposeDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  /// Passes the hint on to both FSTs: to fst2_ with the output labels of the
+  /// matching arcs of fst1_, which it gets (and so expands) to find them.
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels);
+
  private:
   DeterministicOnDemandFst<Arc> *fst1_;
   DeterministicOnDemandFst<Arc> *fst2_;
@@ -244,6 +259,10 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels) {
+    fst_->PrefetchArcs(s, ilabels);
+  }
+
  private:
   // Get index for cached arc.
   inline size_t GetIndex(StateId src_state, Label ilabel);
@@ -254,6 +273,53 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 };
 
 
+/**
+   ConcurrentCacheDeterministicOnDemandFst is as CacheDeterministicOnDemandFst,
+   but it may be shared by several threads, e.g. by decoders that each apply
+   the same LM difference in their own thread (see LatticeBiglmFasterDecoder),
+   so that the arcs one of them has looked up are available to the others.
+   The cache has a fixed size; it is divided into "num_locks" stripes, each
+   guarded by its own mutex, so threads that hit the cache seldom wait for each
+   other.  The wrapped FST need not be thread-safe (typically it is not, e.g.
+   ComposeDeterministicOnDemandFst and ConstArpaLmDeterministicFst create
+   states as they go), since all calls to it are made while holding a
+   separate mutex; cache misses are therefore serialized.
+*/
+template<class Arc>
+class ConcurrentCacheDeterministicOnDemandFst:
+      public DeterministicOnDemandFst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of this pointer.  The argument is "really" const.
+  ConcurrentCacheDeterministicOnDemandFst(DeterministicOnDemandFst<Arc> *fst,
+                                          StateId num_cached_arcs = 1000000,
+                                          int32 num_locks = 64);
+
+  virtual StateId Start() { return start_state_; }
+
+  /// We don't bother caching the final-probs, just the arcs.
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels);
+
+ private:
+  inline size_t GetIndex(StateId src_state, Label ilabel);
+
+  DeterministicOnDemandFst<Arc> *fst_;
+  StateId start_state_;
+  StateId num_cached_arcs_;
+  std::vector<std::pair<StateId, Arc> > cached_arcs_;
+  std::vector<std::mutex> cache_mutexes_;  // cached_arcs_[i] is guarded by
+                                           // cache_mutexes_[i % num_locks].
+  std::mutex fst_mutex_;  // guards all calls to fst_.
+};
+
+
 /// This class is for didactic purposes, it does not really do anything.
 /// It shows how you would wrap a language model.  Note: you should probably
 /// have <s> and </s> not be real words in your LM, but <s> correspond somehow
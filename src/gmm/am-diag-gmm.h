@@ -72,6 +72,12 @@ class AmDiagGmm {
 
   BaseFloat LogLikelihood(const int32 pdf_index,
                           const VectorBase<BaseFloat> &data) const;
+
+  /// Outputs the log-likelihood of each row of "data" (a sequence of frames)
+  /// under pdf "pdf_index"; see DiagGmm::LogLikelihood(const MatrixBase&, ...).
+  void LogLikelihood(const int32 pdf_index,
+                     const MatrixBase<BaseFloat> &data,
+                     VectorBase<BaseFloat> *loglikes) const;
   
   void Read(std::istream &in_stream, bool binary);
   void Write(std::ostream &out_stream, bool binary) const;
@@ -110,6 +116,12 @@ inline BaseFloat AmDiagGmm::LogLikelihood(
   return densities_[pdf_index]->LogLikelihood(data);
 }
 
+inline void AmDiagGmm::LogLikelihood(
+    const int32 pdf_index, const MatrixBase<BaseFloat> &data,
+    VectorBase<BaseFloat> *loglikes) const {
+  densities_[pdf_index]->LogLikelihood(data, loglikes);
+}
+
 inline int32 AmDiagGmm::NumGaussInPdf(int32 pdf_index) const {
   KALDI_ASSERT((static_cast<size_t>(pdf_index) < densities_.size())
       && (densities_[pdf_index] != NULL));
@@ -18,6 +18,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 using std::vector;
 
@@ -80,5 +81,43 @@ void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   for (; it != end; ++it) { it->hit_time = -1; }
 }
 
+void DecodableAmDiagGmmScaled::InitBatch(int32 frames_per_batch) {
+  KALDI_ASSERT(frames_per_batch >= 1);
+  frames_per_batch_ = frames_per_batch;
+  batch_start_frame_ = -1;
+  batch_size_ = 0;
+  cur_batch_ = -1;
+  if (frames_per_batch_ > 1) {
+    pdf_batch_.resize(acoustic_model_.NumPdfs(), -1);
+    batch_loglikes_.Resize(acoustic_model_.NumPdfs(), frames_per_batch_,
+                           kUndefined);
+  }
+}
+
+BaseFloat DecodableAmDiagGmmScaled::BatchLogLikelihood(int32 frame,
+                                                       int32 pdf_id) {
+  KALDI_ASSERT(static_cast<size_t>(frame) <
+               static_cast<size_t>(NumFramesReady()));
+  KALDI_ASSERT(static_cast<size_t>(pdf_id) <
+               static_cast<size_t>(acoustic_model_.NumPdfs()) &&
+               "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
+  if (frame < batch_start_frame_ || frame >= batch_start_frame_ + batch_size_) {
+    // Start a new batch at this frame.
+    batch_start_frame_ = frame;
+    batch_size_ = std::min(frames_per_batch_, NumFramesReady() - frame);
+    cur_batch_++;
+  }
+  if (pdf_batch_[pdf_id] != cur_batch_) {
+    SubMatrix<BaseFloat> feats(feature_matrix_, batch_start_frame_,
+                               batch_size_, 0, feature_matrix_.NumCols());
+    SubVector<BaseFloat> loglikes(batch_loglikes_.Row(pdf_id), 0,
+                                  batch_size_);
+    acoustic_model_.LogLikelihood(pdf_id, feats, &loglikes);
+    loglikes.Scale(scale_);
+    pdf_batch_[pdf_id] = cur_batch_;
+  }
+  return batch_loglikes_(pdf_id, frame - batch_start_frame_);
+}
+
 
 }  // namespace kaldi
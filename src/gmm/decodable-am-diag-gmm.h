@@ -118,15 +118,23 @@ class DecodableAmDiagGmm: public DecodableAmDiagGmmUnmapped {
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmm);
 };
 
+/// DecodableAmDiagGmmScaled returns the log-likelihoods of DecodableAmDiagGmm
+/// multiplied by "scale" (the acoustic scale).  If frames_per_batch > 1, the
+/// first time a pdf is needed for a frame, its log-likelihood is computed for
+/// up to frames_per_batch consecutive frames at once using matrix-matrix
+/// products (see DiagGmm::LogLikelihood(const MatrixBase&, ...)); the pdfs
+/// active at one frame tend to remain active for the next few.  In that case
+/// log_sum_exp_prune is not applied.
 class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
  public:
   DecodableAmDiagGmmScaled(const AmDiagGmm &am,
                            const TransitionModel &tm,
                            const Matrix<BaseFloat> &feats,
                            BaseFloat scale,
-                           BaseFloat log_sum_exp_prune = -1.0):
+                           BaseFloat log_sum_exp_prune = -1.0,
+                           int32 frames_per_batch = 1):
       DecodableAmDiagGmmUnmapped(am, feats, log_sum_exp_prune), trans_model_(tm),
-      scale_(scale), delete_feats_(NULL) {}
+      scale_(scale), delete_feats_(NULL) { InitBatch(frames_per_batch); }
 
   // This version of the initializer takes ownership of the pointer
   // "feats" and will delete it when this class is destroyed.
@@ -134,14 +142,19 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
                            const TransitionModel &tm,
                            BaseFloat scale,
                            BaseFloat log_sum_exp_prune,
-                           Matrix<BaseFloat> *feats):
+                           Matrix<BaseFloat> *feats,
+                           int32 frames_per_batch = 1):
       DecodableAmDiagGmmUnmapped(am, *feats, log_sum_exp_prune),
-      trans_model_(tm),  scale_(scale), delete_feats_(feats) {}
+      trans_model_(tm),  scale_(scale), delete_feats_(feats) {
+    InitBatch(frames_per_batch);
+  }
 
   // Note, frames are numbered from zero but transition-ids from one.
   virtual BaseFloat LogLikelihood(int32 frame, int32 tid) {
-    return scale_*LogLikelihoodZeroBased(frame,
-                                         trans_model_.TransitionIdToPdf(tid));
+    int32 pdf_id = trans_model_.TransitionIdToPdf(tid);
+    if (frames_per_batch_ > 1)
+      return BatchLogLikelihood(frame, pdf_id);
+    return scale_*LogLikelihoodZeroBased(frame, pdf_id);
   }
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
@@ -152,10 +165,23 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
     delete delete_feats_;
   }
   
- private: // want to access it public to have pdf id information
+ private:
+  void InitBatch(int32 frames_per_batch);
+  BaseFloat BatchLogLikelihood(int32 frame, int32 pdf_id);
+
   const TransitionModel &trans_model_;  // for transition-id to pdf mapping
   BaseFloat scale_;
   Matrix<BaseFloat> *delete_feats_;
+
+  // Used if frames_per_batch_ > 1.  The current batch is the batch_size_
+  // frames starting at batch_start_frame_; row p of batch_loglikes_ holds the
+  // scaled log-likelihoods of pdf p for them, if pdf_batch_[p] == cur_batch_.
+  int32 frames_per_batch_;
+  int32 batch_start_frame_;
+  int32 batch_size_;
+  int32 cur_batch_;
+  std::vector<int32> pdf_batch_;
+  Matrix<BaseFloat> batch_loglikes_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmScaled);
 };
 
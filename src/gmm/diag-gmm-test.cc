@@ -83,6 +83,21 @@ void UnitTestDiagGmmGenerate() {
   // *necessarily* mean that something is wrong.
 }
 
+// Checks the batched (matrix) LogLikelihood against the per-frame one.
+void UnitTestDiagGmmLogLikelihoodBatch() {
+  DiagGmm gmm;
+  InitRandomGmm(&gmm);
+  int32 num_frames = 1 + Rand() % 10;
+  Matrix<BaseFloat> feats(num_frames, gmm.Dim());
+  feats.SetRandn();
+  Vector<BaseFloat> loglikes(num_frames);
+  gmm.LogLikelihood(feats, &loglikes);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> feat(feats, t);
+    AssertEqual(loglikes(t), gmm.LogLikelihood(feat), 0.001);
+  }
+}
+
 void UnitTestDiagGmm() {
   // random dimension of the gmm
   size_t dim = 1 + kaldi::RandInt(0, 5);
@@ -303,6 +318,7 @@ int main() {
   for (int i = 0; i < 2; i++) {
     kaldi::UnitTestDiagGmm();
     kaldi::UnitTestDiagGmmGenerate();
+    kaldi::UnitTestDiagGmmLogLikelihoodBatch();
   }
   std::cout << "Test OK.\n";
 }
@@ -525,6 +525,21 @@ BaseFloat DiagGmm::LogLikelihood(const VectorBase<BaseFloat> &data) const {
   return log_sum;
 }
 
+void DiagGmm::LogLikelihood(const MatrixBase<BaseFloat> &data,
+                            VectorBase<BaseFloat> *loglikes) const {
+  if (!valid_gconsts_)
+    KALDI_ERR << "Must call ComputeGconsts() before computing likelihood";
+  KALDI_ASSERT(loglikes->Dim() == data.NumRows());
+  Matrix<BaseFloat> component_loglikes;
+  LogLikelihoods(data, &component_loglikes);
+  for (int32 r = 0; r < data.NumRows(); r++) {
+    BaseFloat log_sum = component_loglikes.Row(r).LogSumExp();
+    if (KALDI_ISNAN(log_sum) || KALDI_ISINF(log_sum))
+      KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+    (*loglikes)(r) = log_sum;
+  }
+}
+
 void DiagGmm::LogLikelihoods(const VectorBase<BaseFloat> &data,
                              Vector<BaseFloat> *loglikes) const {
   loglikes->Resize(gconsts_.Dim(), kUndefined);
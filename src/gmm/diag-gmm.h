@@ -81,6 +81,12 @@ class DiagGmm {
   /// Returns the log-likelihood of a data point (vector) given the GMM
   BaseFloat LogLikelihood(const VectorBase<BaseFloat> &data) const;
 
+  /// Outputs the log-likelihood given the GMM of each row of "data" (a
+  /// sequence of frames), evaluating all of them with matrix-matrix products.
+  /// "loglikes" must have dimension data.NumRows().
+  void LogLikelihood(const MatrixBase<BaseFloat> &data,
+                     VectorBase<BaseFloat> *loglikes) const;
+
   /// Outputs the per-component log-likelihoods
   void LogLikelihoods(const VectorBase<BaseFloat> &data,
                       Vector<BaseFloat> *loglikes) const;
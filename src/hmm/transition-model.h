@@ -161,6 +161,12 @@ class TransitionModel {
   // (unless we're in paranoid mode).
   inline int32 TransitionIdToPdfFast(int32 trans_id) const;
 
+  /// Returns the pdf of each transition-id, indexed by transition-id (element
+  /// zero is unused).  For code that needs to map many transition-ids at once.
+  const std::vector<int32> &TransitionIdToPdfArray() const {
+    return id2pdf_id_;
+  }
+
   int32 TransitionIdToPhone(int32 trans_id) const;
   int32 TransitionIdToPdfClass(int32 trans_id) const;
   int32 TransitionIdToHmmState(int32 trans_id) const;
@@ -114,6 +114,21 @@ class DecodableInterface {
   /// this is for compatibility with OpenFst).
   virtual int32 NumIndices() const = 0;
 
+  /// Outputs the log-likelihoods of all indices on this frame, as
+  /// (*loglikes)[index] for index = 1 ... NumIndices(); (*loglikes)[0] is
+  /// unused.  Decoders can use this to replace a LogLikelihood() call per arc
+  /// with a table lookup.  The default implementation calls LogLikelihood()
+  /// for each index; decodable objects that can do this more cheaply, e.g. by
+  /// gathering from a row of per-pdf scores, override it.
+  virtual void GetFrameLogLikelihoods(int32 frame,
+                                      std::vector<BaseFloat> *loglikes) {
+    int32 num_indices = NumIndices();
+    loglikes->resize(num_indices + 1);
+    (*loglikes)[0] = 0.0;
+    for (int32 i = 1; i <= num_indices; i++)
+      (*loglikes)[i] = LogLikelihood(frame, i);
+  }
+
   virtual ~DecodableInterface() {}
 };
 /// @}
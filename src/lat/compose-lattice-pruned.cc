@@ -679,6 +679,19 @@ void PrunedCompactLatticeComposer::ProcessQueueElement(
   // lattice state; plus one if there is a final-prob.
   KALDI_ASSERT(sorted_arc_index >= 0);
 
+  if (sorted_arc_index == 0 && num_sorted_arcs > 1) {
+    // This is the first time we expand this composed state, so let det_fst_
+    // evaluate all the words we might need from its LM state at once (this
+    // matters for neural LMs, for which that is one matrix operation).
+    std::vector<int32> olabels;
+    olabels.reserve(num_sorted_arcs);
+    for (fst::ArcIterator<CompactLattice> aiter(clat_in_, lat_state);
+         !aiter.Done(); aiter.Next())
+      if (aiter.Value().olabel != 0)
+        olabels.push_back(aiter.Value().olabel);
+    det_fst_->PrefetchArcs(src_composed_state_info.lm_state, olabels);
+  }
+
   { // this block update the state's 'sorted_arc_index', 'arc_delta_cost' and
     // 'expected_cost_offset' to reflect the fact that (by the time we exit from
     // this function) we will have processed this arc (or the final-prob);
@@ -0,0 +1,129 @@
+// nnet3/decodable-online-looped-test.cc
+
+// Copyright 2020  David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/decodable-online-looped.h"
+#include "hmm/hmm-test-utils.h"
+#include "base/timer.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Features from a matrix, all of which are ready at the start.  (Like
+// OnlineMatrixFeature, which is in ../feat, which we don't link against.)
+class TestMatrixFeature: public OnlineFeatureInterface {
+ public:
+  explicit TestMatrixFeature(const MatrixBase<BaseFloat> &mat): mat_(mat) { }
+  virtual int32 Dim() const { return mat_.NumCols(); }
+  virtual int32 NumFramesReady() const { return mat_.NumRows(); }
+  virtual bool IsLastFrame(int32 frame) const {
+    return frame == mat_.NumRows() - 1;
+  }
+  virtual BaseFloat FrameShiftInSeconds() const { return 0.01; }
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+    feat->CopyFromVec(mat_.Row(frame));
+  }
+ private:
+  const MatrixBase<BaseFloat> &mat_;
+};
+
+// Checks that GetFrameLogLikelihoods() agrees with LogLikelihood(), for
+// DecodableAmNnetLoopedOnline and DecodableNnetLoopedOnline, and compares the
+// time taken to score a decoder's worth of arcs per frame by calling
+// LogLikelihood() for each of them with that of looking them up in the table
+// from GetFrameLogLikelihoods().
+void UnitTestDecodableOnlineLoopedFrameLogLikelihoods() {
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  int32 num_pdfs = trans_model->NumPdfs(),
+      num_tids = trans_model->NumTransitionIds(),
+      input_dim = RandInt(10, 40),
+      num_frames = RandInt(20, 100),
+      num_arcs_per_frame = 20000;
+
+  std::ostringstream os;
+  os << "component name=affine1 type=AffineComponent input-dim="
+     << input_dim << " output-dim=" << num_pdfs << std::endl;
+  os << "input-node name=input dim=" << input_dim << std::endl;
+  os << "component-node name=affine1_node component=affine1 input=input\n";
+  os << "output-node name=output input=affine1_node\n";
+  Nnet nnet;
+  std::istringstream is(os.str());
+  nnet.ReadConfig(is);
+
+  NnetSimpleLoopedComputationOptions opts;
+  DecodableNnetSimpleLoopedInfo info(opts, &nnet);
+  Matrix<BaseFloat> feats(num_frames, input_dim);
+  feats.SetRandn();
+  TestMatrixFeature features(feats);
+
+  // The "arcs" of each frame.
+  std::vector<int32> ilabels(num_arcs_per_frame);
+  for (int32 i = 0; i < num_arcs_per_frame; i++)
+    ilabels[i] = RandInt(1, num_tids);
+
+  DecodableAmNnetLoopedOnline decodable(*trans_model, info, &features, NULL);
+  double per_arc_time = 0.0, table_time = 0.0;
+  BaseFloat per_arc_sum = 0.0, table_sum = 0.0;
+  std::vector<BaseFloat> loglikes;
+  for (int32 t = 0; t < num_frames; t++) {
+    decodable.LogLikelihood(t, 1);  // so the timings exclude the nnet.
+    Timer per_arc_timer;
+    for (int32 i = 0; i < num_arcs_per_frame; i++)
+      per_arc_sum += decodable.LogLikelihood(t, ilabels[i]);
+    per_arc_time += per_arc_timer.Elapsed();
+
+    Timer table_timer;
+    decodable.GetFrameLogLikelihoods(t, &loglikes);
+    for (int32 i = 0; i < num_arcs_per_frame; i++)
+      table_sum += loglikes[ilabels[i]];
+    table_time += table_timer.Elapsed();
+
+    KALDI_ASSERT(static_cast<int32>(loglikes.size()) == num_tids + 1);
+    for (int32 tid = 1; tid <= num_tids; tid++)
+      KALDI_ASSERT(loglikes[tid] == decodable.LogLikelihood(t, tid));
+  }
+  KALDI_ASSERT(per_arc_sum == table_sum);
+  KALDI_LOG << "For " << num_arcs_per_frame << " arcs per frame and "
+            << num_tids << " transition-ids, per-arc LogLikelihood() took "
+            << per_arc_time << "s, GetFrameLogLikelihoods() and lookups took "
+            << table_time << "s.";
+
+  DecodableNnetLoopedOnline pdf_decodable(info, &features, NULL);
+  for (int32 t = 0; t < num_frames; t++) {
+    pdf_decodable.GetFrameLogLikelihoods(t, &loglikes);
+    KALDI_ASSERT(static_cast<int32>(loglikes.size()) == num_pdfs + 1);
+    for (int32 index = 1; index <= num_pdfs; index++)
+      KALDI_ASSERT(loglikes[index] == pdf_decodable.LogLikelihood(t, index));
+  }
+
+  delete trans_model;
+  delete ctx_dep;
+}
+
+}  // namespace nnet3
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (int32 i = 0; i < 3; i++)
+    UnitTestDecodableOnlineLoopedFrameLogLikelihoods();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -246,6 +246,18 @@ BaseFloat DecodableNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
 }
 
 
+void DecodableNnetLoopedOnline::GetFrameLogLikelihoods(
+    int32 subsampled_frame, std::vector<BaseFloat> *loglikes) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  SubVector<BaseFloat> log_post(current_log_post_,
+      subsampled_frame - current_log_post_subsampled_offset_);
+  loglikes->resize(log_post.Dim() + 1);
+  (*loglikes)[0] = 0.0;
+  std::copy(log_post.Data(), log_post.Data() + log_post.Dim(),
+            loglikes->begin() + 1);
+}
+
 BaseFloat DecodableAmNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
                                                     int32 index) {
   subsampled_frame += frame_offset_;
@@ -255,6 +267,20 @@ BaseFloat DecodableAmNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
       trans_model_.TransitionIdToPdfFast(index));
 }
 
+void DecodableAmNnetLoopedOnline::GetFrameLogLikelihoods(
+    int32 subsampled_frame, std::vector<BaseFloat> *loglikes) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  const BaseFloat *log_post = current_log_post_.RowData(
+      subsampled_frame - current_log_post_subsampled_offset_);
+  const std::vector<int32> &id2pdf = trans_model_.TransitionIdToPdfArray();
+  int32 num_indices = trans_model_.NumTransitionIds();
+  loglikes->resize(num_indices + 1);
+  (*loglikes)[0] = 0.0;
+  for (int32 i = 1; i <= num_indices; i++)
+    (*loglikes)[i] = log_post[id2pdf[i]];
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
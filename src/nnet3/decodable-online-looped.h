@@ -158,7 +158,6 @@ class DecodableNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
       OnlineFeatureInterface *ivector_features):
       DecodableNnetLoopedOnlineBase(info, input_features, ivector_features) { }
 
-
   // returns the output-dim of the neural net.
   virtual int32 NumIndices() const { return info_.output_dim; }
 
@@ -167,6 +166,10 @@ class DecodableNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
   // represents the pdf-id (or other output of the network) PLUS ONE.
   virtual BaseFloat LogLikelihood(int32 subsampled_frame, int32 index);
 
+  // Copies the row of network outputs, shifted by one.
+  virtual void GetFrameLogLikelihoods(int32 subsampled_frame,
+                                      std::vector<BaseFloat> *loglikes);
+
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnetLoopedOnline);
 
@@ -199,6 +202,10 @@ class DecodableAmNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
   virtual BaseFloat LogLikelihood(int32 subsampled_frame,
                                   int32 transition_id);
 
+  // Gathers the scores of all transition-ids from the row of per-pdf scores.
+  virtual void GetFrameLogLikelihoods(int32 subsampled_frame,
+                                      std::vector<BaseFloat> *loglikes);
+
  private:
   const TransitionModel &trans_model_;
 
@@ -275,6 +275,8 @@ class SingleUtteranceGmmDecoder {
   /// can be taken as a good sign that the input was OK.
   BaseFloat FinalRelativeCost() { return decoder_.FinalRelativeCost(); }
 
+  int32 NumFramesDecoded() const { return decoder_.NumFramesDecoded(); }
+
 
   /// This function calls EndpointDetected from online-endpoint.h,
   /// with the required arguments.
@@ -501,8 +501,14 @@ void OnlineSilenceWeighting::ComputeCurrentTraceback(
   while (frame >= 0) {
     LatticeArc arc;
     arc.ilabel = 0;
-    while (arc.ilabel == 0)  // the while loop skips over input-epsilons
+    while (arc.ilabel == 0 && !iter.Done())  // skips over input-epsilons
       iter = decoder.TraceBackBestPath(iter, &arc);
+    if (arc.ilabel == 0) {
+      // The traceback stopped at the start of the decoder's current lattice
+      // segment (see LatticeFasterOnlineDecoderTpl::EmitLatticeSegment()); the
+      // best path before it can no longer change.
+      break;
+    }
     // note, the iter.frame values are slightly unintuitively defined,
     // they are one less than you might expect.
     KALDI_ASSERT(iter.frame == frame - 1);
@@ -78,6 +78,18 @@ void SingleUtteranceNnet3DecoderTpl<FST>::GetLattice(bool end_of_utterance,
       trans_model_, &raw_lat, lat_beam, clat, decoder_opts_.det_opts);
 }
 
+template <typename FST>
+bool SingleUtteranceNnet3DecoderTpl<FST>::EmitLatticeSegment(
+    int32 min_segment_frames, CompactLattice *clat) {
+  Lattice raw_lat;
+  if (!decoder_.EmitLatticeSegment(min_segment_frames, &raw_lat))
+    return false;
+  DeterminizeLatticePhonePrunedWrapper(
+      trans_model_, &raw_lat, decoder_opts_.lattice_beam, clat,
+      decoder_opts_.det_opts);
+  return true;
+}
+
 template <typename FST>
 void SingleUtteranceNnet3DecoderTpl<FST>::GetBestPath(bool end_of_utterance,
                                               Lattice *best_path) const {
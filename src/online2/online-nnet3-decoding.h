@@ -91,6 +91,16 @@ class SingleUtteranceNnet3DecoderTpl {
   void GetBestPath(bool end_of_utterance,
                    Lattice *best_path) const;
 
+  /// For decoding long streams in bounded memory.  If the decoder can emit the
+  /// lattice of the frames up to some point at least "min_segment_frames"
+  /// frames after the previous one (see
+  /// LatticeFasterOnlineDecoderTpl::EmitLatticeSegment()), outputs it
+  /// determinized to "clat", as GetLattice() does, and returns true; the
+  /// decoder then frees those frames.  GetLattice() afterwards only covers the
+  /// frames after the last segment; concatenate the segments and that lattice
+  /// to get the whole lattice.
+  bool EmitLatticeSegment(int32 min_segment_frames, CompactLattice *clat);
+
 
   /// This function calls EndpointDetected from online-endpoint.h,
   /// with the required arguments.
@@ -99,6 +99,15 @@ class SingleUtteranceNnet3IncrementalDecoderTpl {
     return decoder_.GetLattice(num_frames_to_include, use_final_probs);
   }
 
+  /// Outputs the parts of the lattice that have been frozen since the last
+  /// call (only if decoder_opts.determinize_horizon > 0), so that GetLattice()
+  /// no longer includes them; see
+  /// LatticeIncrementalDecoderTpl::TakeFrozenLattices().  Like the output of
+  /// GetLattice(), they have any acoustic scaling in them.
+  void TakeFrozenLattices(std::vector<CompactLattice> *lats) {
+    decoder_.TakeFrozenLattices(lats);
+  }
+
 
 
 
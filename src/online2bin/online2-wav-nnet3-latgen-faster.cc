@@ -108,6 +108,7 @@ int main(int argc, char *argv[]) {
     BaseFloat chunk_length_secs = 0.18;
     bool do_endpointing = false;
     bool online = true;
+    int32 lattice_segment_frames = 0;
 
     po.Register("chunk-length", &chunk_length_secs,
                 "Length of chunk size in seconds, that we process.  Set to <= 0 "
@@ -125,6 +126,12 @@ int main(int argc, char *argv[]) {
                 "--use-most-recent-ivector=true and --greedy-ivector-extractor=true "
                 "in the file given to --ivector-extraction-config, and "
                 "--chunk-length=-1.");
+    po.Register("lattice-segment-frames", &lattice_segment_frames,
+                "If >0, for long recordings: whenever all the paths the decoder "
+                "keeps agree on a point at least this many (output) frames "
+                "after the previous one, determinize the lattice up to there "
+                "and free the decoder's memory for it.  The pieces are "
+                "concatenated to give the lattice that is written.");
     po.Register("num-threads-startup", &g_num_threads,
                 "Number of threads used when initializing iVector extractor.");
 
@@ -241,6 +248,8 @@ int main(int argc, char *argv[]) {
 
         int32 samp_offset = 0;
         std::vector<std::pair<int32, BaseFloat> > delta_weights;
+        // The lattice segments emitted so far, concatenated.
+        CompactLattice segments_clat;
 
         while (samp_offset < data.Dim()) {
           int32 samp_remaining = data.Dim() - samp_offset;
@@ -267,6 +276,16 @@ int main(int argc, char *argv[]) {
 
           decoder.AdvanceDecoding();
 
+          CompactLattice segment_clat;
+          if (lattice_segment_frames > 0 &&
+              decoder.EmitLatticeSegment(lattice_segment_frames,
+                                         &segment_clat)) {
+            if (segments_clat.Start() == fst::kNoStateId)
+              segments_clat = segment_clat;
+            else
+              Concat(&segments_clat, segment_clat);
+          }
+
           if (do_endpointing && decoder.EndpointDetected(endpoint_opts)) {
             break;
           }
@@ -276,6 +295,10 @@ int main(int argc, char *argv[]) {
         CompactLattice clat;
         bool end_of_utterance = true;
         decoder.GetLattice(end_of_utterance, &clat);
+        if (segments_clat.Start() != fst::kNoStateId) {
+          Concat(&segments_clat, clat);
+          clat = segments_clat;
+        }
 
         GetDiagnosticsAndPrintOutput(utt, word_syms, clat,
                                      &num_frames, &tot_like);
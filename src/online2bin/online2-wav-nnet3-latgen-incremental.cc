@@ -72,6 +72,43 @@ void GetDiagnosticsAndPrintOutput(const std::string &utt,
   }
 }
 
+// Prints the diagnostics for `clat` and writes it with un-scaled acoustics.
+void OutputLattice(const std::string &key,
+                   const fst::SymbolTable *word_syms,
+                   BaseFloat acoustic_scale,
+                   CompactLattice *clat,
+                   CompactLatticeWriter *clat_writer,
+                   int64 *tot_num_frames,
+                   double *tot_like) {
+  Connect(clat);
+  GetDiagnosticsAndPrintOutput(key, word_syms, *clat,
+                               tot_num_frames, tot_like);
+  // we want to output the lattice with un-scaled acoustics.
+  BaseFloat inv_acoustic_scale = 1.0 / acoustic_scale;
+  ScaleLattice(AcousticLatticeScale(inv_acoustic_scale), clat);
+  clat_writer->Write(key, *clat);
+}
+
+// Outputs the lattices in `segments` as the next segments of utterance `utt`,
+// with keys <utt>-1, <utt>-2 and so on; `num_segments` is the number output so
+// far.
+void OutputLatticeSegments(const std::string &utt,
+                           const fst::SymbolTable *word_syms,
+                           BaseFloat acoustic_scale,
+                           std::vector<CompactLattice> *segments,
+                           CompactLatticeWriter *clat_writer,
+                           int32 *num_segments,
+                           int64 *tot_num_frames,
+                           double *tot_like) {
+  for (size_t i = 0; i < segments->size(); i++) {
+    std::ostringstream key;
+    key << utt << '-' << ++(*num_segments);
+    OutputLattice(key.str(), word_syms, acoustic_scale, &((*segments)[i]),
+                  clat_writer, tot_num_frames, tot_like);
+  }
+  segments->clear();
+}
+
 }
 
 int main(int argc, char *argv[]) {
@@ -109,6 +146,7 @@ int main(int argc, char *argv[]) {
     BaseFloat chunk_length_secs = 0.18;
     bool do_endpointing = false;
     bool online = true;
+    bool write_segments = false;
 
     po.Register("chunk-length", &chunk_length_secs,
                 "Length of chunk size in seconds, that we process.  Set to <= 0 "
@@ -126,6 +164,14 @@ int main(int argc, char *argv[]) {
                 "--use-most-recent-ivector=true and --greedy-ivector-extractor=true "
                 "in the file given to --ivector-extraction-config, and "
                 "--chunk-length=-1.");
+    po.Register("write-segments", &write_segments,
+                "If true, and --determinize-horizon > 0, write out the parts of "
+                "the lattice of each utterance as they are frozen during "
+                "decoding, with keys <utterance-id>-1, <utterance-id>-2 and so "
+                "on, instead of the whole lattice at the end.  This keeps the "
+                "memory used bounded for long utterances.  Each segment starts "
+                "at the final state of the previous one, and any best path "
+                "goes through it.");
     po.Register("num-threads-startup", &g_num_threads,
                 "Number of threads used when initializing iVector extractor.");
 
@@ -234,6 +280,8 @@ int main(int argc, char *argv[]) {
 
         int32 samp_offset = 0;
         std::vector<std::pair<int32, BaseFloat> > delta_weights;
+        std::vector<CompactLattice> segments;
+        int32 num_segments = 0;
 
         while (samp_offset < data.Dim()) {
           int32 samp_remaining = data.Dim() - samp_offset;
@@ -259,6 +307,12 @@ int main(int argc, char *argv[]) {
           }
 
           decoder.AdvanceDecoding();
+          if (write_segments) {
+            decoder.TakeFrozenLattices(&segments);
+            OutputLatticeSegments(utt, word_syms, decodable_opts.acoustic_scale,
+                                  &segments, &clat_writer, &num_segments,
+                                  &num_frames, &tot_like);
+          }
 
           if (do_endpointing && decoder.EndpointDetected(endpoint_opts)) {
             break;
@@ -269,10 +323,17 @@ int main(int argc, char *argv[]) {
         bool use_final_probs = true;
         CompactLattice clat = decoder.GetLattice(decoder.NumFramesDecoded(),
                                                  use_final_probs);
-
-        Connect(&clat);
-        GetDiagnosticsAndPrintOutput(utt, word_syms, clat,
-                                     &num_frames, &tot_like);
+        if (write_segments) {
+          // All the segments frozen before this were taken above, so this is
+          // the rest of the lattice.
+          segments.push_back(clat);
+          OutputLatticeSegments(utt, word_syms, decodable_opts.acoustic_scale,
+                                &segments, &clat_writer, &num_segments,
+                                &num_frames, &tot_like);
+        } else {
+          OutputLattice(utt, word_syms, decodable_opts.acoustic_scale, &clat,
+                        &clat_writer, &num_frames, &tot_like);
+        }
 
         decoding_timer.OutputStats(&timing_stats);
 
@@ -280,12 +341,6 @@ int main(int argc, char *argv[]) {
         // you felt the utterance had low confidence.  See lat/confidence.h
         feature_pipeline.GetAdaptationState(&adaptation_state);
 
-        // we want to output the lattice with un-scaled acoustics.
-        BaseFloat inv_acoustic_scale =
-            1.0 / decodable_opts.acoustic_scale;
-        ScaleLattice(AcousticLatticeScale(inv_acoustic_scale), &clat);
-
-        clat_writer.Write(utt, clat);
         KALDI_LOG << "Decoded utterance " << utt;
         num_done++;
       }
@@ -142,6 +142,31 @@ void RnnlmComputeState::GetLogProbOfWords(CuMatrixBase<BaseFloat> *output) const
   output->ColRange(0, 1).Set(-99.0);
 }
 
+void RnnlmComputeState::GetLogProbOfWords(
+    const std::vector<int32> &word_indexes,
+    std::vector<BaseFloat> *log_probs) const {
+  const CuMatrix<BaseFloat> &word_embedding_mat = info_.word_embedding_mat;
+  int32 num_words = word_indexes.size();
+  log_probs->resize(num_words);
+  if (num_words == 0) return;
+
+  CuArray<int32> indexes(word_indexes);
+  CuMatrix<BaseFloat> word_embeddings(num_words, word_embedding_mat.NumCols(),
+                                      kUndefined);
+  word_embeddings.CopyRows(word_embedding_mat, indexes);
+  CuVector<BaseFloat> cu_log_probs(num_words, kUndefined);
+  cu_log_probs.AddMatVec(1.0, word_embeddings, kNoTrans,
+                         predicted_word_embedding_->Row(0), 0.0);
+
+  // See LogProbOfWord() regarding normalization.
+  if (info_.opts.normalize_probs) {
+    cu_log_probs.Add(-normalization_factor_);
+  }
+  Vector<BaseFloat> cpu_log_probs(cu_log_probs);
+  for (int32 i = 0; i < num_words; i++)
+    (*log_probs)[i] = cpu_log_probs(i);
+}
+
 void RnnlmComputeState::AdvanceChunk() {
   CuMatrix<BaseFloat> input_embeddings(1, info_.word_embedding_mat.NumCols());
   input_embeddings.Row(0).AddVec(1.0,
@@ -123,6 +123,12 @@ class RnnlmComputeState {
   // used in any computation by the caller. To avoid causing unexpected issues,
   // we here set it to a very small number
   void GetLogProbOfWords(CuMatrixBase<BaseFloat>* output) const;
+
+  /// Outputs to "log_probs" the log-probs of each of the given words (the same
+  /// values LogProbOfWord() would give), computed together as a single
+  /// matrix-vector product over just those words' embeddings.
+  void GetLogProbOfWords(const std::vector<int32> &word_indexes,
+                         std::vector<BaseFloat> *log_probs) const;
   /// Advance the state of the RNNLM by appending this word to the word sequence.
   void AddWord(int32 word_index);
  private:
@@ -28,12 +28,54 @@
 namespace kaldi {
 namespace rnnlm {
 
-KaldiRnnlmDeterministicFst::~KaldiRnnlmDeterministicFst() {
-  int32 size = state_to_rnnlm_state_.size();
-  for (int32 i = 0; i < size; i++)
-    delete state_to_rnnlm_state_[i];
+RnnlmComputeStateCache::RnnlmComputeStateCache(
+    const RnnlmComputeStateInfo &info, int32 max_num_states):
+    info_(info),
+    root_state_(new RnnlmComputeState(info, info.opts.bos_index)),
+    max_num_states_(max_num_states), next_node_(1),
+    num_hits_(0), num_misses_(0) {
+  KALDI_ASSERT(max_num_states > 0);
+}
+
+std::shared_ptr<const RnnlmComputeState> RnnlmComputeStateCache::GetSuccessor(
+    NodeId node, const RnnlmComputeState &state, int32 word,
+    NodeId *successor) {
+  Key key(node, word);
+  auto iter = map_.find(key);
+  if (iter != map_.end()) {
+    num_hits_++;
+    Entry &entry = iter->second;
+    lru_.splice(lru_.begin(), lru_, entry.lru_iter);
+    *successor = entry.node;
+    return entry.state;
+  }
+
+  num_misses_++;
+  if (static_cast<int32>(map_.size()) >= max_num_states_) {
+    // Evict the least recently used state.  Its descendants become
+    // unreachable, and will be evicted in turn as they age.
+    map_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(key);
+  Entry &entry = map_[key];
+  entry.node = next_node_++;
+  entry.state.reset(state.GetSuccessorState(word));
+  entry.lru_iter = lru_.begin();
+  *successor = entry.node;
+  return entry.state;
+}
+
+void RnnlmComputeStateCache::Clear() {
+  map_.clear();
+  lru_.clear();
+}
 
+KaldiRnnlmDeterministicFst::~KaldiRnnlmDeterministicFst() {
   state_to_rnnlm_state_.resize(0);
+  state_to_cache_node_.resize(0);
+  state_to_pending_successor_.resize(0);
+  prefetched_log_probs_.clear();
   state_to_wseq_.resize(0);
   wseq_to_state_.clear();
 }
@@ -41,23 +83,26 @@ KaldiRnnlmDeterministicFst::~KaldiRnnlmDeterministicFst() {
 void KaldiRnnlmDeterministicFst::Clear() {
   // This function is similar to the destructor but we retain the 0-th entries
   // in each map which corresponds to the <bos> state.
-  int32 size = state_to_rnnlm_state_.size();
-  for (int32 i = 1; i < size; i++)
-    delete state_to_rnnlm_state_[i];
-
   state_to_rnnlm_state_.resize(1);
+  state_to_pending_successor_.resize(1);
+  prefetched_log_probs_.clear();
   state_to_wseq_.resize(1);
   wseq_to_state_.clear();
   wseq_to_state_[state_to_wseq_[0]] = 0;
 
   // Reset priming
-  delete state_to_rnnlm_state_[0];
-  state_to_rnnlm_state_[0] = new RnnlmComputeState(info_, bos_index_);
+  if (cache_ != NULL) {
+    state_to_rnnlm_state_[0] = cache_->RootState();
+    state_to_cache_node_.resize(1);
+    state_to_cache_node_[0] = cache_->Root();
+  } else {
+    state_to_rnnlm_state_[0].reset(new RnnlmComputeState(info_, bos_index_));
+  }
 }
 
 KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
       const RnnlmComputeStateInfo &info):
-    max_ngram_order_(max_ngram_order), info_(info) {
+    max_ngram_order_(max_ngram_order), info_(info), cache_(NULL) {
   bos_index_ = info.opts.bos_index;
   eos_index_ = info.opts.eos_index;
 
@@ -68,7 +113,25 @@ KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
   wseq_to_state_[bos_seq] = 0;
   start_state_ = 0;
 
-  state_to_rnnlm_state_.push_back(decodable_rnnlm);
+  state_to_rnnlm_state_.emplace_back(decodable_rnnlm);
+  state_to_pending_successor_.emplace_back(-1, 0);
+}
+
+KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
+      RnnlmComputeStateCache *cache):
+    max_ngram_order_(max_ngram_order), info_(cache->Info()), cache_(cache) {
+  bos_index_ = info_.opts.bos_index;
+  eos_index_ = info_.opts.eos_index;
+
+  std::vector<Label> bos_seq;
+  bos_seq.push_back(bos_index_);
+  state_to_wseq_.push_back(bos_seq);
+  wseq_to_state_[bos_seq] = 0;
+  start_state_ = 0;
+
+  state_to_rnnlm_state_.push_back(cache_->RootState());
+  state_to_cache_node_.push_back(cache_->Root());
+  state_to_pending_successor_.emplace_back(-1, 0);
 }
 
 void KaldiRnnlmDeterministicFst::Prime(const std::vector<Label> &words) {
@@ -77,29 +140,86 @@ void KaldiRnnlmDeterministicFst::Prime(const std::vector<Label> &words) {
   if (wseq_to_state_.size() != 1) KALDI_ERR << "RNNLM not fresh, so can't prime.";
   std::vector<Label> bos_seq({bos_index_});
   if (wseq_to_state_[bos_seq] != 0) KALDI_ERR << "RNNLM not fresh, so can't prime.";
-  auto rnnlm = state_to_rnnlm_state_[0];
-  for (auto word : words) {
-    rnnlm->AddWord(word);
+  if (cache_ != NULL) {
+    // Walk the cache from the root, so only words beyond the longest cached
+    // prefix of the priming text need to be computed.
+    std::shared_ptr<const RnnlmComputeState> rnnlm = cache_->RootState();
+    RnnlmComputeStateCache::NodeId node = cache_->Root();
+    for (auto word : words)
+      rnnlm = cache_->GetSuccessor(node, *rnnlm, word, &node);
+    state_to_rnnlm_state_[0] = rnnlm;
+    state_to_cache_node_[0] = node;
+  } else {
+    RnnlmComputeState *rnnlm = new RnnlmComputeState(*state_to_rnnlm_state_[0]);
+    for (auto word : words) {
+      rnnlm->AddWord(word);
+    }
+    state_to_rnnlm_state_[0].reset(rnnlm);
+  }
+}
+
+const RnnlmComputeState* KaldiRnnlmDeterministicFst::GetRnnlmState(
+    StateId s) {
+  if (state_to_rnnlm_state_[s] == NULL) {
+    // Compute it from its predecessor, which GetArc() will already have
+    // computed when it created this state.
+    StateId prev_state = state_to_pending_successor_[s].first;
+    Label word = state_to_pending_successor_[s].second;
+    KALDI_ASSERT(prev_state >= 0 && state_to_rnnlm_state_[prev_state] != NULL);
+    const RnnlmComputeState *prev_rnnlm = state_to_rnnlm_state_[prev_state].get();
+    if (cache_ != NULL) {
+      state_to_rnnlm_state_[s] = cache_->GetSuccessor(
+          state_to_cache_node_[prev_state], *prev_rnnlm, word,
+          &(state_to_cache_node_[s]));
+    } else {
+      state_to_rnnlm_state_[s].reset(prev_rnnlm->GetSuccessorState(word));
+    }
   }
+  return state_to_rnnlm_state_[s].get();
 }
 
 fst::StdArc::Weight KaldiRnnlmDeterministicFst::Final(StateId s) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
 
-  RnnlmComputeState* rnn = state_to_rnnlm_state_[s];
+  const RnnlmComputeState* rnn = GetRnnlmState(s);
   return Weight(-rnn->LogProbOfWord(eos_index_));
 }
 
+void KaldiRnnlmDeterministicFst::PrefetchArcs(StateId s,
+                                              const std::vector<Label> &ilabels) {
+  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+  std::vector<int32> words;
+  words.reserve(ilabels.size());
+  for (size_t i = 0; i < ilabels.size(); i++) {
+    if (ilabels[i] != 0 && prefetched_log_probs_.count(
+            std::pair<StateId, Label>(s, ilabels[i])) == 0)
+      words.push_back(ilabels[i]);
+  }
+  if (words.size() < 2) return;  // Nothing to gain over GetArc().
+  SortAndUniq(&words);
+
+  std::vector<BaseFloat> log_probs;
+  GetRnnlmState(s)->GetLogProbOfWords(words, &log_probs);
+  for (size_t i = 0; i < words.size(); i++)
+    prefetched_log_probs_[std::pair<StateId, Label>(s, words[i])] =
+        log_probs[i];
+}
+
 bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
                                         fst::StdArc *oarc) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
 
   std::vector<Label> word_seq = state_to_wseq_[s];
-  const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s];
 
-  BaseFloat logprob = rnnlm->LogProbOfWord(ilabel);
+  BaseFloat logprob;
+  PrefetchMapType::const_iterator prefetched = prefetched_log_probs_.find(
+      std::pair<StateId, Label>(s, ilabel));
+  if (prefetched != prefetched_log_probs_.end())
+    logprob = prefetched->second;
+  else
+    logprob = GetRnnlmState(s)->LogProbOfWord(ilabel);
 
   word_seq.push_back(ilabel);
   if (max_ngram_order_ > 0) {
@@ -118,10 +238,15 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
 
   // If the pair was just inserted, then also add it to state_to_* structures.
+  // Its RNNLM state is only computed once it is needed (see GetRnnlmState()),
+  // so destination states that are never expanded cost no RNNLM computation.
   if (result.second == true) {
-    RnnlmComputeState *rnnlm2 = rnnlm->GetSuccessorState(ilabel);
+    GetRnnlmState(s);  // the new state's predecessor must be available.
     state_to_wseq_.push_back(word_seq);
-    state_to_rnnlm_state_.push_back(rnnlm2);
+    state_to_rnnlm_state_.emplace_back();
+    state_to_pending_successor_.emplace_back(s, ilabel);
+    if (cache_ != NULL)
+      state_to_cache_node_.push_back(-1);
   }
 
   // Creates the arc.
@@ -22,7 +22,10 @@
 #ifndef KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 #define KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 
+#include <list>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/kaldi-common.h"
@@ -33,6 +36,73 @@
 namespace kaldi {
 namespace rnnlm {
 
+/**
+  RnnlmComputeStateCache is a bounded, LRU-evicted cache of RNNLM states, keyed
+  by word history, that can be kept alive across utterances (unlike the
+  per-utterance state maps inside KaldiRnnlmDeterministicFst).  It is
+  organized as a trie: each node stands for a full word sequence starting
+  from the BOS symbol, and is identified by a NodeId; the child of a node for a
+  given word is looked up (or computed with GetSuccessorState()) on demand.
+  Since priming a KaldiRnnlmDeterministicFst also walks this trie from the
+  root, priming text that merely extends the previous utterance's priming
+  text only computes the new words.
+
+  States are handed out as shared pointers, so an evicted state remains valid
+  for as long as some KaldiRnnlmDeterministicFst still uses it.  This class is
+  not thread-safe.
+ */
+class RnnlmComputeStateCache {
+ public:
+  typedef int64 NodeId;
+
+  /// Does not take ownership of "info".  "max_num_states" bounds the number
+  /// of cached states (not counting the root, which is never evicted).
+  RnnlmComputeStateCache(const RnnlmComputeStateInfo &info,
+                         int32 max_num_states);
+
+  const RnnlmComputeStateInfo &Info() const { return info_; }
+
+  /// The node for the history consisting of just the BOS symbol.
+  NodeId Root() const { return 0; }
+  std::shared_ptr<const RnnlmComputeState> RootState() const {
+    return root_state_;
+  }
+
+  /// Returns the RNNLM state for the history of "node" followed by "word",
+  /// and outputs its node to "successor".  "state" must be the RNNLM state
+  /// of "node"; it is only used to compute the successor if that is not
+  /// cached.
+  std::shared_ptr<const RnnlmComputeState> GetSuccessor(
+      NodeId node, const RnnlmComputeState &state, int32 word,
+      NodeId *successor);
+
+  /// Removes all cached states except the root.
+  void Clear();
+
+  int32 NumStates() const { return map_.size(); }
+  int64 NumHits() const { return num_hits_; }
+  int64 NumMisses() const { return num_misses_; }
+
+ private:
+  typedef std::pair<NodeId, int32> Key;
+  struct Entry {
+    NodeId node;
+    std::shared_ptr<const RnnlmComputeState> state;
+    std::list<Key>::iterator lru_iter;
+  };
+
+  const RnnlmComputeStateInfo &info_;
+  std::shared_ptr<const RnnlmComputeState> root_state_;
+  int32 max_num_states_;
+  NodeId next_node_;
+  int64 num_hits_;
+  int64 num_misses_;
+
+  unordered_map<Key, Entry, PairHasher<NodeId, int32> > map_;
+  // Keys in order of most to least recently used.
+  std::list<Key> lru_;
+};
+
 class KaldiRnnlmDeterministicFst
     : public fst::DeterministicOnDemandFst<fst::StdArc> {
  public:
@@ -43,6 +113,11 @@ class KaldiRnnlmDeterministicFst
   // Does not take ownership.
   KaldiRnnlmDeterministicFst(int32 max_ngram_order,
       const RnnlmComputeStateInfo &info);
+
+  // Does not take ownership.  RNNLM states are looked up in, and added to,
+  // "cache", which may be shared by successive instances of this class.
+  KaldiRnnlmDeterministicFst(int32 max_ngram_order,
+      RnnlmComputeStateCache *cache);
   ~KaldiRnnlmDeterministicFst();
 
   void Prime(const std::vector<Label> &words);
@@ -58,23 +133,46 @@ class KaldiRnnlmDeterministicFst
 
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
+  // Computes the log-probs of all of "ilabels" from state s with a single
+  // matrix-vector product restricted to those words, for later GetArc()
+  // calls.
+  virtual void PrefetchArcs(StateId s, const std::vector<Label> &ilabels);
+
  private:
   typedef unordered_map
       <std::vector<Label>, StateId, VectorHasher<Label> > MapType;
+  typedef unordered_map<std::pair<StateId, Label>, BaseFloat,
+                        PairHasher<StateId, Label> > PrefetchMapType;
+
+  // Returns the RNNLM state of state s, computing it if necessary.
+  const RnnlmComputeState* GetRnnlmState(StateId s);
+
   StateId start_state_;
   int32 max_ngram_order_;
   int32 bos_index_;
   int32 eos_index_;
   const RnnlmComputeStateInfo &info_;
+  RnnlmComputeStateCache *cache_;  // NULL if not using a cache.
 
   MapType wseq_to_state_;
 
   // Mapping from state-id to history sequence>
   std::vector<std::vector<Label> > state_to_wseq_;
 
-  // Mapping from state-id to RNNLM states.
-  // The pointers are owned in this class
-  std::vector<RnnlmComputeState*> state_to_rnnlm_state_;
+  // Mapping from state-id to RNNLM states (NULL if not computed yet).
+  // These are shared with cache_, if we are using one.
+  std::vector<std::shared_ptr<const RnnlmComputeState> > state_to_rnnlm_state_;
+
+  // Mapping from state-id to the (predecessor state, word) its RNNLM state is
+  // to be computed from; (-1, 0) for the start state.
+  std::vector<std::pair<StateId, Label> > state_to_pending_successor_;
+
+  // Log-probs computed by PrefetchArcs(), indexed by (state, word).
+  PrefetchMapType prefetched_log_probs_;
+
+  // Mapping from state-id to the node in cache_ of its RNNLM state (only if
+  // we are using a cache).
+  std::vector<RnnlmComputeStateCache::NodeId> state_to_cache_node_;
 
 };
 
@@ -0,0 +1,193 @@
+// util/flat-hash-list-inl.h
+
+// Copyright 2009-2011   Microsoft Corporation
+//                2013   Johns Hopkins University (author: Daniel Povey)
+//                2020   David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_FLAT_HASH_LIST_INL_H_
+#define KALDI_UTIL_FLAT_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by flat-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> FlatHashList<I, T>::FlatHashList():
+    list_head_(NULL), list_tail_(NULL), num_elems_(0), hash_shift_(64),
+    cur_arena_(0) {
+  Rehash(16);
+}
+
+template<class I, class T> void FlatHashList<I, T>::SetSize(size_t size) {
+  size_t num_slots = slots_.size();
+  while (num_slots < size)
+    num_slots *= 2;
+  if (num_slots != slots_.size())
+    Rehash(num_slots);
+}
+
+template<class I, class T> void FlatHashList<I, T>::Rehash(size_t num_slots) {
+  int32 log2_slots = 0;
+  while ((static_cast<size_t>(1) << log2_slots) < num_slots)
+    log2_slots++;
+  KALDI_ASSERT((static_cast<size_t>(1) << log2_slots) == num_slots &&
+               log2_slots > 0);
+  hash_shift_ = 64 - log2_slots;
+  Slot empty_slot;
+  empty_slot.key = I();
+  empty_slot.elem = NULL;
+  slots_.assign(num_slots, empty_slot);
+  used_slots_.clear();
+  for (Elem *e = list_head_; e != NULL; e = e->tail) {
+    Slot *slot = FindSlot(e->key);
+    if (slot->elem == NULL) {  // only the first of any InsertMore() run.
+      slot->key = e->key;
+      slot->elem = e;
+      used_slots_.push_back(slot - &(slots_[0]));
+    }
+  }
+}
+
+template<class I, class T>
+typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::Clear() {
+  // Clears the hashtable and gives ownership of the currently contained list
+  // to the user.
+  for (size_t i = 0; i < used_slots_.size(); i++)
+    slots_[used_slots_[i]].elem = NULL;  // this is how we indicate "empty".
+  used_slots_.clear();
+  Elem *ans = list_head_;
+  list_head_ = list_tail_ = NULL;
+  num_elems_ = 0;
+
+  // The arena holding the list from the previous Clear() becomes the one we
+  // allocate from.
+  Arena &next = arenas_[1 - cur_arena_];
+  KALDI_ASSERT(next.num_live == 0 &&
+               "Delete() must be called for every Elem of the list returned "
+               "by Clear() before Clear() is called again.");
+  next.cur_block = 0;
+  next.cur_block_used = 0;
+  cur_arena_ = 1 - cur_arena_;
+  return ans;
+}
+
+template<class I, class T>
+inline void FlatHashList<I, T>::Delete(Elem *e) {
+  // Only Elems from the list returned by Clear() may be deleted, and those
+  // all live in the arena we are not allocating from.  The memory itself is
+  // reclaimed all at once, by the next Clear().
+  Arena &prev = arenas_[1 - cur_arena_];
+  KALDI_PARANOID_ASSERT(prev.num_live > 0);
+  prev.num_live--;
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::New() {
+  Arena &arena = arenas_[cur_arena_];
+  if (arena.cur_block_used == allocate_block_size_ || arena.blocks.empty()) {
+    if (!arena.blocks.empty()) {
+      arena.cur_block++;
+      arena.cur_block_used = 0;
+    }
+    if (arena.cur_block == arena.blocks.size())
+      arena.blocks.push_back(new Elem[allocate_block_size_]);
+  }
+  arena.num_live++;
+  return arena.blocks[arena.cur_block] + arena.cur_block_used++;
+}
+
+template<class I, class T>
+FlatHashList<I, T>::~FlatHashList() {
+  // First test whether we had any memory leak within the
+  // FlatHashList, i.e. things for which the user did not call Delete().
+  // Elems still in the current list are not counted, as with HashList they
+  // are never handed to the user.
+  size_t num_live = arenas_[cur_arena_].num_live - num_elems_ +
+      arenas_[1 - cur_arena_].num_live;
+  for (int32 a = 0; a < 2; a++)
+    for (size_t i = 0; i < arenas_[a].blocks.size(); i++)
+      delete[] arenas_[a].blocks[i];
+  if (num_live != 0) {
+    KALDI_WARN << "Possible memory leak: " << num_live
+               << " Elems were not deleted: you might have forgotten to call "
+               << "Delete on some Elems";
+  }
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Slot* FlatHashList<I, T>::FindSlot(
+    I key) {
+  size_t mask = slots_.size() - 1, index = HashIndex(key);
+  Slot *slots = &(slots_[0]);
+  while (slots[index].elem != NULL && slots[index].key != key)
+    index = (index + 1) & mask;
+  return slots + index;
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::Find(I key) {
+  return FindSlot(key)->elem;
+}
+
+template<class I, class T>
+inline typename FlatHashList<I, T>::Elem* FlatHashList<I, T>::Insert(I key,
+                                                                     T val) {
+  Slot *slot = FindSlot(key);
+  if (slot->elem != NULL)
+    return slot->elem;
+
+  // This is a new element. Insert it at the end of the list.
+  if (4 * (num_elems_ + 1) > 3 * slots_.size()) {
+    Rehash(2 * slots_.size());
+    slot = FindSlot(key);
+  }
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ == NULL) list_head_ = elem;
+  else list_tail_->tail = elem;
+  list_tail_ = elem;
+  num_elems_++;
+
+  slot->key = key;
+  slot->elem = elem;
+  used_slots_.push_back(slot - &(slots_[0]));
+  return elem;
+}
+
+template<class I, class T>
+void FlatHashList<I, T>::InsertMore(I key, T val) {
+  Elem *e = Find(key);
+  KALDI_ASSERT(e != NULL);  // assume one element is already here
+  // find the last element with this key, and insert after it.
+  while (e->tail != NULL && e->tail->key == key) e = e->tail;
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = e->tail;
+  e->tail = elem;
+  if (list_tail_ == e) list_tail_ = elem;
+  num_elems_++;
+}
+
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_FLAT_HASH_LIST_INL_H_
@@ -0,0 +1,133 @@
+// util/flat-hash-list-speed-test.cc
+
+// Copyright 2020     David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/hash-list.h"
+#include "util/flat-hash-list.h"
+#include "base/timer.h"
+#include <iostream>
+
+// Compares the speed of HashList and FlatHashList, as used by the decoders'
+// token passing, on random graphs of several sizes.  Each frame, the tokens of
+// the previous frame are taken with Clear(), and the successors of (at most
+// max_active of) them are looked up and inserted with Insert(), as in
+// LatticeFasterDecoderTpl::ProcessEmitting().  The "grammar" variants put an
+// FST instance index in the high bits of the 64-bit keys, as ActiveGrammarFst
+// does.
+
+namespace kaldi {
+
+static void CsvResult(std::string test, int64 dim, BaseFloat measure,
+                      std::string units) {
+  std::cout << test << "," << dim << "," << measure << "," << units << "\n";
+}
+
+struct RandomGraph {
+  int32 num_states;
+  int32 num_arcs_per_state;
+  std::vector<int32> dest;  // dest[s * num_arcs_per_state + a]
+  RandomGraph(int32 num_states, int32 num_arcs_per_state):
+      num_states(num_states), num_arcs_per_state(num_arcs_per_state),
+      dest(static_cast<size_t>(num_states) * num_arcs_per_state) {
+    for (size_t i = 0; i < dest.size(); i++)
+      dest[i] = RandInt(0, num_states - 1);
+  }
+};
+
+template<class HashType>
+static int64 SimulateDecoding(const RandomGraph &graph, int32 num_frames,
+                              int32 max_active, int32 num_instances) {
+  typedef typename HashType::Elem Elem;
+  HashType toks;
+  toks.SetSize(1000);
+  toks.Insert(0, 0);
+  int64 num_inserts = 0;
+  for (int32 frame = 0; frame < num_frames; frame++) {
+    Elem *prev_toks = toks.Clear(), *e_tail;
+    size_t tok_count = 0;
+    for (Elem *e = prev_toks; e != NULL; e = e->tail)
+      tok_count++;
+    size_t new_sz = 2 * std::min<size_t>(tok_count, max_active) *
+        graph.num_arcs_per_state;
+    if (new_sz > toks.Size())
+      toks.SetSize(new_sz);
+    int32 count = 0;
+    for (Elem *e = prev_toks; e != NULL; e = e_tail, count++) {
+      if (count < max_active) {
+        int64 instance = e->key >> 32;
+        int32 state = static_cast<int32>(e->key & 0xFFFFFFFF);
+        for (int32 a = 0; a < graph.num_arcs_per_state; a++) {
+          int32 next_state = graph.dest[static_cast<size_t>(state) *
+                                        graph.num_arcs_per_state + a];
+          // Occasionally move to another FST instance, like a nonterminal.
+          int64 next_instance = (next_state % 97 == 0 ?
+                                 next_state % num_instances : instance);
+          Elem *e_found = toks.Insert((next_instance << 32) + next_state,
+                                      e->val + 1);
+          if (e_found->val > e->val + 1)  // keep the best "cost".
+            e_found->val = e->val + 1;
+          num_inserts++;
+        }
+      }
+      e_tail = e->tail;
+      toks.Delete(e);
+    }
+  }
+  Elem *final_toks = toks.Clear(), *e_tail;
+  for (Elem *e = final_toks; e != NULL; e = e_tail) {
+    e_tail = e->tail;
+    toks.Delete(e);
+  }
+  return num_inserts;
+}
+
+static void TestFlatHashListSpeed() {
+  int32 num_frames = 500, max_active = 7000, num_arcs_per_state = 4;
+  std::vector<int32> sizes;
+  sizes.push_back(10000);
+  sizes.push_back(100000);
+  sizes.push_back(1000000);
+  sizes.push_back(4000000);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    RandomGraph graph(sizes[i], num_arcs_per_state);
+    for (int32 num_instances = 1; num_instances <= 50; num_instances += 49) {
+      std::string suffix = (num_instances == 1 ? "" : " grammar");
+      Timer t1;
+      int64 n1 = SimulateDecoding<HashList<int64, int32> >(
+          graph, num_frames, max_active, num_instances);
+      CsvResult("HashList" + suffix, sizes[i], n1 / t1.Elapsed() / 1.0e6,
+                "Minserts/sec");
+      Timer t2;
+      int64 n2 = SimulateDecoding<FlatHashList<int64, int32> >(
+          graph, num_frames, max_active, num_instances);
+      CsvResult("FlatHashList" + suffix, sizes[i], n2 / t2.Elapsed() / 1.0e6,
+                "Minserts/sec");
+      KALDI_ASSERT(n1 == n2);
+    }
+  }
+}
+
+}  // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  TestFlatHashListSpeed();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,151 @@
+// util/flat-hash-list-test.cc
+
+// Copyright 2009-2011     Microsoft Corporation
+//                2013     Johns Hopkins University (author: Daniel Povey)
+//                2020     David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/flat-hash-list.h"
+#include <map>  // for baseline.
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+template<class Int, class T> void TestFlatHashList() {
+  typedef typename FlatHashList<Int, T>::Elem Elem;
+
+  FlatHashList<Int, T> hash;
+  hash.SetSize(200);
+  std::map<Int, T> m1;
+  for (size_t j = 0; j < 50; j++) {
+    Int key = Rand() % 200;
+    T val = Rand() % 50;
+    m1[key] = val;
+    Elem *e = hash.Find(key);
+    if (e) e->val = val;
+    else  hash.Insert(key, val);
+  }
+
+
+  std::map<Int, T> m2;
+
+  for (int i = 0; i < 100; i++) {
+    m2.clear();
+    for (typename std::map<Int, T>::const_iterator iter = m1.begin();
+        iter != m1.end();
+        iter++) {
+      m2[iter->first + 1] = iter->second;
+    }
+    std::swap(m1, m2);
+
+    Elem *h = hash.Clear(), *tmp;
+
+    // Small sizes exercise the automatic growth of the hash.
+    hash.SetSize(Rand() % 100);
+
+    for (; h != NULL; h = tmp) {
+      hash.Insert(h->key + 1, h->val);
+      tmp = h->tail;
+      hash.Delete(h);  // think of this like calling delete.
+    }
+
+    // Now make sure h and m2 are the same.
+    const Elem *list = hash.GetList();
+    size_t count = 0;
+    for (; list != NULL; list = list->tail, count++) {
+      KALDI_ASSERT(m1[list->key] == list->val);
+    }
+
+    for (size_t j = 0; j < 10; j++) {
+      Int key = Rand() % 200;
+      bool found_m1 = (m1.find(key) != m1.end());
+      Elem *e = hash.Find(key);
+      KALDI_ASSERT((e != NULL) == found_m1);
+      if (found_m1)
+        KALDI_ASSERT(m1[key] == e->val);
+    }
+
+    KALDI_ASSERT(m1.size() == count);
+  }
+  Elem *h = hash.Clear(), *tmp;
+  for (; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+// Checks that the list comes out in insertion order, with InsertMore()
+// elements following the others with the same key, and that structured 64-bit
+// keys (which differ only in their high bits) are handled.
+void TestFlatHashListOrder() {
+  typedef FlatHashList<int64, int32>::Elem Elem;
+  FlatHashList<int64, int32> hash;
+  std::vector<int64> keys;
+  for (int32 i = 0; i < 3000; i++)
+    keys.push_back((static_cast<int64>(i % 7) << 32) + i / 7);
+  for (int32 i = 0; i < 3000; i++) {
+    Elem *e = hash.Insert(keys[i], i);
+    KALDI_ASSERT(e->key == keys[i] && e->val == i);
+    KALDI_ASSERT(hash.Insert(keys[i], -1) == e);  // already present.
+  }
+  hash.InsertMore(keys[10], 10000);
+  hash.InsertMore(keys[10], 10001);
+  hash.InsertMore(keys[2999], 10002);
+  KALDI_ASSERT(hash.Find(keys[10])->val == 10);
+
+  std::vector<int32> expected;
+  for (int32 i = 0; i < 3000; i++) {
+    expected.push_back(i);
+    if (i == 10) {
+      expected.push_back(10000);
+      expected.push_back(10001);
+    }
+  }
+  expected.push_back(10002);
+
+  Elem *h = hash.Clear(), *tmp;
+  KALDI_ASSERT(hash.GetList() == NULL && hash.Find(keys[0]) == NULL);
+  size_t count = 0;
+  for (; h != NULL; h = tmp, count++) {
+    KALDI_ASSERT(count < expected.size() && h->val == expected[count]);
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  KALDI_ASSERT(count == expected.size());
+  hash.Clear();
+}
+
+
+}  // end namespace kaldi
+
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0;i < 3;i++) {
+    TestFlatHashList<int, unsigned int>();
+    TestFlatHashList<unsigned int, int>();
+    TestFlatHashList<int16, int32>();
+    TestFlatHashList<int64, int32>();
+    TestFlatHashList<char, unsigned char>();
+    TestFlatHashList<unsigned char, int>();
+  }
+  TestFlatHashListOrder();
+  std::cout << "Test OK.\n";
+}
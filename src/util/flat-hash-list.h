@@ -0,0 +1,175 @@
+// util/flat-hash-list.h
+
+// Copyright 2009-2011   Microsoft Corporation
+//                2013   Johns Hopkins University (author: Daniel Povey)
+//                2020   David Zurow
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_FLAT_HASH_LIST_H_
+#define KALDI_UTIL_FLAT_HASH_LIST_H_
+#include <vector>
+#include <limits>
+#include "util/stl-utils.h"
+
+
+/* This header provides FlatHashList, a drop-in replacement for HashList (see
+   hash-list.h) with the same interface and the same Clear()/Delete() protocol,
+   but with a layout that is friendlier to the cache, which matters in the
+   decoders where the hash is probed for every arc traversed.
+
+    - The hash is an open-addressing table with linear probing, storing each
+      key next to its Elem pointer, so a lookup normally touches a single
+      cache line and never follows a chain through the Elems.  Keys are mixed
+      with a multiplicative hash rather than reduced modulo the table size,
+      so that structured keys (e.g. the 64-bit state ids of ActiveGrammarFst,
+      which put an FST instance index in the high bits) spread evenly.
+
+    - Elems are bump-allocated, in insertion order, from one of two arenas
+      that alternate on each Clear(), and the list links them in insertion
+      order, so iterating over the list walks memory that is (almost always)
+      contiguous.
+
+   The price of the arenas is a slightly stricter protocol than HashList's:
+   every Elem of the list returned by Clear() must have been given back with
+   Delete() before Clear() is called again (the decoders always do this, in
+   ProcessEmitting() and DeleteElems()), since the next Clear() recycles that
+   list's arena wholesale.
+
+   See flat-hash-list-test.cc for an example of how to use this object, and
+   flat-hash-list-speed-test.cc for a speed comparison with HashList.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class FlatHashList {
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  /// Constructor takes no arguments.
+  /// Call SetSize to inform it of the likely size.
+  FlatHashList();
+
+  /// Clears the hash and gives the head of the current list to the user;
+  /// ownership is transferred to the user (the user must call Delete()
+  /// for each element in the list before the next call to Clear()).
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in
+  /// the class.
+  const Elem *GetList() const { return list_head_; }
+
+  /// Think of this like delete().  It is to be called for each Elem in turn
+  /// after you "obtained ownership" by doing Clear().
+  inline void Delete(Elem *e);
+
+  /// This should probably not be needed to be called directly by the user.
+  /// Think of it as opposite to Delete().
+  inline Elem *New();
+
+  /// Find tries to find this element in the current list using the hashtable.
+  /// It returns NULL if not present.  The Elem it returns is not owned by the
+  /// user, it is part of the internal list owned by this object, but the user
+  /// is free to modify the "val" element.
+  inline Elem *Find(I key);
+
+  /// Insert inserts a new element into the hashtable/stored list.  If an
+  /// element with this key is already present, nothing is inserted and a
+  /// pointer to the existing element is returned.
+  inline Elem *Insert(I key, T val);
+
+  /// Hints to the CPU that "key" is about to be looked up, by prefetching its
+  /// hash slot.  Has no effect on the contents of the hash.
+  inline void Prefetch(I key) const {
+#if defined(__GNUC__)
+    __builtin_prefetch(&(slots_[HashIndex(key)]));
+#endif
+  }
+
+  /// Inserts another element with the same key as one already present (the
+  /// user asserts that one is).  The new element follows the other elements
+  /// with that key in the list; Find() still returns the first of them.
+  inline void InsertMore(I key, T val);
+
+  /// SetSize tells the object how many hash slots to allocate (rounded up to
+  /// a power of two; should typically be at least twice the number of objects
+  /// we expect to go in the structure, for fastest performance).  Unlike
+  /// HashList, it may be called at any time, and the hash also grows by itself
+  /// if it gets more than 3/4 full.
+  void SetSize(size_t sz);
+
+  /// Returns current number of hash slots.
+  inline size_t Size() { return slots_.size(); }
+
+  ~FlatHashList();
+
+ private:
+  struct Slot {
+    I key;
+    Elem *elem;  // NULL if the slot is empty.
+  };
+
+  // A set of equally-sized blocks of Elems that are handed out in order.
+  struct Arena {
+    std::vector<Elem*> blocks;
+    size_t cur_block;  // index into blocks of the block being handed out
+    size_t cur_block_used;  // number of Elems used in blocks[cur_block]
+    size_t num_live;  // number of Elems handed out and not yet Delete()d
+    Arena(): cur_block(0), cur_block_used(0), num_live(0) { }
+  };
+
+  inline size_t HashIndex(I key) const {
+    return static_cast<size_t>(
+        (static_cast<uint64>(key) * 0x9E3779B97F4A7C15ULL) >> hash_shift_);
+  }
+
+  // Returns the slot holding "key", or the empty slot where it would go.
+  inline Slot *FindSlot(I key);
+
+  // Resizes the table to "num_slots" (a power of two) and re-indexes the
+  // current list.
+  void Rehash(size_t num_slots);
+
+  Elem *list_head_;  // head of currently stored list.
+  Elem *list_tail_;  // tail of currently stored list.
+  size_t num_elems_;  // number of Elems in the current list.
+
+  std::vector<Slot> slots_;  // the hash table; size is a power of two.
+  int32 hash_shift_;  // 64 - log2(slots_.size()).
+  std::vector<size_t> used_slots_;  // occupied slots, to make Clear() fast.
+
+  Arena arenas_[2];
+  int32 cur_arena_;  // arena that New() takes Elems from; the list returned
+                     // by the last Clear() lives in the other one.
+
+  static const size_t allocate_block_size_ = 1024;  // Number of Elems to
+  // allocate in one block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FlatHashList);
+};
+
+
+}  // end namespace kaldi
+
+#include "util/flat-hash-list-inl.h"
+
+#endif  // KALDI_UTIL_FLAT_HASH_LIST_H_
@@ -123,6 +123,48 @@ void TestTaskSequencer() {
 }
 
 
+void TestWorkerThreads() {
+  int32 num_threads = 1 + Rand() % 8, num_jobs = 100;
+  WorkerThreads workers(num_threads);
+  KALDI_ASSERT(workers.NumThreads() == num_threads);
+  // Each thread sums up its block of the integers 0 ... max_to_count - 1, as
+  // MyThreadClass does; the same threads are reused for every job.
+  std::vector<int64> counts(num_threads);
+  for (int32 job = 0; job < num_jobs; job++) {
+    int32 max_to_count = Rand() % 10000;
+    std::fill(counts.begin(), counts.end(), 0);
+    workers.Run([&](int32 thread) {
+        KALDI_ASSERT(thread >= 0 && thread < num_threads);
+        int32 start = static_cast<int64>(max_to_count) * thread / num_threads,
+            end = static_cast<int64>(max_to_count) * (thread + 1) / num_threads;
+        for (int32 j = start; j < end; j++)
+          counts[thread] += j;
+      });
+    int64 tot = 0;
+    for (int32 thread = 0; thread < num_threads; thread++)
+      tot += counts[thread];
+    KALDI_ASSERT(tot == static_cast<int64>(max_to_count) *
+                 (max_to_count - 1) / 2);
+  }
+  // An exception thrown by any of the threads comes out of Run(), and the
+  // threads can be used again afterwards.
+  int32 throwing_thread = Rand() % num_threads;
+  bool caught = false;
+  try {
+    workers.Run([throwing_thread](int32 thread) {
+        if (thread == throwing_thread)
+          throw std::runtime_error("thread failed");
+      });
+  } catch (const std::runtime_error &e) {
+    caught = true;
+  }
+  KALDI_ASSERT(caught);
+  std::fill(counts.begin(), counts.end(), 0);
+  workers.Run([&](int32 thread) { counts[thread] = 1; });
+  for (int32 thread = 0; thread < num_threads; thread++)
+    KALDI_ASSERT(counts[thread] == 1);
+}
+
 }  // end namespace kaldi.
 
 int main() {
@@ -130,4 +172,6 @@ int main() {
   TestThreads();
   for (int32 i = 0; i < 10; i++)
     TestTaskSequencer();
+  for (int32 i = 0; i < 10; i++)
+    TestWorkerThreads();
 }
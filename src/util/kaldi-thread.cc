@@ -28,6 +28,83 @@ MultiThreadable::~MultiThreadable() {
   // default implementation does nothing
 }
 
+WorkerThreads::WorkerThreads(int32 num_threads):
+    func_(NULL), job_(0), num_running_(0), exit_(false) {
+  KALDI_ASSERT(num_threads >= 1);
+  for (int32 thread = 1; thread < num_threads; thread++)
+    threads_.push_back(std::thread(&WorkerThreads::ThreadMain, this, thread));
+}
+
+WorkerThreads::~WorkerThreads() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  start_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++)
+    threads_[i].join();
+}
+
+void WorkerThreads::Run(const std::function<void(int32)> &func) {
+  if (threads_.empty()) {
+    func(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    func_ = &func;
+    job_++;
+    num_running_ = threads_.size();
+    exception_ = std::exception_ptr();
+  }
+  start_.notify_all();
+  // The other threads still use "func", so we must wait for them before
+  // letting an exception out of here.
+  std::exception_ptr exception;
+  try {
+    func(0);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return num_running_ == 0; });
+  func_ = NULL;
+  if (!exception)
+    exception = exception_;
+  exception_ = std::exception_ptr();
+  lock.unlock();
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+void WorkerThreads::ThreadMain(int32 thread) {
+  int64 last_job = 0;
+  while (true) {
+    const std::function<void(int32)> *func;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, last_job]() {
+          return exit_ || job_ != last_job; });
+      if (exit_) return;
+      last_job = job_;
+      func = func_;
+    }
+    std::exception_ptr exception;
+    try {
+      (*func)(thread);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception && !exception_)
+        exception_ = exception;
+      last = (--num_running_ == 0);
+    }
+    if (last) done_.notify_one();
+  }
+}
 
 
 }  // end namespace kaldi
@@ -24,6 +24,11 @@
 
 #include <thread>
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
 #include "itf/options-itf.h"
 #include "util/kaldi-semaphore.h"
 
@@ -53,6 +58,11 @@
 // destructor to have side effects such as outputting data.
 // Note: the destructor of TaskSequencer will wait for any remaining jobs that
 // are still running and will call the destructors.
+//
+// The class WorkerThreads is for code that needs to run a short parallel job
+// many times, e.g. once per frame of decoding, where creating and joining
+// threads each time would cost too much.  Its threads are created once, in the
+// constructor, and wait between calls to its function Run().
 
 
 namespace kaldi {
@@ -280,6 +290,43 @@ class TaskSequencer {
 
 };
 
+/// WorkerThreads keeps num_threads - 1 threads alive for its whole lifetime;
+/// together with the thread that calls Run(), they run a function of the
+/// thread index, as many times as Run() is called.
+class WorkerThreads {
+ public:
+  /// num_threads must be >= 1; with num_threads == 1, Run() simply calls the
+  /// function in the calling thread.
+  explicit WorkerThreads(int32 num_threads);
+
+  /// Waits for the threads to exit.  Must not be called during Run().
+  ~WorkerThreads();
+
+  int32 NumThreads() const { return threads_.size() + 1; }
+
+  /// Calls func(thread) for thread = 0 ... NumThreads() - 1, concurrently,
+  /// with thread 0 in the calling thread, and returns when all the calls have
+  /// returned.  If any of the calls throws, the first exception is rethrown
+  /// once they have all returned.  Run() must not be called from more than one
+  /// thread at a time.
+  void Run(const std::function<void(int32)> &func);
+
+ private:
+  void ThreadMain(int32 thread);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;  // signaled when a job is posted, or on exit
+  std::condition_variable done_;  // signaled when num_running_ reaches zero
+  const std::function<void(int32)> *func_;  // the job of the current Run()
+  int64 job_;  // incremented by each Run(), so each thread runs each job once
+  int32 num_running_;  // number of threads still running the current job
+  std::exception_ptr exception_;  // the first one thrown by the current job
+  bool exit_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WorkerThreads);
+};
+
 } // namespace kaldi
 
 #endif  // KALDI_THREAD_KALDI_THREAD_H_